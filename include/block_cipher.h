@@ -42,6 +42,28 @@ namespace mockup { namespace crypto {
         virtual void init(const uint8_t* mk, size_t keylen) = 0;
         virtual void encryptBlock(uint8_t* out, const uint8_t* in) = 0;
         virtual void decryptBlock(uint8_t* out, const uint8_t* in) = 0;
+
+        virtual void encryptBlocks(uint8_t* out, const uint8_t* in, size_t count)
+        {
+            auto blocksize = this->blocksize();
+            for (auto i = 0; i < count; ++i) {
+                encryptBlock(out, in);
+
+                out += blocksize;
+                in += blocksize;
+            }
+        }
+
+        virtual void decryptBlocks(uint8_t* out, const uint8_t* in, size_t count)
+        {
+            auto blocksize = this->blocksize();
+            for (auto i = 0; i < count; ++i) {
+                decryptBlock(out, in);
+
+                out += blocksize;
+                in += blocksize;
+            }
+        }
     };
 
     using BlockCipherPtr = std::shared_ptr<BlockCipher>;
@@ -34,6 +34,7 @@ namespace mockup { namespace crypto { namespace block_cipher {
     private:
         size_t _keysize;
         uint8_t* _rks;
+        uint8_t* _drks;
 
     public:
         AesNI();
@@ -46,9 +47,15 @@ namespace mockup { namespace crypto { namespace block_cipher {
         void init(const uint8_t* mk, size_t keylen) override;
         void encryptBlock(uint8_t* out, const uint8_t* in) override;
         void decryptBlock(uint8_t* out, const uint8_t* in) override;
+        void encryptBlocks(uint8_t* out, const uint8_t* in, size_t count) override;
+        void decryptBlocks(uint8_t* out, const uint8_t* in, size_t count) override;
 
-    private:
+        // expanded encryption keys, rounds() + 1 round keys of 16 bytes
+        const uint8_t* roundKeys() const;
         size_t rounds() const;
+
+    private:
+        void initDecryptionKeys();
     };
 }}}
 
@@ -0,0 +1,88 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MOCKUP_CRYPTO_BLOCK_CIPHER_AES_NI_MULTI_BUFFER_H__
+#define __MOCKUP_CRYPTO_BLOCK_CIPHER_AES_NI_MULTI_BUFFER_H__
+
+#include "aesni.h"
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace mockup { namespace crypto { namespace block_cipher {
+
+    // CTR mode over many sessions with their own keys, where every AES-NI round carries blocks of up to eight jobs
+    class AesNIMultiBuffer {
+
+    public:
+        static constexpr size_t LANES = 8;
+
+        struct Job {
+            const AesNI* cipher;    // key schedule of the session, which should outlive the job
+            uint8_t counter[16];    // initial counter block, incremented as a 128-bit big endian integer
+            const uint8_t* in;
+            uint8_t* out;           // may be in itself
+            size_t length;
+            void* context;
+        };
+
+        using clock = std::chrono::steady_clock;
+        using Callback = std::function<void(const Job&)>;
+
+    private:
+        Callback _completed;
+        size_t _flushBytes;
+        clock::duration _maxLatency;
+
+        std::vector<Job> _queue;
+        size_t _queuedBytes;
+        bool _flushing;
+        clock::time_point _oldest;
+
+    public:
+        // jobs are queued until flushBytes are pending or the oldest one has waited maxLatency
+        AesNIMultiBuffer(Callback completed, size_t flushBytes = 4096, clock::duration maxLatency = std::chrono::microseconds(100));
+        ~AesNIMultiBuffer() = default;
+
+        // flushes once the size threshold is reached, unless called back from a flush.
+        // Throws "Illegal cipher" for a cipher without an AES-128, AES-192 or AES-256 key
+        void submit(const Job& job);
+
+        // flushes when the oldest queued job has waited longer than the latency threshold.
+        // Reading the clock costs as much as encrypting a small packet, so submit leaves this to the caller's event loop
+        void poll();
+
+        // processes every queued job, calling back for each one as it completes.
+        // Jobs submitted from a callback wait for the next flush
+        void flush();
+
+        size_t pending() const;
+
+    private:
+        void process(std::vector<Job>& jobs, size_t rounds);
+    };
+}}}
+
+#endif
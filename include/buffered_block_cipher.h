@@ -25,7 +25,13 @@
 #ifndef __MOCKUP_CRYPTO_BUFFERED_BLOCK_CIPHER_H__
 #define __MOCKUP_CRYPTO_BUFFERED_BLOCK_CIPHER_H__
 
-#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <sys/uio.h>
+
+#if __cplusplus >= 202002L
+#include <span>
+#endif
 
 #include "block_cipher.h"
 #include "named_algorithm.h"
@@ -42,17 +48,40 @@ namespace mockup { namespace crypto {
         };
 
     protected:
+        static constexpr size_t MAX_BLOCKSIZE = 32;
+
+        // a whole block, plus at most one more block held back while decrypting
+        static constexpr size_t BUFFER_CAPACITY = 2 * MAX_BLOCKSIZE;
+
         size_t _blocksize;
         CipherMode _mode;
         std::shared_ptr<BlockCipher> _cipher;
-        std::vector<uint8_t> _buffer;
+        uint8_t _buffer[BUFFER_CAPACITY];
+        size_t _buffered;
         std::shared_ptr<Padding> _padding;
 
     protected:
         virtual void updateBlock(uint8_t* out, const uint8_t* in) = 0;
 
+        virtual void updateBlocks(uint8_t* out, const uint8_t* in, size_t count)
+        {
+            for (auto i = 0; i < count; ++i) {
+                updateBlock(out, in);
+
+                out += _blocksize;
+                in += _blocksize;
+            }
+        }
+
+        // number of trailing bytes that must stay buffered until doFinal
+        virtual size_t holdback() const
+        {
+            // while decrypting with padding, the last block is kept so that doFinal can unpad it
+            return (_mode == CipherMode::DECRYPT && _padding != nullptr) ? 1 : 0;
+        }
+
     public:
-        BufferedBlockCipher() : _cipher(nullptr), _padding(nullptr) {};
+        BufferedBlockCipher() : _cipher(nullptr), _buffered(0), _padding(nullptr) {};
         virtual ~BufferedBlockCipher() {};
 
         virtual const std::string name() const = 0;
@@ -60,41 +89,141 @@ namespace mockup { namespace crypto {
         virtual void initMode(CipherMode mode, const uint8_t* iv, size_t ivLen) = 0;
         virtual size_t doFinal(uint8_t* out) = 0;
 
-        void initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen)
+        virtual void initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen)
         {
             _cipher = cipher;
             _cipher->init(mk, keylen);
             _blocksize = _cipher->blocksize();
+            _buffered = 0;
+
+            if (_blocksize > MAX_BLOCKSIZE) {
+                throw "Illegal blocksize";
+            }
+        }
+
+        // number of bytes the next update with msgLen bytes writes to out
+        size_t outputSize(size_t msgLen) const
+        {
+            auto available = _buffered + msgLen;
+            auto reserved = holdback();
+
+            return (available < _blocksize + reserved) ? 0 : (available - reserved) / _blocksize * _blocksize;
         }
 
+        // out may be msg itself; the output then lags the input by the bytes buffered before this call
         size_t update(uint8_t* out, const uint8_t* msg, size_t msgLen)
         {
-            auto outlen = 0;
+            auto outlen = outputSize(msgLen);
+            if (outlen == 0) {
+                std::copy(msg, msg + msgLen, _buffer + _buffered);
+                _buffered += msgLen;
+                return 0;
+            }
 
-            auto gap = _blocksize - _buffer.size();
-            if (msgLen >= gap) {
-                _buffer.insert(_buffer.end(), msg, msg + gap);
-                updateBlock(out, _buffer.data());
+            // in place, blocks completed from the buffer would overwrite unread input, so they are staged
+            auto inPlace = (out == msg);
+            uint8_t staged[BUFFER_CAPACITY];
+            auto head = inPlace ? staged : out;
+            size_t written = 0;
 
-                _buffer.clear();
+            while (_buffered > 0 && written < outlen) {
+                if (_buffered < _blocksize) {
+                    auto gap = _blocksize - _buffered;
+                    std::copy(msg, msg + gap, _buffer + _buffered);
+                    _buffered = _blocksize;
+                    msg += gap;
+                    msgLen -= gap;
+                }
 
-                out += _blocksize;
-                msg += gap;
-                outlen += _blocksize;
-                msgLen -= gap;
+                updateBlock(head + written, _buffer);
+                std::copy(_buffer + _blocksize, _buffer + _buffered, _buffer);
+                _buffered -= _blocksize;
+                written += _blocksize;
+            }
+
+            // whole blocks of msg are processed where they lie when in place
+            auto length = outlen - written;
+            auto target = inPlace ? out + (msg - out) : out + written;
+            if (length > 0) {
+                updateBlocks(target, msg, length / _blocksize);
+                msg += length;
+                msgLen -= length;
             }
 
-            while (msgLen >= _blocksize) {
-                updateBlock(out, msg);
+            std::copy(msg, msg + msgLen, _buffer + _buffered);
+            _buffered += msgLen;
 
-                out += _blocksize;
-                msg += _blocksize;
-                outlen += _blocksize;
-                msgLen -= _blocksize;
+            if (inPlace && written > 0) {
+                std::memmove(out + written, target, length);
+                std::copy(staged, staged + written, out);
             }
 
-            if (msgLen > 0) {
-                _buffer.insert(_buffer.end(), msg, msg + msgLen);
+            return outlen;
+        }
+
+        // gathers msg from n fragments and scatters the output over m fragments, which may describe the same memory
+        size_t update(const iovec* in, size_t n, const iovec* out, size_t m)
+        {
+            uint8_t block[MAX_BLOCKSIZE];
+            size_t outlen = 0;
+            size_t j = 0;
+            size_t offset = 0;
+
+            auto scatter = [&](const uint8_t* src, size_t length) {
+                while (length > 0) {
+                    if (j == m) {
+                        throw "Illegal length";
+                    }
+
+                    auto chunk = std::min(length, out[j].iov_len - offset);
+                    std::copy(src, src + chunk, static_cast<uint8_t*>(out[j].iov_base) + offset);
+
+                    src += chunk;
+                    length -= chunk;
+                    offset += chunk;
+                    if (offset == out[j].iov_len) {
+                        j += 1;
+                        offset = 0;
+                    }
+                }
+            };
+
+            for (size_t i = 0; i < n; ++i) {
+                auto msg = static_cast<const uint8_t*>(in[i].iov_base);
+                auto msgLen = in[i].iov_len;
+
+                while (msgLen > 0) {
+                    while (j < m && offset == out[j].iov_len) {
+                        j += 1;
+                        offset = 0;
+                    }
+
+                    auto room = (j < m) ? out[j].iov_len - offset : 0;
+                    auto dst = (j < m) ? static_cast<uint8_t*>(out[j].iov_base) + offset : nullptr;
+
+                    // the multi-block path runs over the whole fragment when its output fits
+                    if (outputSize(msgLen) <= room) {
+                        auto written = update(dst, msg, msgLen);
+                        offset += written;
+                        outlen += written;
+                        break;
+                    }
+
+                    // otherwise feed just enough for the blocks that fit, or for one block straddling fragments
+                    auto blocks = std::max(room / _blocksize, static_cast<size_t>(1));
+                    auto feed = blocks * _blocksize + holdback() - _buffered;
+
+                    if (room >= _blocksize) {
+                        offset += update(dst, msg, feed);
+                    } else {
+                        update(block, msg, feed);
+                        scatter(block, _blocksize);
+                    }
+
+                    outlen += blocks * _blocksize;
+                    msg += feed;
+                    msgLen -= feed;
+                }
             }
 
             return outlen;
@@ -103,10 +232,31 @@ namespace mockup { namespace crypto {
         size_t doFinal(uint8_t* out, const uint8_t* msg, size_t msgLen) 
         {
             auto outlen = update(out, msg, msgLen);
-            outlen += doFinal(out);
+            outlen += doFinal(out + outlen);
 
             return outlen;
         }
+
+#if __cplusplus >= 202002L
+        size_t update(std::span<uint8_t> out, std::span<const uint8_t> msg)
+        {
+            if (out.size() < outputSize(msg.size())) {
+                throw "Illegal length";
+            }
+
+            return update(out.data(), msg.data(), msg.size());
+        }
+
+        // out should have room for the buffered bytes, msg and one more block of padding or tag
+        size_t doFinal(std::span<uint8_t> out, std::span<const uint8_t> msg)
+        {
+            if (out.size() < _buffered + msg.size() + _blocksize) {
+                throw "Illegal length";
+            }
+
+            return doFinal(out.data(), msg.data(), msg.size());
+        }
+#endif
     };
 }}
 
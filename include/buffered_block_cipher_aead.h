@@ -27,10 +27,15 @@
 
 #include "buffered_block_cipher.h"
 
+#include <algorithm>
+
 namespace mockup { namespace crypto {
 
     class BufferedBlockCipherAead : public BufferedBlockCipher 
     {
+    protected:
+        size_t _taglen;
+
     public:
         BufferedBlockCipherAead() {};
         virtual ~BufferedBlockCipherAead() {};
@@ -40,56 +45,75 @@ namespace mockup { namespace crypto {
             throw "taglen should be specified";
         }
 
-        size_t update(uint8_t* out, const uint8_t* msg, size_t msgLen)
+        using BufferedBlockCipher::doFinal;
+
+        // AAD gathered from count fragments, with blocks straddling fragments buffered by the mode
+        void updateAAD(const iovec* aad, size_t count)
         {
-            auto outlen = 0;
-
-            if (_buffer.size() > 0) {
-                if (_buffer.size() + msgLen >= _blocksize) {
-                    auto gap = _blocksize - _buffer.size();
-                    _buffer.insert(_buffer.end(), msg, msg + gap);
-                    updateBlock(out, _buffer.data());
-
-                    _buffer.clear();
-                    
-                    out += _blocksize;
-                    msg += gap;
-                    outlen += _blocksize;
-                    msgLen -= gap;
-
-                } else {
-                    _buffer.insert(_buffer.end(), msg, msg + msgLen);
-                    msgLen = 0;
-                }
+            for (size_t i = 0; i < count; ++i) {
+                updateAAD(static_cast<const uint8_t*>(aad[i].iov_base), aad[i].iov_len);
             }
+        }
 
-            while (msgLen >= _blocksize) {
-                updateBlock(out, msg);
-
-                out += _blocksize;
-                msg += _blocksize;
-                outlen += _blocksize;
-                msgLen -= _blocksize;
+        // decrypts in = ciphertext||tag into out, which is cleared when the tag does not match
+        bool decryptAndVerify(uint8_t* out, const uint8_t* iv, size_t ivLen, const uint8_t* aad, size_t aadlen, const uint8_t* in, size_t inlen, size_t taglen)
+        {
+            if (inlen < taglen) {
+                return false;
             }
 
-            if (msgLen > 0) {
-                _buffer.insert(_buffer.end(), msg, msg + msgLen);
+            initMode(CipherMode::DECRYPT, iv, ivLen, taglen);
+            updateAAD(aad, aadlen);
+
+            size_t outlen = update(out, in, inlen);
+            size_t finallen = 0;
+            auto verified = verifyFinal(out + outlen, finallen);
+
+            if (verified == false) {
+                std::fill(out, out + inlen - taglen, 0);
             }
 
-            return outlen;
+            return verified;
         }
 
-        size_t doFinal(uint8_t* out, const uint8_t* msg, size_t count)
+        // one-shot record API, where this instance after initCipher is the precomputed key context.
+        // Every call resets the per message state, and neither call allocates.
+
+        // out = ciphertext||tag, which is msglen + taglen bytes long
+        size_t seal(uint8_t* out, const uint8_t* nonce, size_t nonceLen, const uint8_t* aad, size_t aadlen, const uint8_t* msg, size_t msglen, size_t taglen)
         {
-            auto outlen = update(out, msg, count);
-            outlen += doFinal(out);
+            initMode(CipherMode::ENCRYPT, nonce, nonceLen, taglen);
+            updateAAD(aad, aadlen);
+
+            auto outlen = update(out, msg, msglen);
+            outlen += doFinal(out + outlen);
+
             return outlen;
         }
 
+        // in = ciphertext||tag, out = plaintext of inlen - taglen bytes, which is cleared when the tag does not match
+        size_t open(uint8_t* out, const uint8_t* nonce, size_t nonceLen, const uint8_t* aad, size_t aadlen, const uint8_t* in, size_t inlen, size_t taglen)
+        {
+            if (decryptAndVerify(out, nonce, nonceLen, aad, aadlen, in, inlen, taglen) == false) {
+                throw "Invalid tag";
+            }
+
+            return inlen - taglen;
+        }
+
         virtual const std::string name() const = 0;
         virtual void initMode(CipherMode mode, const uint8_t* iv, size_t ivLen, size_t taglen) = 0;
         virtual void updateAAD(const uint8_t* aad, size_t aadlen) = 0;
         virtual size_t doFinal(uint8_t* out) = 0;
+
+    protected:
+        virtual bool verifyFinal(uint8_t* out, size_t& outlen) = 0;
+
+        // while decrypting, the last taglen bytes seen may be the tag, so they stay buffered until doFinal
+        size_t holdback() const override
+        {
+            return (_mode == CipherMode::DECRYPT) ? _taglen : 0;
+        }
     };
 }}
 
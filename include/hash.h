@@ -26,8 +26,14 @@
 #define __MOCKUP_CRYPTO_HASH_H__
 
 #include "named_algorithm.h"
+#include <algorithm>
+#include <memory>
 #include <vector>
 
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
 namespace mockup { namespace crypto { 
 
     class Hash : public NamedAlgorithm {
@@ -40,7 +46,31 @@ namespace mockup { namespace crypto {
 
         virtual void init() = 0;
         virtual void update(const uint8_t* data, size_t length) = 0;
-        virtual std::vector<uint8_t> doFinal() = 0;
+
+        // writes outputsize() bytes of digest to out and returns that length
+        virtual size_t doFinal(uint8_t* out) = 0;
+
+        // an independent copy of the midstate, which continues from the same position
+        virtual std::shared_ptr<Hash> clone() const = 0;
+
+        // copies the midstate of snapshot without allocating; it should be the same algorithm
+        virtual void restore(const Hash& snapshot) = 0;
+
+        // name, processed length, chaining value and buffered bytes, with every integer in big endian
+        virtual std::vector<uint8_t> serialize() const = 0;
+        virtual void deserialize(const uint8_t* data, size_t length) = 0;
+
+        void deserialize(const std::vector<uint8_t>& data)
+        {
+            deserialize(data.data(), data.size());
+        }
+
+        std::vector<uint8_t> doFinal()
+        {
+            std::vector<uint8_t> digest(outputsize());
+            doFinal(digest.data());
+            return digest;
+        }
 
         void update(const std::vector<uint8_t>& data) 
         {
@@ -53,6 +83,63 @@ namespace mockup { namespace crypto {
             auto digest = doFinal();
             return digest;
         }
+
+#if __cplusplus >= 202002L
+        size_t doFinal(std::span<uint8_t> out)
+        {
+            if (out.size() < outputsize()) {
+                throw "Illegal length";
+            }
+
+            return doFinal(out.data());
+        }
+#endif
+
+    protected:
+        static void appendBigEndian(std::vector<uint8_t>& out, uint64_t value, size_t size)
+        {
+            for (auto i = size; i > 0; --i) {
+                out.push_back(static_cast<uint8_t>(value >> (8 * (i - 1))));
+            }
+        }
+
+        static uint64_t readBigEndian(const uint8_t*& in, size_t size)
+        {
+            uint64_t value = 0;
+            for (size_t i = 0; i < size; ++i) {
+                value = (value << 8) | *in++;
+            }
+            return value;
+        }
+
+        // the serialized state starts with the name so that it is never restored into another algorithm
+        std::vector<uint8_t> serializeHeader(uint64_t processed) const
+        {
+            auto title = name();
+
+            std::vector<uint8_t> out(1 + title.size());
+            out[0] = static_cast<uint8_t>(title.size());
+            std::copy(title.begin(), title.end(), out.begin() + 1);
+            appendBigEndian(out, processed, 8);
+
+            return out;
+        }
+
+        // checks the header and returns the processed length, leaving data and length past it
+        uint64_t deserializeHeader(const uint8_t*& data, size_t& length) const
+        {
+            auto title = name();
+            auto headerLength = 1 + title.size() + 8;
+
+            if (length < headerLength || data[0] != title.size() || !std::equal(title.begin(), title.end(), data + 1)) {
+                throw "Illegal state";
+            }
+
+            data += 1 + title.size();
+            length -= headerLength;
+
+            return readBigEndian(data, 8);
+        }
     };
 }}
 
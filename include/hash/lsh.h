@@ -33,31 +33,38 @@
 
 namespace mockup { namespace crypto { namespace hash {
 
-    template <typename WORD_T, size_t NUM_STEPS>
+    // the widest instruction set a Lsh instance may use, lowered to what the cpu supports
+    enum class LshSimd {
+        NONE,
+        SSSE3,
+        AVX2
+    };
+
+    // the rotation amounts, step constants and initial values come from DERIVED at compile time,
+    // so an instance holds nothing but its chaining state and block buffer
+    template <typename DERIVED, typename WORD_T, size_t NUM_STEPS>
     class Lsh : public Hash, public ArxPrimitive<WORD_T> 
     {
-        using Arx = ArxPrimitive<WORD_T>;
+    public:
+        static constexpr size_t BLOCKSIZE = sizeof(WORD_T) << 5;
 
     protected:
+        static constexpr size_t _blocksize = BLOCKSIZE;
 
-        const size_t _blocksize;
         size_t _blk_offset;
+        uint64_t _processed;
         size_t _output_length;
 
-        WORD_T _alpha1, _alpha2;
-        WORD_T _beta1, _beta2;
-        std::array<WORD_T, 8> _gamma;
-        std::array<WORD_T, 8 * NUM_STEPS> _step_constant;
-
-        std::array<WORD_T, 16 * (NUM_STEPS + 1)> _msg;
         std::array<WORD_T, 16> _state;
-        std::array<WORD_T, 16> _tmp_state;
+        std::array<uint8_t, BLOCKSIZE> _block;
 
-        std::array<uint8_t, sizeof(WORD_T) << 5> _block;
+        LshSimd _simd;
 
     public:
+        using Hash::update;
+        using Hash::doFinal;
 
-        Lsh() : _blocksize(sizeof(WORD_T) << 5) {}
+        Lsh() : _blk_offset(0), _processed(0), _simd(LshSimd::NONE) {}
         virtual ~Lsh() {}
 
         virtual size_t blocksize() const override {
@@ -68,6 +75,10 @@ namespace mockup { namespace crypto { namespace hash {
             return _output_length;
         }
 
+        LshSimd simd() const {
+            return _simd;
+        }
+
         const std::string name() const override
         {
             std::stringstream ss;
@@ -78,29 +89,31 @@ namespace mockup { namespace crypto { namespace hash {
         virtual void init() override
         {
             _blk_offset = 0;
-            _tmp_state.fill(0);
-            _msg.fill(0);
+            _processed = 0;
             _block.fill(0);
         }
 
         void update(const uint8_t* data, size_t length) override
         {            
+            _processed += length;
+
             size_t gap = _blocksize - _blk_offset;
 
             if (length >= gap) {
                 std::copy(data, data + gap, std::begin(_block) + _blk_offset);
-                compress(_block.data());
+                compressBlocks(_block.data(), 1);
 
                 _blk_offset = 0;
                 data += gap;
                 length -= gap;
             } 
             
-            while (length >= _blocksize) {
-                compress(data);
+            if (length >= _blocksize) {
+                auto count = length / _blocksize;
+                compressBlocks(data, count);
                 
-                data += _blocksize;
-                length -= _blocksize;
+                data += count * _blocksize;
+                length -= count * _blocksize;
             }
 
             if (length > 0) {
@@ -109,139 +122,365 @@ namespace mockup { namespace crypto { namespace hash {
             }
         }
 
-        std::vector<uint8_t> doFinal() override
+        size_t doFinal(uint8_t* out) override
         {
-            std::vector<uint8_t> output;
-            output.assign(_output_length, 0);
-
             _block[_blk_offset++] = static_cast<uint8_t>(0x80);
             std::fill(std::begin(_block) + _blk_offset, std::end(_block), 0);
-            compress(_block.data());
+            compressBlocks(_block.data(), 1);
 
             const auto lhs = reinterpret_cast<uint8_t*>(_state.data());
             const auto rhs = reinterpret_cast<uint8_t*>(_state.data() + 8);            
-            ArxPrimitive<WORD_T>::xor_array(output.data(), lhs, rhs, _output_length);
+            ArxPrimitive<WORD_T>::xor_array(out, lhs, rhs, _output_length);
 
             init();
 
-            return output;
+            return _output_length;
         }
 
-    private:
+        std::shared_ptr<Hash> clone() const override
+        {
+            return std::make_shared<DERIVED>(static_cast<const DERIVED&>(*this));
+        }
 
-        void expand_message(const uint8_t* in) 
+        void restore(const Hash& snapshot) override
         {
-            const WORD_T* ptr = (const WORD_T*) in;
-            std::copy(ptr, ptr + 32, std::begin(_msg));
-
-            for (size_t i = 2; i <= NUM_STEPS; ++i) {
-                size_t idx = 16 * i;
-                _msg[idx     ] = _msg[idx - 16] + _msg[idx - 29];
-                _msg[idx +  1] = _msg[idx - 15] + _msg[idx - 30];
-                _msg[idx +  2] = _msg[idx - 14] + _msg[idx - 32];
-                _msg[idx +  3] = _msg[idx - 13] + _msg[idx - 31];
-                _msg[idx +  4] = _msg[idx - 12] + _msg[idx - 25];
-                _msg[idx +  5] = _msg[idx - 11] + _msg[idx - 28];
-                _msg[idx +  6] = _msg[idx - 10] + _msg[idx - 27];
-                _msg[idx +  7] = _msg[idx -  9] + _msg[idx - 26];
-                _msg[idx +  8] = _msg[idx -  8] + _msg[idx - 21];
-                _msg[idx +  9] = _msg[idx -  7] + _msg[idx - 22];
-                _msg[idx + 10] = _msg[idx -  6] + _msg[idx - 24];
-                _msg[idx + 11] = _msg[idx -  5] + _msg[idx - 23];
-                _msg[idx + 12] = _msg[idx -  4] + _msg[idx - 17];
-                _msg[idx + 13] = _msg[idx -  3] + _msg[idx - 20];
-                _msg[idx + 14] = _msg[idx -  2] + _msg[idx - 19];
-                _msg[idx + 15] = _msg[idx -  1] + _msg[idx - 18];
+            auto other = dynamic_cast<const Lsh*>(&snapshot);
+            if (other == nullptr || other->_output_length != _output_length) {
+                throw "Illegal state";
             }
+
+            _blk_offset = other->_blk_offset;
+            _processed = other->_processed;
+            _state = other->_state;
+            std::copy(other->_block.begin(), other->_block.begin() + _blk_offset, _block.begin());
         }
 
-        void permute_word() 
+        std::vector<uint8_t> serialize() const override
         {
-            _state[ 0] = _tmp_state[ 6];
-            _state[ 1] = _tmp_state[ 4];
-            _state[ 2] = _tmp_state[ 5];
-            _state[ 3] = _tmp_state[ 7];
-            
-            _state[ 4] = _tmp_state[12];
-            _state[ 5] = _tmp_state[15];
-            _state[ 6] = _tmp_state[14];
-            _state[ 7] = _tmp_state[13];
+            auto out = this->serializeHeader(_processed);
+            for (auto word : _state) {
+                this->appendBigEndian(out, word, sizeof(WORD_T));
+            }
+            out.insert(out.end(), _block.begin(), _block.begin() + _blk_offset);
+
+            return out;
+        }
+
+        void deserialize(const uint8_t* data, size_t length) override
+        {
+            auto processed = this->deserializeHeader(data, length);
+            auto buffered = processed % _blocksize;
+
+            if (length != sizeof(_state) + buffered) {
+                throw "Illegal state";
+            }
 
-            _state[ 8] = _tmp_state[ 2];
-            _state[ 9] = _tmp_state[ 0];
-            _state[10] = _tmp_state[ 1];
-            _state[11] = _tmp_state[ 3];
+            for (auto& word : _state) {
+                word = this->readBigEndian(data, sizeof(WORD_T));
+            }
+            std::copy(data, data + buffered, _block.begin());
 
-            _state[12] = _tmp_state[ 8];
-            _state[13] = _tmp_state[11];
-            _state[14] = _tmp_state[10];
-            _state[15] = _tmp_state[ 9];
+            _blk_offset = buffered;
+            _processed = processed;
         }
 
-        void step(size_t idx, WORD_T alpha, WORD_T beta)
+        using Hash::deserialize;
+
+    protected:
+        static LshSimd supported(LshSimd requested)
         {
-            WORD_T lhs, rhs;
+            if (requested == LshSimd::AVX2 && __builtin_cpu_supports("avx2")) {
+                return LshSimd::AVX2;
+            }
+
+            if (requested != LshSimd::NONE && __builtin_cpu_supports("ssse3")) {
+                return LshSimd::SSSE3;
+            }
+
+            return LshSimd::NONE;
+        }
+
+        // compresses count consecutive blocks, overridden by the vectorized variants
+        virtual void compressBlocks(const uint8_t* data, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i) {
+                compress(data);
+                data += _blocksize;
+            }
+        }
+
+    public:
+        // the step and the message expansion are generic over V, a word or a vector holding one word of each
+        // multi-buffer lane, so the same code compresses one message here and several in lsh_multi_buffer.cpp
+
+        // msg holds the sub-messages of the even and the odd steps, and the one of step i is replaced by the one of step i + 2
+        template <typename V>
+        __attribute__((always_inline))
+        static inline void expand_message(V* msg, size_t i)
+        {
+            auto cur = msg + 16 * (i & 1);
+            auto next = msg + 16 * ((i + 1) & 1);
+
+            for (size_t k = 0; k < 16; k += 8) {
+                auto w0 = cur[k], w1 = cur[k + 1], w2 = cur[k + 2], w3 = cur[k + 3];
+                auto w4 = cur[k + 4], w5 = cur[k + 5], w6 = cur[k + 6], w7 = cur[k + 7];
+
+                cur[k    ] = next[k    ] + w3;
+                cur[k + 1] = next[k + 1] + w2;
+                cur[k + 2] = next[k + 2] + w0;
+                cur[k + 3] = next[k + 3] + w1;
+                cur[k + 4] = next[k + 4] + w7;
+                cur[k + 5] = next[k + 5] + w4;
+                cur[k + 6] = next[k + 6] + w5;
+                cur[k + 7] = next[k + 7] + w6;
+            }
+        }
+
+        template <typename V>
+        __attribute__((always_inline))
+        static inline void permute_word(V* state, const V* tmp)
+        {
+            state[ 0] = tmp[ 6];
+            state[ 1] = tmp[ 4];
+            state[ 2] = tmp[ 5];
+            state[ 3] = tmp[ 7];
+            
+            state[ 4] = tmp[12];
+            state[ 5] = tmp[15];
+            state[ 6] = tmp[14];
+            state[ 7] = tmp[13];
+
+            state[ 8] = tmp[ 2];
+            state[ 9] = tmp[ 0];
+            state[10] = tmp[ 1];
+            state[11] = tmp[ 3];
+
+            state[12] = tmp[ 8];
+            state[13] = tmp[11];
+            state[14] = tmp[10];
+            state[15] = tmp[ 9];
+        }
+
+        template <WORD_T ALPHA, WORD_T BETA, typename V>
+        __attribute__((always_inline))
+        static inline void step(V* state, const V* msg, size_t idx)
+        {
+            constexpr size_t bits = 8 * sizeof(WORD_T);
+            V tmp[16];
+
+            // unrolled so that every gamma is a constant, the rotation by zero kept defined by the modulo
+            #pragma GCC unroll 8
             for (size_t col = 0; col < 8; ++col) {
-                lhs = _state[col    ] ^ _msg[16 * idx + col    ];
-                rhs = _state[col + 8] ^ _msg[16 * idx + col + 8];
+                V lhs = state[col    ] ^ msg[16 * (idx & 1) + col    ];
+                V rhs = state[col + 8] ^ msg[16 * (idx & 1) + col + 8];
 
-                lhs = Arx::rotl(lhs + rhs, alpha) ^ _step_constant[8 * idx + col];
-                rhs = Arx::rotl(lhs + rhs, beta);
-                
-                _tmp_state[col    ] = lhs + rhs;
-                _tmp_state[col + 8] = Arx::rotl(rhs, _gamma[col]);
+                V sum = lhs + rhs;
+                lhs = ((sum << ALPHA) | (sum >> (bits - ALPHA))) ^ DERIVED::STEP_CONSTANTS[8 * idx + col];
+                sum = lhs + rhs;
+                rhs = (sum << BETA) | (sum >> (bits - BETA));
+
+                tmp[col    ] = lhs + rhs;
+                tmp[col + 8] = (rhs << DERIVED::GAMMA[col]) | (rhs >> ((bits - DERIVED::GAMMA[col]) % bits));
             }
 
-            permute_word();
+            permute_word(state, tmp);
         }
 
+    private:
+
         void compress(const uint8_t* data)
         {
-            expand_message(data);
+            WORD_T msg[32];
+            const WORD_T* ptr = (const WORD_T*) data;
+            std::copy(ptr, ptr + 32, msg);
 
             for (size_t i = 0; i < NUM_STEPS; i += 2) {
-                step(i    , _alpha1, _beta1);
-                step(i + 1, _alpha2, _beta2);
+                step<DERIVED::ALPHA_EVEN, DERIVED::BETA_EVEN>(_state.data(), msg, i);
+                expand_message(msg, i);
+                step<DERIVED::ALPHA_ODD, DERIVED::BETA_ODD>(_state.data(), msg, i + 1);
+                expand_message(msg, i + 1);
             }
 
+            // NUM_STEPS is even, so the last sub-message sits in the even slot
             for (size_t i = 0; i < 16; ++i) {
-                _state[i] ^= _msg[16 * NUM_STEPS + i];
+                _state[i] ^= msg[i];
             }
         }
 
     };
 
-    using Lsh256_t = Lsh<uint32_t, 26>;
-    using Lsh512_t = Lsh<uint64_t, 28>;
+    class Lsh256;
+    class Lsh512;
+
+    using Lsh256_t = Lsh<Lsh256, uint32_t, 26>;
+    using Lsh512_t = Lsh<Lsh512, uint64_t, 28>;
 
     class Lsh256 : public Lsh256_t
     {
+    public:
+        static constexpr uint32_t ALPHA_EVEN = 29;
+        static constexpr uint32_t BETA_EVEN = 1;
+        static constexpr uint32_t ALPHA_ODD = 5;
+        static constexpr uint32_t BETA_ODD = 17;
+
+        static constexpr uint32_t GAMMA[8] = {0, 8, 16, 24, 24, 16, 8, 0};
+
+        alignas(32) static constexpr uint32_t STEP_CONSTANTS[8 * 26] = {
+            0x917caf90, 0x6c1b10a2, 0x6f352943, 0xcf778243, 0x2ceb7472, 0x29e96ff2, 0x8a9ba428, 0x2eeb2642,
+            0x0e2c4021, 0x872bb30e, 0xa45e6cb2, 0x46f9c612, 0x185fe69e, 0x1359621b, 0x263fccb2, 0x1a116870,
+            0x3a6c612f, 0xb2dec195, 0x02cb1f56, 0x40bfd858, 0x784684b6, 0x6cbb7d2e, 0x660c7ed8, 0x2b79d88a,
+            0xa6cd9069, 0x91a05747, 0xcdea7558, 0x00983098, 0xbecb3b2e, 0x2838ab9a, 0x728b573e, 0xa55262b5,
+            0x745dfa0f, 0x31f79ed8, 0xb85fce25, 0x98c8c898, 0x8a0669ec, 0x60e445c2, 0xfde295b0, 0xf7b5185a,
+            0xd2580983, 0x29967709, 0x182df3dd, 0x61916130, 0x90705676, 0x452a0822, 0xe07846ad, 0xaccd7351,
+            0x2a618d55, 0xc00d8032, 0x4621d0f5, 0xf2f29191, 0x00c6cd06, 0x6f322a67, 0x58bef48d, 0x7a40c4fd,
+            0x8beee27f, 0xcd8db2f2, 0x67f2c63b, 0xe5842383, 0xc793d306, 0xa15c91d6, 0x17b381e5, 0xbb05c277,
+            0x7ad1620a, 0x5b40a5bf, 0x5ab901a2, 0x69a7a768, 0x5b66d9cd, 0xfdee6877, 0xcb3566fc, 0xc0c83a32,
+            0x4c336c84, 0x9be6651a, 0x13baa3fc, 0x114f0fd1, 0xc240a728, 0xec56e074, 0x009c63c7, 0x89026cf2,
+            0x7f9ff0d0, 0x824b7fb5, 0xce5ea00f, 0x605ee0e2, 0x02e7cfea, 0x43375560, 0x9d002ac7, 0x8b6f5f7b,
+            0x1f90c14f, 0xcdcb3537, 0x2cfeafdd, 0xbf3fc342, 0xeab7b9ec, 0x7a8cb5a3, 0x9d2af264, 0xfacedb06,
+            0xb052106e, 0x99006d04, 0x2bae8d09, 0xff030601, 0xa271a6d6, 0x0742591d, 0xc81d5701, 0xc9a9e200,
+            0x02627f1e, 0x996d719d, 0xda3b9634, 0x02090800, 0x14187d78, 0x499b7624, 0xe57458c9, 0x738be2c9,
+            0x64e19d20, 0x06df0f36, 0x15d1cb0e, 0x0b110802, 0x2c95f58c, 0xe5119a6d, 0x59cd22ae, 0xff6eac3c,
+            0x467ebd84, 0xe5ee453c, 0xe79cd923, 0x1c190a0d, 0xc28b81b8, 0xf6ac0852, 0x26efd107, 0x6e1ae93b,
+            0xc53c41ca, 0xd4338221, 0x8475fd0a, 0x35231729, 0x4e0d3a7a, 0xa2b45b48, 0x16c0d82d, 0x890424a9,
+            0x017e0c8f, 0x07b5a3f5, 0xfa73078e, 0x583a405e, 0x5b47b4c8, 0x570fa3ea, 0xd7990543, 0x8d28ce32,
+            0x7f8a9b90, 0xbd5998fc, 0x6d7a9688, 0x927a9eb6, 0xa2fc7d23, 0x66b38e41, 0x709e491a, 0xb5f700bf,
+            0x0a262c0f, 0x16f295b9, 0xe8111ef5, 0x0d195548, 0x9f79a0c5, 0x1a41cfa7, 0x0ee7638a, 0xacf7c074,
+            0x30523b19, 0x09884ecf, 0xf93014dd, 0x266e9d55, 0x191a6664, 0x5c1176c1, 0xf64aed98, 0xa4b83520,
+            0x828d5449, 0x91d71dd8, 0x2944f2d6, 0x950bf27b, 0x3380ca7d, 0x6d88381d, 0x4138868e, 0x5ced55c4,
+            0x0fe19dcb, 0x68f4f669, 0x6e37c8ff, 0xa0fe6e10, 0xb44b47b0, 0xf5c0558a, 0x79bf14cf, 0x4a431a20,
+            0xf17f68da, 0x5deb5fd1, 0xa600c86d, 0x9f6c7eb0, 0xff92f864, 0xb615e07f, 0x38d3e448, 0x8d5d3a6a,
+            0x70e843cb, 0x494b312e, 0xa6c93613, 0x0beb2f4f, 0x928b5d63, 0xcbf66035, 0x0cb82c80, 0xea97a4f7,
+            0x592c0f3b, 0x947c5f77, 0x6fff49b9, 0xf71a7e5a, 0x1de8c0f5, 0xc2569600, 0xc4e4ac8c, 0x823c9ce1
+        };
+
+        static constexpr uint32_t IV_224[16] = {
+            0x068608D3, 0x62D8F7A7, 0xD76652AB, 0x4C600A43, 0xBDC40AA8, 0x1ECA0B68, 0xDA1A89BE, 0x3147D354,
+            0x707EB4F9, 0xF65B3862, 0x6B0B2ABE, 0x56B8EC0A, 0xCF237286, 0xEE0D1727, 0x33636595, 0x8BB8D05F,
+        };
+
+        static constexpr uint32_t IV_256[16] = {
+            0x46a10f1f, 0xfddce486, 0xb41443a8, 0x198e6b9d, 0x3304388d, 0xb0f5a3c7, 0xb36061c4, 0x7adbd553,
+            0x105d5378, 0x2f74de54, 0x5c2f2d95, 0xf2553fbe, 0x8051357a, 0x138668c8, 0x47aa4484, 0xe01afb41,
+        };
+
     public:
         Lsh256();
-        Lsh256(size_t outlen);
+        Lsh256(size_t outlen, LshSimd simd = LshSimd::AVX2);
         ~Lsh256();
 
         void init();
 
-    private:
-        void init224();
-        void init256();
+    protected:
+        void compressBlocks(const uint8_t* data, size_t count) override;
     };
 
     class Lsh512 : public Lsh512_t
     {
+    public:
+        static constexpr uint64_t ALPHA_EVEN = 23;
+        static constexpr uint64_t BETA_EVEN = 59;
+        static constexpr uint64_t ALPHA_ODD = 7;
+        static constexpr uint64_t BETA_ODD = 3;
+
+        static constexpr uint64_t GAMMA[8] = {0, 16, 32, 48, 8, 24, 40, 56};
+
+        alignas(32) static constexpr uint64_t STEP_CONSTANTS[8 * 28] = {
+            0x97884283c938982aL, 0xba1fca93533e2355L, 0xc519a2e87aeb1c03L, 0x9a0fc95462af17b1L,
+            0xfc3dda8ab019a82bL, 0x02825d079a895407L, 0x79f2d0a7ee06a6f7L, 0xd76d15eed9fdf5feL,
+            0x1fcac64d01d0c2c1L, 0xd9ea5de69161790fL, 0xdebc8b6366071fc8L, 0xa9d91db711c6c94bL,
+            0x3a18653ac9c1d427L, 0x84df64a223dd5b09L, 0x6cc37895f4ad9e70L, 0x448304c8d7f3f4d5L,
+            0xea91134ed29383e0L, 0xc4484477f2da88e8L, 0x9b47eec96d26e8a6L, 0x82f6d4c8d89014f4L,
+            0x527da0048b95fb61L, 0x644406c60138648dL, 0x303c0e8aa24c0edcL, 0xc787cda0cbe8ca19L,
+            0x7ba46221661764caL, 0x0c8cbc6acd6371acL, 0xe336b836940f8f41L, 0x79cb9da168a50976L,
+            0xd01da49021915cb3L, 0xa84accc7399cf1f1L, 0x6c4a992cee5aeb0cL, 0x4f556e6cb4b2e3e0L,
+            0x200683877d7c2f45L, 0x9949273830d51db8L, 0x19eeeecaa39ed124L, 0x45693f0a0dae7fefL,
+            0xedc234b1b2ee1083L, 0xf3179400d68ee399L, 0xb6e3c61b4945f778L, 0xa4c3db216796c42fL,
+            0x268a0b04f9ab7465L, 0xe2705f6905f2d651L, 0x08ddb96e426ff53dL, 0xaea84917bc2e6f34L,
+            0xaff6e664a0fe9470L, 0x0aab94d765727d8cL, 0x9aa9e1648f3d702eL, 0x689efc88fe5af3d3L,
+            0xb0950ffea51fd98bL, 0x52cfc86ef8c92833L, 0xe69727b0b2653245L, 0x56f160d3ea9da3e2L,
+            0xa6dd4b059f93051fL, 0xb6406c3cd7f00996L, 0x448b45f3ccad9ec8L, 0x079b8587594ec73bL,
+            0x45a50ea3c4f9653bL, 0x22983767c1f15b85L, 0x7dbed8631797782bL, 0x485234be88418638L,
+            0x842850a5329824c5L, 0xf6aca914c7f9a04cL, 0xcfd139c07a4c670cL, 0xa3210ce0a8160242L,
+            0xeab3b268be5ea080L, 0xbacf9f29b34ce0a7L, 0x3c973b7aaf0fa3a8L, 0x9a86f346c9c7be80L,
+            0xac78f5d7cabcea49L, 0xa355bddcc199ed42L, 0xa10afa3ac6b373dbL, 0xc42ded88be1844e5L,
+            0x9e661b271cff216aL, 0x8a6ec8dd002d8861L, 0xd3d2b629beb34be4L, 0x217a3a1091863f1aL,
+            0x256ecda287a733f5L, 0xf9139a9e5b872fe5L, 0xac0535017a274f7cL, 0xf21b7646d65d2aa9L,
+            0x048142441c208c08L, 0xf937a5dd2db5e9ebL, 0xa688dfe871ff30b7L, 0x9bb44aa217c5593bL,
+            0x943c702a2edb291aL, 0x0cae38f9e2b715deL, 0xb13a367ba176cc28L, 0x0d91bd1d3387d49bL,
+            0x85c386603cac940cL, 0x30dd830ae39fd5e4L, 0x2f68c85a712fe85dL, 0x4ffeecb9dd1e94d6L,
+            0xd0ac9a590a0443aeL, 0xbae732dc99ccf3eaL, 0xeb70b21d1842f4d9L, 0x9f4eda50bb5c6fa8L,
+            0x4949e69ce940a091L, 0x0e608dee8375ba14L, 0x983122cba118458cL, 0x4eeba696fbb36b25L,
+            0x7d46f3630e47f27eL, 0xa21a0f7666c0dea4L, 0x5c22cf355b37cec4L, 0xee292b0c17cc1847L,
+            0x9330838629e131daL, 0x6eee7c71f92fce22L, 0xc953ee6cb95dd224L, 0x3a923d92af1e9073L,
+            0xc43a5671563a70fbL, 0xbc2985dd279f8346L, 0x7ef2049093069320L, 0x17543723e3e46035L,
+            0xc3b409b00b130c6dL, 0x5d6aee6b28fdf090L, 0x1d425b26172ff6edL, 0xcccfd041cdaf03adL,
+            0xfe90c7c790ab6cbfL, 0xe5af6304c722ca02L, 0x70f695239999b39eL, 0x6b8b5b07c844954cL,
+            0x77bdb9bb1e1f7a30L, 0xc859599426ee80edL, 0x5f9d813d4726e40aL, 0x9ca0120f7cb2b179L,
+            0x8f588f583c182cbdL, 0x951267cbe9eccce7L, 0x678bb8bd334d520eL, 0xf6e662d00cd9e1b7L,
+            0x357774d93d99aaa7L, 0x21b2edbb156f6eb5L, 0xfd1ebe846e0aee69L, 0x3cb2218c2f642b15L,
+            0xe7e7e7945444ea4cL, 0xa77a33b5d6b9b47cL, 0xf34475f0809f6075L, 0xdd4932dce6bb99adL,
+            0xacec4e16d74451dcL, 0xd4a0a8d084de23d6L, 0x1bdd42f278f95866L, 0xeed3adbb938f4051L,
+            0xcfcf7be8992f3733L, 0x21ade98c906e3123L, 0x37ba66711fffd668L, 0x267c0fc3a255478aL,
+            0x993a64ee1b962e88L, 0x754979556301faaaL, 0xf920356b7251be81L, 0xc281694f22cf923fL,
+            0x9f4b6481c8666b02L, 0xcf97761cfe9f5444L, 0xf220d7911fd63e9fL, 0xa28bd365f79cd1b0L,
+            0xd39f5309b1c4b721L, 0xbec2ceb864fca51fL, 0x1955a0ddc410407aL, 0x43eab871f261d201L,
+            0xeaafe64a2ed16da1L, 0x670d931b9df39913L, 0x12f868b0f614de91L, 0x2e5f395d946e8252L,
+            0x72f25cbb767bd8f4L, 0x8191871d61a1c4ddL, 0x6ef67ea1d450ba93L, 0x2ea32a645433d344L,
+            0x9a963079003f0f8bL, 0x74a0aeb9918cac7aL, 0x0b6119a70af36fa3L, 0x8d9896f202f0d480L,
+            0x654f1831f254cd66L, 0x1318a47f0366a25eL, 0x65752076250b4e01L, 0xd1cd8eb888071772L,
+            0x30c6a9793f4e9b25L, 0x154f684b1e3926eeL, 0x6c7ac0b1fe6312aeL, 0x262f88f4f3c5550dL,
+            0xb4674a24472233cbL, 0x2bbd23826a090071L, 0xda95969b30594f66L, 0x9f5c47408f1e8a43L,
+            0xf77022b88de9c055L, 0x64b7b36957601503L, 0xe73b72b06175c11aL, 0x55b87de8b91a6233L,
+            0x1bb16e6b6955ff7fL, 0xe8e0a5ec7309719cL, 0x702c31cb89a8b640L, 0xfba387cfada8cde2L,
+            0x6792db4677aa164cL, 0x1c6b1cc0b7751867L, 0x22ae2311d736dc01L, 0x0e3666a1d37c9588L,
+            0xcd1fd9d4bf557e9aL, 0xc986925f7c7b0e84L, 0x9c5dfd55325ef6b0L, 0x9f2b577d5676b0ddL,
+            0xfa6e21be21c062b3L, 0x8787dd782c8d7f83L, 0xd0d134e90e12dd23L, 0x449d087550121d96L,
+            0xecf9ae9414d41967L, 0x5018f1dbf789934dL, 0xfa5b52879155a74cL, 0xca82d4d3cd278e7cL,
+            0x688fdfdfe22316adL, 0x0f6555a4ba0d030aL, 0xa2061df720f000f3L, 0xe1a57dc5622fb3daL,
+            0xe6a842a8e8ed8153L, 0x690acdd3811ce09dL, 0x55adda18e6fcf446L, 0x4d57a8a0f4b60b46L,
+            0xf86fbfc20539c415L, 0x74bafa5ec7100d19L, 0xa824151810f0f495L, 0x8723432791e38ebbL,
+            0x8eeaeb91d66ed539L, 0x73d8a1549dfd7e06L, 0x0387f2ffe3f13a9bL, 0xa5004995aac15193L,
+            0x682f81c73efdda0dL, 0x2fb55925d71d268dL, 0xcc392d2901e58a3dL, 0xaa666ab975724a42L,
+        };
+
+        static constexpr uint64_t IV_224[16] = {
+            0x0C401E9FE8813A55L, 0x4A5F446268FD3D35L, 0xFF13E452334F612AL, 0xF8227661037E354AL,
+            0xA5F223723C9CA29DL, 0x95D965A11AED3979L, 0x01E23835B9AB02CCL, 0x52D49CBAD5B30616L,
+            0x9E5C2027773F4ED3L, 0x66A5C8801925B701L, 0x22BBC85B4C6779D9L, 0xC13171A42C559C23L,
+            0x31E2B67D25BE3813L, 0xD522C4DEED8E4D83L, 0xA79F5509B43FBAFEL, 0xE00D2CD88B4B6C6AL,
+        };
+
+        static constexpr uint64_t IV_256[16] = {
+            0x6DC57C33DF989423L, 0xD8EA7F6E8342C199L, 0x76DF8356F8603AC4L, 0x40F1B44DE838223AL,
+            0x39FFE7CFC31484CDL, 0x39C4326CC5281548L, 0x8A2FF85A346045D8L, 0xFF202AA46DBDD61EL,
+            0xCF785B3CD5FCDB8BL, 0x1F0323B64A8150BFL, 0xFF75D972F29EA355L, 0x2E567F30BF1CA9E1L,
+            0xB596875BF8FF6DBAL, 0xFCCA39B089EF4615L, 0xECFF4017D020B4B6L, 0x7E77384C772ED802L,
+        };
+
+        static constexpr uint64_t IV_384[16] = {
+            0x53156A66292808F6L, 0xB2C4F362B204C2BCL, 0xB84B7213BFA05C4EL, 0x976CEB7C1B299F73L,
+            0xDF0CC63C0570AE97L, 0xDA4441BAA486CE3FL, 0x6559F5D9B5F2ACC2L, 0x22DACF19B4B52A16L,
+            0xBBCDACEFDE80953AL, 0xC9891A2879725B3EL, 0x7C9FE6330237E440L, 0xA30BA550553F7431L,
+            0xBB08043FB34E3E30L, 0xA0DEC48D54618EADL, 0x150317267464BC57L, 0x32D1501FDE63DC93L,
+        };
+
+        static constexpr uint64_t IV_512[16] = {
+            0xadd50f3c7f07094eL, 0xe3f3cee8f9418a4fL, 0xb527ecde5b3d0ae9L, 0x2ef6dec68076f501L,
+            0x8cb994cae5aca216L, 0xfbb9eae4bba48cc7L, 0x650a526174725feaL, 0x1f9a61a73f8d8085L,
+            0xb6607378173b539bL, 0x1bc99853b0c0b9edL, 0xdf727fc19b182d47L, 0xdbef360cf893a457L,
+            0x4981f5e570147e80L, 0xd00c4490ca7d3e30L, 0x5d73940c0e4ae1ecL, 0x894085e2edb2d819L,
+        };
+
     public:
         Lsh512();
-        Lsh512(size_t outlen);
+        Lsh512(size_t outlen, LshSimd simd = LshSimd::AVX2);
         ~Lsh512();
 
         void init();
 
-    private:
-        void init224();
-        void init256();
-        void init384();
-        void init512();
+    protected:
+        void compressBlocks(const uint8_t* data, size_t count) override;
     };
 
 }}}
@@ -0,0 +1,189 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MOCKUP_CRYPTO_HASH_MULTI_BUFFER_LANES_H__
+#define __MOCKUP_CRYPTO_HASH_MULTI_BUFFER_LANES_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// shared by the multi-buffer SHA-2 and LSH sources only, not a public interface
+namespace mockup { namespace crypto { namespace hash {
+
+    typedef uint32_t v4_t __attribute__((vector_size(16)));
+    typedef uint32_t v8_t __attribute__((vector_size(32)));
+    typedef uint64_t v2q_t __attribute__((vector_size(16)));
+    typedef uint64_t v4q_t __attribute__((vector_size(32)));
+
+    // transposes N rows of N words into N columns, by log2(N) rounds of interleaving row i with row i + N / 2
+    template <typename V, size_t N>
+    __attribute__((always_inline))
+    static inline void transpose_lanes(V* rows)
+    {
+        V lo, hi;
+        if constexpr (N == 2) {
+            lo = V{0, 2};
+            hi = V{1, 3};
+        } else if constexpr (N == 4) {
+            lo = V{0, 4, 1, 5};
+            hi = V{2, 6, 3, 7};
+        } else {
+            lo = V{0, 8, 1, 9, 2, 10, 3, 11};
+            hi = V{4, 12, 5, 13, 6, 14, 7, 15};
+        }
+
+        for (size_t round = 1; round < N; round <<= 1) {
+            V out[N];
+            for (size_t i = 0; i < N / 2; ++i) {
+                out[2 * i    ] = __builtin_shuffle(rows[i], rows[i + N / 2], lo);
+                out[2 * i + 1] = __builtin_shuffle(rows[i], rows[i + N / 2], hi);
+            }
+            std::copy(out, out + N, rows);
+        }
+    }
+
+    // the first count words of every lane's block, word i of all N lanes in words[i]
+    template <typename V, size_t N>
+    __attribute__((always_inline))
+    static inline void load_lanes(V* words, const uint8_t* const* blocks, size_t count)
+    {
+        constexpr size_t wordsize = sizeof(V) / N;
+
+        // N consecutive words of every lane are loaded as rows and transposed into N message words
+        for (size_t i = 0; i < count; i += N) {
+            for (size_t lane = 0; lane < N; ++lane) {
+                std::memcpy(&words[i + lane], blocks[lane] + i * wordsize, sizeof(V));
+            }
+            transpose_lanes<V, N>(words + i);
+        }
+    }
+
+    // a message on a lane, whose whole blocks are read in place and whose padded tail is copied
+    template <size_t BLOCKSIZE>
+    struct lane_t {
+        bool busy;
+        size_t msg;
+        const uint8_t* data;
+        size_t blocks;
+        size_t tailBlocks;
+        uint8_t tail[2 * BLOCKSIZE];
+    };
+
+    // hashes count messages on numLanes lanes, a lane taking the next message as soon as its own one ends.
+    // HASH gives word_t, STATE_WORDS, BLOCKSIZE and MAX_LANES, and
+    //   pad(tail, remain, length): appends the length to a tail holding the rest of the message and 0x80,
+    //                              and returns the number of tail blocks
+    //   init(state, lane), digest(out, state, lane): over the state kept as state[word * MAX_LANES + lane]
+    template <typename HASH>
+    static void hash_lanes(const HASH& hash, void (*compress)(typename HASH::word_t*, const uint8_t* const*), size_t numLanes,
+        const uint8_t* const* inputs, const size_t* lengths, uint8_t* const* outputs, size_t count)
+    {
+        constexpr size_t BLOCKSIZE = HASH::BLOCKSIZE;
+        constexpr size_t MAX_LANES = HASH::MAX_LANES;
+        static const uint8_t idle[BLOCKSIZE] = {0};
+
+        alignas(32) typename HASH::word_t state[HASH::STATE_WORDS * MAX_LANES];
+        lane_t<BLOCKSIZE> lanes[MAX_LANES];
+        const uint8_t* blocks[MAX_LANES];
+
+        size_t next = 0;
+        size_t active = 0;
+
+        auto load = [&](lane_t<BLOCKSIZE>& lane, size_t index) {
+            auto i = next++;
+            auto length = lengths[i];
+            auto whole = length / BLOCKSIZE * BLOCKSIZE;
+            auto remain = length - whole;
+
+            lane.busy = true;
+            lane.msg = i;
+            lane.data = inputs[i];
+            lane.blocks = whole / BLOCKSIZE;
+
+            std::fill(lane.tail, lane.tail + 2 * BLOCKSIZE, 0);
+            std::copy(inputs[i] + whole, inputs[i] + length, lane.tail);
+            lane.tail[remain] = 0x80;
+            lane.tailBlocks = hash.pad(lane.tail, remain, length);
+
+            hash.init(state, index);
+        };
+
+        for (size_t i = 0; i < numLanes; ++i) {
+            if (next < count) {
+                load(lanes[i], i);
+                active += 1;
+            } else {
+                lanes[i].busy = false;
+            }
+        }
+
+        while (active > 0) {
+            for (size_t i = 0; i < numLanes; ++i) {
+                auto& lane = lanes[i];
+                if (!lane.busy) {
+                    blocks[i] = idle;
+                } else if (lane.blocks > 0) {
+                    blocks[i] = lane.data;
+                } else {
+                    blocks[i] = lane.tail;
+                }
+            }
+
+            compress(state, blocks);
+
+            for (size_t i = 0; i < numLanes; ++i) {
+                auto& lane = lanes[i];
+                if (!lane.busy) {
+                    continue;
+                }
+
+                if (lane.blocks > 0) {
+                    lane.data += BLOCKSIZE;
+                    lane.blocks -= 1;
+                    continue;
+                }
+
+                if (lane.tailBlocks == 2) {
+                    std::copy(lane.tail + BLOCKSIZE, lane.tail + 2 * BLOCKSIZE, lane.tail);
+                    lane.tailBlocks = 1;
+                    continue;
+                }
+
+                // the message is done, so its digest is written out and the lane takes the next message
+                hash.digest(outputs[lane.msg], state, i);
+
+                if (next < count) {
+                    load(lane, i);
+                } else {
+                    lane.busy = false;
+                    active -= 1;
+                }
+            }
+        }
+    }
+}}}
+
+#endif
@@ -25,55 +25,81 @@
 #ifndef __MOCKUP_CRYPTO_HASH_SHA2_H__
 #define __MOCKUP_CRYPTO_HASH_SHA2_H__
 
+#include <algorithm>
 #include <array>
-#include <sstream>
+#include <bit>
+#include <cstring>
 
 #include "../hash.h"
-#include "../arx_primitive.h"
 
 namespace mockup { namespace crypto { namespace hash {
 
-    template <typename WORD_T, size_t NUM_STEPS>
-    class Sha2 : public Hash, public ArxPrimitive<WORD_T>
+    // the round functions, constants and initial value come from DERIVED at compile time, so the rounds inline
+    template <typename DERIVED, typename WORD_T, size_t NUM_STEPS, size_t OUTPUT_SIZE>
+    class Sha2 : public Hash
     {
+    public:
+        static constexpr size_t BLOCKSIZE = 16 * sizeof(WORD_T);
+        static constexpr size_t OUTPUTSIZE = OUTPUT_SIZE;
+
     protected:
+        // the message length is appended as a big endian integer of two words
+        static constexpr size_t LENGTH_OFFSET = BLOCKSIZE - 2 * sizeof(WORD_T);
+
         size_t offset;
-        size_t totalLength;
-        std::vector<uint8_t> block;
-        std::vector<WORD_T> state;
-        std::vector<WORD_T> W;
-        std::vector<WORD_T> H;
-        std::vector<WORD_T> K;
+        uint64_t totalLength;
+        std::array<WORD_T, 8> state;
+        std::array<uint8_t, BLOCKSIZE> block;
 
     public:
-        Sha2() {
-            offset = 0;
-            totalLength = 0;
+        using Hash::update;
+        using Hash::doFinal;
+
+        Sha2()
+        {
+            Sha2::init();
         }
 
         virtual ~Sha2() = default;
 
+        size_t blocksize() const override
+        {
+            return BLOCKSIZE;
+        }
+
+        size_t outputsize() const override
+        {
+            return OUTPUTSIZE;
+        }
+
+        void init() override
+        {
+            offset = 0;
+            totalLength = 0;
+            std::copy(DERIVED::IV, DERIVED::IV + 8, state.begin());
+        }
+
         void update(const uint8_t* data, size_t length) override 
         {
             totalLength += length;
 
-            auto blocksize = block.size();
-            auto gap = blocksize - offset;
+            auto gap = BLOCKSIZE - offset;
 
             if (length >= gap) {
                 std::copy(data, data + gap, block.begin() + offset);
-                updateBlock(block.data());
+                derived().updateBlocks(block.data(), 1);
 
                 offset = 0;
                 data += gap;
                 length -= gap;
             }
 
-            while (length >= blocksize) {
-                updateBlock(data);
+            if (length >= BLOCKSIZE) {
+                auto count = length / BLOCKSIZE;
+                derived().updateBlocks(data, count);
 
-                data += blocksize;
-                length -= blocksize;
+                data += count * BLOCKSIZE;
+                length -= count * BLOCKSIZE;
             }
 
             if (length > 0) {
@@ -83,8 +109,128 @@ namespace mockup { namespace crypto { namespace hash {
             }
         }
 
+        size_t doFinal(uint8_t* out) override
+        {
+            block[offset++] = 0x80;
+            if (offset > LENGTH_OFFSET) {
+                std::fill(block.begin() + offset, block.end(), 0);
+                derived().updateBlocks(block.data(), 1);
+                offset = 0;
+            }
+
+            std::fill(block.begin() + offset, block.end() - 8, 0);
+            storeBigEndian(block.data() + BLOCKSIZE - 8, totalLength << 3);
+            derived().updateBlocks(block.data(), 1);
+
+            for (size_t i = 0; i < OUTPUTSIZE / sizeof(WORD_T); ++i) {
+                storeBigEndian(out + i * sizeof(WORD_T), state[i]);
+            }
+
+            init();
+            return OUTPUTSIZE;
+        }
+
+        std::shared_ptr<Hash> clone() const override
+        {
+            return std::make_shared<DERIVED>(static_cast<const DERIVED&>(*this));
+        }
+
+        void restore(const Hash& snapshot) override
+        {
+            auto other = dynamic_cast<const Sha2*>(&snapshot);
+            if (other == nullptr) {
+                throw "Illegal state";
+            }
+
+            offset = other->offset;
+            totalLength = other->totalLength;
+            state = other->state;
+            std::copy(other->block.begin(), other->block.begin() + offset, block.begin());
+        }
+
+        std::vector<uint8_t> serialize() const override
+        {
+            auto out = serializeHeader(totalLength);
+            for (auto word : state) {
+                appendBigEndian(out, word, sizeof(WORD_T));
+            }
+            out.insert(out.end(), block.begin(), block.begin() + offset);
+
+            return out;
+        }
+
+        void deserialize(const uint8_t* data, size_t length) override
+        {
+            auto processed = deserializeHeader(data, length);
+            auto buffered = processed % BLOCKSIZE;
+
+            if (length != sizeof(state) + buffered) {
+                throw "Illegal state";
+            }
+
+            for (auto& word : state) {
+                word = readBigEndian(data, sizeof(WORD_T));
+            }
+            std::copy(data, data + buffered, block.begin());
+
+            offset = buffered;
+            totalLength = processed;
+        }
+
+        using Hash::deserialize;
+
+        // portable compression of count consecutive blocks, hidden by DERIVED when it has a faster backend
+        void updateBlocks(const uint8_t* data, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i) {
+                updateBlock(data);
+                data += BLOCKSIZE;
+            }
+        }
+
+    protected:
+        static constexpr WORD_T ch(WORD_T x, WORD_T y, WORD_T z)
+        {
+            return ((y ^ z) & x) ^ z;
+        }
+
+        static constexpr WORD_T maj(WORD_T x, WORD_T y, WORD_T z)
+        {
+            return (x & y) | ((x | y) & z);
+        }
+
+        template <typename T>
+        static inline T byteswap(T value)
+        {
+            if constexpr (sizeof(T) == 4) {
+                return __builtin_bswap32(value);
+            } else {
+                return __builtin_bswap64(value);
+            }
+        }
+
+        template <typename T>
+        static inline void storeBigEndian(uint8_t* out, T value)
+        {
+            value = byteswap(value);
+            std::memcpy(out, &value, sizeof(value));
+        }
+
+        static inline WORD_T loadBigEndian(const uint8_t* in)
+        {
+            WORD_T value;
+            std::memcpy(&value, in, sizeof(value));
+            return byteswap(value);
+        }
+
+        // the message schedule is kept in a rolling window of 16 words
         void updateBlock(const uint8_t* data)
         {
+            WORD_T w[16];
+            for (auto i = 0; i < 16; ++i) {
+                w[i] = loadBigEndian(data + i * sizeof(WORD_T));
+            }
+
             auto a = state[0];
             auto b = state[1];
             auto c = state[2];
@@ -94,13 +240,13 @@ namespace mockup { namespace crypto { namespace hash {
             auto g = state[6];
             auto h = state[7];
 
-            WORD_T t1 = 0;
-            WORD_T t2 = 0;
+            for (size_t t = 0; t < NUM_STEPS; ++t) {
+                if (t >= 16) {
+                    w[t & 15] += DERIVED::sigma1(w[(t - 2) & 15]) + w[(t - 7) & 15] + DERIVED::sigma0(w[(t - 15) & 15]);
+                }
 
-            expandMessage(data);
-            for (auto i = 0; i < NUM_STEPS; ++i) {
-                t1 = h + sum1(e) + ch(e, f, g) + K[i] + W[i];
-                t2 = sum0(a) + maj(a, b, c);
+                auto t1 = h + DERIVED::sum1(e) + ch(e, f, g) + DERIVED::ROUND_CONSTANTS[t] + w[t & 15];
+                auto t2 = DERIVED::sum0(a) + maj(a, b, c);
                 h = g;
                 g = f;
                 f = e;
@@ -121,93 +267,119 @@ namespace mockup { namespace crypto { namespace hash {
             state[7] += h;
         }
 
-        std::vector<uint8_t> doFinal() override
-        {
-            block[offset++] = 0x80;
-            std::fill(block.begin() + offset, block.end(), 0);
-
-            processLength();
-            updateBlock(block.data());
-            auto output = toOutput();
-            
-            init();
-            return output;
-        }
-
-    protected:
-        virtual void expandMessage(const uint8_t* data) = 0;
-        virtual std::vector<uint8_t> toOutput() const = 0;
-        virtual void processLength() = 0;
-
-        virtual WORD_T ch(WORD_T x, WORD_T y, WORD_T z) const 
+    private:
+        DERIVED& derived()
         {
-            return (x & y) ^ (~x & z);
+            return static_cast<DERIVED&>(*this);
         }
-        virtual WORD_T maj(WORD_T x, WORD_T y, WORD_T z) const 
-        {
-            return (x & y) ^ (x & z) ^ (y & z);
-        }
-
-        virtual WORD_T sum0(WORD_T x) const = 0;
-        virtual WORD_T sum1(WORD_T x) const = 0;
-        
-        virtual WORD_T sigma0(WORD_T x) const = 0;
-        virtual WORD_T sigma1(WORD_T x) const = 0;
     };
 
-    using Sha256_t = Sha2<uint32_t, 64>;
-    using Sha512_t = Sha2<uint64_t, 80>;
-
-    class Sha256 : public Sha256_t
+    class Sha256 : public Sha2<Sha256, uint32_t, 64, 32>
     {
-        using Arx = ArxPrimitive<uint32_t>;
+    private:
+        bool _shani;
 
     public:
-        Sha256();
+        alignas(16) static constexpr uint32_t ROUND_CONSTANTS[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        static constexpr uint32_t IV[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+        };
+
+    public:
+        Sha256(bool useShaNi = true);
         virtual ~Sha256() = default;
 
-        size_t blocksize() const override;
-        size_t outputsize() const override;
         const std::string name() const override;
 
-        void init() override;
+        void updateBlocks(const uint8_t* data, size_t count);
 
-    protected:
-        void expandMessage(const uint8_t* data) override;
-        std::vector<uint8_t> toOutput() const override;
-        void processLength() override;
-
-        uint32_t sum0(uint32_t x) const override;
-        uint32_t sum1(uint32_t x) const override;
-        
-        uint32_t sigma0(uint32_t x) const override;
-        uint32_t sigma1(uint32_t x) const override;
+        static constexpr uint32_t sum0(uint32_t x)
+        {
+            return std::rotr(x, 2) ^ std::rotr(x, 13) ^ std::rotr(x, 22);
+        }
+
+        static constexpr uint32_t sum1(uint32_t x)
+        {
+            return std::rotr(x, 6) ^ std::rotr(x, 11) ^ std::rotr(x, 25);
+        }
+
+        static constexpr uint32_t sigma0(uint32_t x)
+        {
+            return std::rotr(x, 7) ^ std::rotr(x, 18) ^ (x >> 3);
+        }
+
+        static constexpr uint32_t sigma1(uint32_t x)
+        {
+            return std::rotr(x, 17) ^ std::rotr(x, 19) ^ (x >> 10);
+        }
     };
 
-    class Sha512 : public Sha512_t
+    class Sha512 : public Sha2<Sha512, uint64_t, 80, 64>
     {
-        using Arx = ArxPrimitive<uint64_t>;
+    public:
+        static constexpr uint64_t ROUND_CONSTANTS[80] = {
+            0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+            0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+            0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+            0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+            0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+            0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+            0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+            0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+            0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+            0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+            0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
+            0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+            0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+            0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+            0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+            0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+            0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+            0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+            0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+            0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
+        };
+
+        static constexpr uint64_t IV[8] = {
+            0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1, 
+            0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179,
+        };
 
     public:
-        Sha512();
+        Sha512() = default;
         virtual ~Sha512() = default;
 
-        size_t blocksize() const override;
-        size_t outputsize() const override;
         const std::string name() const override;
 
-        void init() override;
+        static constexpr uint64_t sum0(uint64_t x)
+        {
+            return std::rotr(x, 28) ^ std::rotr(x, 34) ^ std::rotr(x, 39);
+        }
 
-    protected:
-        void expandMessage(const uint8_t* data) override;
-        std::vector<uint8_t> toOutput() const override;
-        void processLength() override;
+        static constexpr uint64_t sum1(uint64_t x)
+        {
+            return std::rotr(x, 14) ^ std::rotr(x, 18) ^ std::rotr(x, 41);
+        }
 
-        uint64_t sum0(uint64_t x) const override;
-        uint64_t sum1(uint64_t x) const override;
+        static constexpr uint64_t sigma0(uint64_t x)
+        {
+            return std::rotr(x, 1) ^ std::rotr(x, 8) ^ (x >> 7);
+        }
 
-        uint64_t sigma0(uint64_t x) const override;
-        uint64_t sigma1(uint64_t x) const override;
+        static constexpr uint64_t sigma1(uint64_t x)
+        {
+            return std::rotr(x, 19) ^ std::rotr(x, 61) ^ (x >> 6);
+        }
     };
 
 }}}
@@ -0,0 +1,57 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MOCKUP_CRYPTO_HASH_SHA256_MULTI_BUFFER_H__
+#define __MOCKUP_CRYPTO_HASH_SHA256_MULTI_BUFFER_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mockup { namespace crypto { namespace hash {
+
+    // SHA-256 over many independent messages, where every round carries one block of up to eight of them
+    class Sha256MultiBuffer {
+
+    public:
+        static constexpr size_t MAX_LANES = 8;
+        static constexpr size_t BLOCKSIZE = 64;
+        static constexpr size_t OUTPUTSIZE = 32;
+
+    private:
+        // eight lanes with AVX2, four with SSE2, or one message after another with SHA-NI, which outruns either
+        size_t _lanes;
+        bool _shani;
+
+    public:
+        Sha256MultiBuffer(bool useAvx2 = true, bool useShaNi = true);
+        ~Sha256MultiBuffer() = default;
+
+        size_t lanes() const;
+
+        // writes the 32-byte digest of inputs[i] to outputs[i]; a lane whose message ends is refilled with the next one
+        void hashMany(const uint8_t* const* inputs, const size_t* lengths, uint8_t* const* outputs, size_t count) const;
+    };
+}}}
+
+#endif
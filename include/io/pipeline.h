@@ -0,0 +1,71 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MOCKUP_CRYPTO_IO_PIPELINE_H__
+#define __MOCKUP_CRYPTO_IO_PIPELINE_H__
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace mockup { namespace crypto { namespace io {
+
+    // reads a file chunk by chunk, runs a compute stage over every chunk in order, and writes what the stage produces.
+    // Reads run ahead and writes run behind over a ring of buffers, so that chunk N+1 is read while chunk N is processed
+    class Pipeline {
+
+    public:
+        // transforms chunk index of length bytes in place, and returns the number of bytes to write, at most length + slack
+        using Stage = std::function<size_t(uint8_t* buffer, size_t length, uint64_t index, bool last)>;
+
+        enum class Backend {
+            URING,
+            THREADS
+        };
+
+        class IoQueue;
+
+    private:
+        size_t _chunkSize;
+        size_t _capacity;
+        size_t _depth;
+        uint8_t* _buffers;
+        std::unique_ptr<IoQueue> _queue;
+
+    public:
+        // io_uring with the buffers registered when available, otherwise pread and pwrite on a pool of threads
+        Pipeline(size_t chunkSize = 1 << 20, size_t slack = 64, size_t depth = 4, Backend backend = Backend::URING);
+        ~Pipeline();
+
+        Backend backend() const;
+
+        // from offset 0 of infd to its end, written from offset 0 of outfd, which may be negative when nothing is written
+        uint64_t run(int infd, int outfd, const Stage& stage);
+
+    private:
+        void drain(size_t inflight) noexcept;
+    };
+}}}
+
+#endif
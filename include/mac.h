@@ -43,9 +43,20 @@ namespace mockup { namespace crypto {
         Mac() = default;
         virtual ~Mac() = default;
 
+        virtual size_t outputsize() const = 0;
+
         virtual void init(const uint8_t* key, size_t keysize) = 0;        
         virtual void updateBlock(const uint8_t* data) = 0;
-        virtual std::vector<uint8_t> doFinal() = 0;
+
+        // writes outputsize() bytes of tag to out and returns that length, leaving the mac keyed for the next message
+        virtual size_t doFinal(uint8_t* out) = 0;
+
+        std::vector<uint8_t> doFinal()
+        {
+            std::vector<uint8_t> tag(outputsize());
+            doFinal(tag.data());
+            return tag;
+        }
 
         void init(const std::vector<uint8_t>& key) {
             init(key.data(), key.size());
@@ -38,15 +38,25 @@ namespace mockup { namespace crypto { namespace mac {
         std::vector<uint8_t> opad;
         std::vector<uint8_t> ipad;
 
+        // the hashed key while keying, the inner digest while finishing
+        std::vector<uint8_t> digest;
+
+        // midstates after the keyed pads, so the pads are hashed once per key
+        std::shared_ptr<Hash> inner;
+        std::shared_ptr<Hash> outer;
+
     public:
         Hmac(std::shared_ptr<Hash> hash);
         virtual ~Hmac() = default;
 
         const std::string name() const override;
+        size_t outputsize() const override;
 
         void init(const uint8_t* key, size_t keysize) override;
         void updateBlock(const uint8_t* data) override;
-        std::vector<uint8_t> doFinal() override;
+        size_t doFinal(uint8_t* out) override;
+
+        using Mac::doFinal;
     };
 }}}
 
@@ -44,8 +44,12 @@ namespace mockup { namespace crypto { namespace mode {
         void initMode(CipherMode mode, const uint8_t* iv, size_t ivLen) override;
         size_t doFinal(uint8_t* out) override;
 
+        // moves the keystream forward by count blocks, so that a range of a message can be processed on its own
+        void skipBlocks(uint64_t count);
+
     protected:
         void updateBlock(uint8_t* out, const uint8_t* in) override;
+        void updateBlocks(uint8_t* out, const uint8_t* in, size_t count) override;
         void increaseCounter();
 
     };
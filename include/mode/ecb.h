@@ -27,20 +27,34 @@
 
 #include "../buffered_block_cipher.h"
 
+#include <vector>
+
 namespace mockup { namespace crypto { namespace mode {
 
     class Ecb : public BufferedBlockCipher
     {
+    private:
+        std::vector<std::shared_ptr<BlockCipher>> _workers;
+
     public:
         const std::string name() const override;
         
+        void initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen) override;
         void initMode(CipherMode mode, const uint8_t* iv, size_t ivLen) override;
         size_t doFinal(uint8_t* out) override;
 
+        // more instances of the same cipher, keyed by initCipher, so that updateBulk can run one per thread. Must come before initCipher
+        void setWorkers(const std::vector<std::shared_ptr<BlockCipher>>& workers);
+
+        // whole blocks go straight to the cipher, split over the workers when large. Nothing may be buffered
+        size_t updateBulk(uint8_t* out, const uint8_t* in, size_t length);
+
     protected:
         void updateBlock(uint8_t* out, const uint8_t* in) override;
+        void updateBlocks(uint8_t* out, const uint8_t* in, size_t count) override;
         
     private:
+        static void processBlocks(BlockCipher* cipher, CipherMode mode, uint8_t* out, const uint8_t* in, size_t count);
         size_t DoFinalWithPadding(uint8_t* out);
         size_t DoFinalWithoutPadding(uint8_t* out);
 
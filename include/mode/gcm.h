@@ -0,0 +1,91 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MOCKUP_CRYPTO_MODE_GCM_H__
+#define __MOCKUP_CRYPTO_MODE_GCM_H__
+
+#include "../buffered_block_cipher_aead.h"
+
+#include <array>
+
+namespace mockup { namespace crypto { namespace mode {
+
+    class GCM : public BufferedBlockCipherAead {
+
+        static constexpr size_t GCM_BLOCKSIZE = 16;
+        static constexpr size_t GCM_PARALLEL_BLOCKS = 8;
+
+        // inc32 must not wrap into J0, so a message has at most 2^32 - 2 blocks
+        static constexpr uint64_t GCM_MAX_BLOCKS = 0xfffffffe;
+
+        using block_t = std::array<uint8_t, GCM_BLOCKSIZE>;
+
+    private:
+        bool _clmul;
+
+        // H^1 ... H^8 in the byte-reflected form used by the carry-less multiply
+        std::array<block_t, GCM_PARALLEL_BLOCKS> _powers;
+
+        // 4-bit multiplication tables of H for the portable GHASH
+        std::array<uint64_t, 16> _tableHigh;
+        std::array<uint64_t, 16> _tableLow;
+
+        block_t _j0;
+        block_t _counter;
+        block_t _ghash;
+        block_t _aadPartial;
+
+        size_t _aadPartialLen;
+        uint64_t _aadlen;
+        uint64_t _msglen;
+        uint64_t _blocks;
+
+    public:
+        GCM(bool useClmul = true);
+        virtual ~GCM() = default;
+
+        const std::string name() const override;
+
+        void initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen) override;
+        void initMode(CipherMode mode, const uint8_t* iv, size_t ivLen, size_t taglen) override;
+        void updateAAD(const uint8_t* aad, size_t aadlen) override;
+        size_t doFinal(uint8_t* out) override;
+
+    protected:
+        void updateBlock(uint8_t* out, const uint8_t* in) override;
+        void updateBlocks(uint8_t* out, const uint8_t* in, size_t count) override;
+        bool verifyFinal(uint8_t* out, size_t& outlen) override;
+
+    private:
+        void initTables(const block_t& h);
+        void ghash(const uint8_t* data, size_t count);
+        void ghashPortable(const uint8_t* data, size_t count);
+        void flushAAD();
+        void increaseCounter(uint8_t* out, size_t count);
+        size_t finalBlock(uint8_t* out, size_t residue);
+        void generateTag(uint8_t* out);
+    };
+}}}
+
+#endif
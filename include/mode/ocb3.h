@@ -43,9 +43,14 @@ namespace mockup { namespace crypto { namespace mode {
         block_t _auth;
         block_t _lstar;
         block_t _ldollar;
+        block_t _ktopNonce;
+        block_t _stretch;
+        block_t _aadPartial;
 
         size_t _index;
-        size_t _taglen;
+        size_t _indexAAD;
+        size_t _aadPartialLen;
+        bool _ktopValid;
 
         size_t _residue;
         size_t _shift;
@@ -54,26 +59,38 @@ namespace mockup { namespace crypto { namespace mode {
         std::vector<block_t> _L;
 
     public:
-        OCB3() = default;
+        OCB3() : _ktopValid(false) {};
         virtual ~OCB3() =default;
 
         const std::string name() const override;
         
+        void initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen) override;
         void initMode(CipherMode mode, const uint8_t* iv, size_t ivLen, size_t taglen) override;
         void updateAAD(const uint8_t* aad, size_t aadlen) override;        
         size_t doFinal(uint8_t* out) override;
 
+        // seals count independent messages under this key, interleaving one block of each message per cipher call.
+        // outs[i] receives ciphertext||tag of outlens[i] = msglens[i] + taglen bytes, and may be msgs[i] itself
+        void sealMany(uint8_t* const* outs, size_t* outlens, const uint8_t* const* nonces, size_t nonceLen, 
+            const uint8_t* const* aads, const size_t* aadlens, const uint8_t* const* msgs, const size_t* msglens, size_t count, size_t taglen);
+
     protected:
         void updateBlock(uint8_t* out, const uint8_t* in) override;
+        void updateBlocks(uint8_t* out, const uint8_t* in, size_t count) override;
+        bool verifyFinal(uint8_t* out, size_t& outlen) override;
 
     private:
         void initBlocksize(size_t blocksize);
+        void initStretch(const uint8_t* top);
+        size_t formatNonce(uint8_t* top, const uint8_t* iv, size_t ivLen, size_t taglen) const;
+        void stretchKtop(uint8_t* stretch, const uint8_t* ktop) const;
+        void stretchOffset(uint8_t* delta, const uint8_t* stretch, size_t bottom) const;
         void times2(block_t& dst, const block_t& src);
-        void updateAADBlock(const uint8_t* block);
-        void increaseDelta(block_t& delta);
+        void updateAADBlocks(const uint8_t* aad, size_t count);
+        void flushAAD();
+        void increaseDelta(uint8_t* delta, size_t& index);
+        size_t finalBlock(uint8_t* out, size_t residue);
         size_t generateTag(uint8_t* out);
-
-        void xor_block(block_t& out, const block_t& lhs, const block_t& rhs);
     };
 }}}
 
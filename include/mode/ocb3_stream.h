@@ -0,0 +1,138 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MOCKUP_CRYPTO_MODE_OCB3_STREAM_H__
+#define __MOCKUP_CRYPTO_MODE_OCB3_STREAM_H__
+
+#include "ocb3.h"
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace mockup { namespace crypto { namespace mode {
+
+    // STREAM construction over OCB3. The plaintext is cut into chunks, each sealed under nonce = prefix||index||last,
+    // so chunks open independently of each other while reordering, truncation and extension fail to open
+    class Ocb3Stream : public NamedAlgorithm {
+
+    public:
+        static constexpr size_t PREFIX_LENGTH = 7;
+        static constexpr size_t NONCE_LENGTH = 12;
+        static constexpr size_t TAG_LENGTH = 16;
+
+    private:
+        size_t _chunkSize;
+        std::vector<std::shared_ptr<BlockCipher>> _workers;
+        std::vector<std::shared_ptr<OCB3>> _ocbs;
+
+    public:
+        Ocb3Stream(size_t chunkSize = 64 * 1024);
+        ~Ocb3Stream() = default;
+
+        const std::string name() const override;
+
+        // more instances of the same cipher, keyed by initCipher, so that chunks are sealed and opened one thread per instance
+        void setWorkers(const std::vector<std::shared_ptr<BlockCipher>>& workers);
+        void initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen);
+
+        size_t chunkSize() const;
+        size_t sealedChunkSize() const;
+        size_t threads() const;
+
+        // a single chunk, for range reads
+        size_t sealChunk(uint8_t* out, const uint8_t* prefix, uint32_t index, bool last, const uint8_t* in, size_t inlen);
+        size_t openChunk(uint8_t* out, const uint8_t* prefix, uint32_t index, bool last, const uint8_t* in, size_t inlen);
+
+        // consecutive chunks from index first, where the last of them is the last chunk of the stream when final is set
+        size_t sealChunks(uint8_t* out, const uint8_t* prefix, uint64_t first, const uint8_t* in, size_t inlen, bool final);
+        size_t openChunks(uint8_t* out, const uint8_t* prefix, uint64_t first, const uint8_t* in, size_t inlen, bool final);
+
+    private:
+        void formatNonce(uint8_t* nonce, const uint8_t* prefix, uint32_t index, bool last) const;
+        void forEachChunk(size_t count, const std::function<void(OCB3&, size_t)>& process);
+    };
+
+    // seals everything written to it into os, with at most batchChunks chunks in memory
+    class Ocb3StreamWriter {
+
+    private:
+        Ocb3Stream& _stream;
+        std::ostream& _os;
+        uint8_t _prefix[Ocb3Stream::PREFIX_LENGTH];
+        std::vector<uint8_t> _plain;
+        std::vector<uint8_t> _sealed;
+        size_t _buffered;
+        uint64_t _index;
+        bool _finished;
+
+    public:
+        // batchChunks defaults to four chunks per thread
+        Ocb3StreamWriter(Ocb3Stream& stream, const uint8_t* prefix, std::ostream& os, size_t batchChunks = 0);
+
+        void write(const uint8_t* data, size_t length);
+
+        // seals the remaining data as the last chunk, which must be done before the stream is complete
+        void finish();
+
+    private:
+        void flush(bool final);
+    };
+
+    // opens a stream from is, with at most batchChunks chunks in memory.
+    // Reads throw "Invalid tag" when any chunk up to the read position is forged, reordered or missing
+    class Ocb3StreamReader {
+
+    private:
+        Ocb3Stream& _stream;
+        std::istream& _is;
+        uint8_t _prefix[Ocb3Stream::PREFIX_LENGTH];
+        std::vector<uint8_t> _sealed;
+        std::vector<uint8_t> _plain;
+        size_t _offset;
+        size_t _available;
+        uint64_t _index;
+        bool _finished;
+
+    public:
+        // batchChunks defaults to four chunks per thread
+        Ocb3StreamReader(Ocb3Stream& stream, const uint8_t* prefix, std::istream& is, size_t batchChunks = 0);
+
+        // fewer than length bytes are read only at the end of the stream
+        size_t read(uint8_t* out, size_t length);
+
+        // moves to a plaintext offset, reading only the chunks from there on
+        void seek(uint64_t offset);
+
+        // opens chunk index alone into out, which has room for a chunk, leaving the read position as it was
+        size_t readChunk(uint32_t index, uint8_t* out);
+
+    private:
+        void fill();
+        size_t readSealed(uint8_t* sealed, size_t length, bool& final);
+    };
+}}}
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef __MOCKUP_CRYPTO_MODE_XTS_H__
+#define __MOCKUP_CRYPTO_MODE_XTS_H__
+
+#include "../block_cipher.h"
+#include "../named_algorithm.h"
+
+namespace mockup { namespace crypto { namespace mode {
+
+    // IEEE 1619 XTS, where every sector (data unit) is tweaked by its 128-bit little-endian sector number
+    class XTS : public NamedAlgorithm
+    {
+    private:
+        std::shared_ptr<BlockCipher> _cipher;
+        std::shared_ptr<BlockCipher> _tweakCipher;
+
+    public:
+        XTS() : _cipher(nullptr), _tweakCipher(nullptr) {};
+        virtual ~XTS() = default;
+
+        const std::string name() const override;
+
+        // mk = key1 || key2, where key1 encrypts data and key2 encrypts tweaks on two separate cipher instances
+        void initCipher(std::shared_ptr<BlockCipher> cipher, std::shared_ptr<BlockCipher> tweakCipher, const uint8_t* mk, size_t keylen);
+
+        void encryptSector(uint8_t* out, const uint8_t* in, size_t length, uint64_t sector);
+        void decryptSector(uint8_t* out, const uint8_t* in, size_t length, uint64_t sector);
+
+        // count consecutive sectors of sectorSize bytes each, starting from firstSector
+        void encryptSectors(uint8_t* out, const uint8_t* in, size_t sectorSize, size_t count, uint64_t firstSector);
+        void decryptSectors(uint8_t* out, const uint8_t* in, size_t sectorSize, size_t count, uint64_t firstSector);
+
+    private:
+        void processSectors(uint8_t* out, const uint8_t* in, size_t sectorSize, size_t count, uint64_t firstSector, bool encrypt);
+        void processSector(uint8_t* out, const uint8_t* in, size_t length, const uint8_t* tweak, bool encrypt);
+        void processBlocks(uint8_t* out, const uint8_t* in, size_t count, uint64_t* tweak, bool encrypt);
+        void processBlock(uint8_t* out, const uint8_t* in, const uint64_t* tweak, bool encrypt);
+    };
+}}}
+
+#endif
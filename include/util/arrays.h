@@ -25,6 +25,12 @@
 #ifndef __MOCKUP_CRYPTO_UTIL_ARRAYS_H__
 #define __MOCKUP_CRYPTO_UTIL_ARRAYS_H__
 
+#include <cstddef>
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace mockup { namespace crypto { namespace util {
 
     template <typename T>
@@ -42,6 +48,37 @@ namespace mockup { namespace crypto { namespace util {
             out[i] ^= rhs[i];
         }
     }
+
+    // count should be a multiple of 16
+    inline void bitwise_xor128(uint8_t* out, const uint8_t* lhs, const uint8_t* rhs, size_t count)
+    {
+#ifdef __SSE2__
+        for (size_t i = 0; i < count; i += 16) {
+            auto l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+            auto r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(l, r));
+        }
+#else
+        bitwise_xor(out, lhs, rhs, count);
+#endif
+    }
+
+    // count should be a multiple of 16
+    inline void bitwise_xor128(uint8_t* out, const uint8_t* rhs, size_t count)
+    {
+        bitwise_xor128(out, out, rhs, count);
+    }
+
+    // runs in time independent of where lhs and rhs differ
+    inline bool constant_time_equals(const uint8_t* lhs, const uint8_t* rhs, size_t count)
+    {
+        uint8_t diff = 0;
+        for (size_t i = 0; i < count; ++i) {
+            diff |= lhs[i] ^ rhs[i];
+        }
+
+        return diff == 0;
+    }
 }}}
 
 #endif
\ No newline at end of file
@@ -161,13 +161,14 @@ void aes256_keygen(uint8_t* rk, const uint8_t* mk)
     rks[14] = aes_keyexp1(rks[12], _mm_aeskeygenassist_si128(rks[13], 0x40));
 }
 
-AesNI::AesNI() : _rks(nullptr)
+AesNI::AesNI() : _rks(nullptr), _drks(nullptr)
 {
 }
 
 AesNI::~AesNI() 
 {
     safe_delete_array(_rks);
+    safe_delete_array(_drks);
 }
 
 const std::string AesNI::name() const 
@@ -212,6 +213,24 @@ void AesNI::init(const uint8_t* mk, size_t keylen)
         // should be error
         break;
     }
+
+    initDecryptionKeys();
+}
+
+void AesNI::initDecryptionKeys()
+{
+    safe_delete_array(_drks);
+    _drks = new uint8_t[(rounds() + 1) * 16];
+
+    auto nr = rounds();
+    __m128i* rk = (__m128i*) _rks;
+    __m128i* drk = (__m128i*) _drks;
+
+    drk[0] = rk[nr];
+    for (auto round = 1; round < nr; ++round) {
+        drk[round] = _mm_aesimc_si128(rk[nr - round]);
+    }
+    drk[nr] = rk[0];
 }
 
 void AesNI::encryptBlock(uint8_t* out, const uint8_t* in) 
@@ -231,16 +250,65 @@ void AesNI::encryptBlock(uint8_t* out, const uint8_t* in)
     _mm_storeu_si128((__m128i *) out, blk);
 }
 
-void AesNI::decryptBlock(uint8_t* out, const uint8_t* in) 
+void AesNI::encryptBlocks(uint8_t* out, const uint8_t* in, size_t count)
 {
-    int round = rounds();
     __m128i* rk = (__m128i*) _rks;
+    auto nr = rounds();
+
+    while (count >= 8) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +   0)), rk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  16)), rk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  32)), rk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  48)), rk[0]);
+        __m128i b4 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  64)), rk[0]);
+        __m128i b5 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  80)), rk[0]);
+        __m128i b6 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  96)), rk[0]);
+        __m128i b7 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in + 112)), rk[0]);
+
+        for (auto round = 1; round < nr; ++round) {
+            b0 = _mm_aesenc_si128(b0, rk[round]);
+            b1 = _mm_aesenc_si128(b1, rk[round]);
+            b2 = _mm_aesenc_si128(b2, rk[round]);
+            b3 = _mm_aesenc_si128(b3, rk[round]);
+            b4 = _mm_aesenc_si128(b4, rk[round]);
+            b5 = _mm_aesenc_si128(b5, rk[round]);
+            b6 = _mm_aesenc_si128(b6, rk[round]);
+            b7 = _mm_aesenc_si128(b7, rk[round]);
+        }
+
+        _mm_storeu_si128((__m128i *) (out +   0), _mm_aesenclast_si128(b0, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  16), _mm_aesenclast_si128(b1, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  32), _mm_aesenclast_si128(b2, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  48), _mm_aesenclast_si128(b3, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  64), _mm_aesenclast_si128(b4, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  80), _mm_aesenclast_si128(b5, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  96), _mm_aesenclast_si128(b6, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out + 112), _mm_aesenclast_si128(b7, rk[nr]));
+
+        in += 128;
+        out += 128;
+        count -= 8;
+    }
+
+    while (count > 0) {
+        encryptBlock(out, in);
+
+        in += 16;
+        out += 16;
+        count -= 1;
+    }
+}
+
+void AesNI::decryptBlock(uint8_t* out, const uint8_t* in) 
+{
+    int round = 0;
+    __m128i* rk = (__m128i*) _drks;
     __m128i blk = _mm_loadu_si128((__m128i *) in);
 
     blk = _mm_xor_si128(blk, rk[round]);
     
-    for (round = rounds() - 1; round > 0; --round) {
-        blk = _mm_aesdec_si128(blk, _mm_aesimc_si128(rk[round]));
+    for (round = 1; round < rounds(); ++round) {
+        blk = _mm_aesdec_si128(blk, rk[round]);
     }
 
     blk = _mm_aesdeclast_si128(blk, rk[round]);
@@ -248,6 +316,60 @@ void AesNI::decryptBlock(uint8_t* out, const uint8_t* in)
     _mm_storeu_si128((__m128i *) out, blk);
 }
 
+void AesNI::decryptBlocks(uint8_t* out, const uint8_t* in, size_t count)
+{
+    __m128i* rk = (__m128i*) _drks;
+    auto nr = rounds();
+
+    while (count >= 8) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +   0)), rk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  16)), rk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  32)), rk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  48)), rk[0]);
+        __m128i b4 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  64)), rk[0]);
+        __m128i b5 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  80)), rk[0]);
+        __m128i b6 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in +  96)), rk[0]);
+        __m128i b7 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in + 112)), rk[0]);
+
+        for (auto round = 1; round < nr; ++round) {
+            b0 = _mm_aesdec_si128(b0, rk[round]);
+            b1 = _mm_aesdec_si128(b1, rk[round]);
+            b2 = _mm_aesdec_si128(b2, rk[round]);
+            b3 = _mm_aesdec_si128(b3, rk[round]);
+            b4 = _mm_aesdec_si128(b4, rk[round]);
+            b5 = _mm_aesdec_si128(b5, rk[round]);
+            b6 = _mm_aesdec_si128(b6, rk[round]);
+            b7 = _mm_aesdec_si128(b7, rk[round]);
+        }
+
+        _mm_storeu_si128((__m128i *) (out +   0), _mm_aesdeclast_si128(b0, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  16), _mm_aesdeclast_si128(b1, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  32), _mm_aesdeclast_si128(b2, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  48), _mm_aesdeclast_si128(b3, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  64), _mm_aesdeclast_si128(b4, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  80), _mm_aesdeclast_si128(b5, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out +  96), _mm_aesdeclast_si128(b6, rk[nr]));
+        _mm_storeu_si128((__m128i *) (out + 112), _mm_aesdeclast_si128(b7, rk[nr]));
+
+        in += 128;
+        out += 128;
+        count -= 8;
+    }
+
+    while (count > 0) {
+        decryptBlock(out, in);
+
+        in += 16;
+        out += 16;
+        count -= 1;
+    }
+}
+
+const uint8_t* AesNI::roundKeys() const
+{
+    return _rks;
+}
+
 size_t AesNI::rounds() const
 {
     auto rounds = AES128_ROUNDS;
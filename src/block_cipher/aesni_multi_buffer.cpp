@@ -0,0 +1,247 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "../../include/block_cipher/aesni_multi_buffer.h"
+
+#include <algorithm>
+#include <wmmintrin.h>
+
+using namespace mockup::crypto::block_cipher;
+
+static constexpr size_t AES_BLOCKSIZE = 16;
+
+struct lane_t {
+    size_t job;
+    const __m128i* rk;
+    size_t offset;
+    uint64_t high;
+    uint64_t low;
+};
+
+static inline uint64_t load_be64(const uint8_t* in)
+{
+    return __builtin_bswap64(*reinterpret_cast<const uint64_t*>(in));
+}
+
+static inline __m128i counter_block(const lane_t& lane)
+{
+    return _mm_set_epi64x(__builtin_bswap64(lane.low), __builtin_bswap64(lane.high));
+}
+
+// one AES round over eight lanes, each with its own key schedule
+#define AES_ROUND_8(op, round) \
+    b0 = op(b0, rk[0][round]); \
+    b1 = op(b1, rk[1][round]); \
+    b2 = op(b2, rk[2][round]); \
+    b3 = op(b3, rk[3][round]); \
+    b4 = op(b4, rk[4][round]); \
+    b5 = op(b5, rk[5][round]); \
+    b6 = op(b6, rk[6][round]); \
+    b7 = op(b7, rk[7][round]);
+
+static void encrypt_lanes(__m128i* blocks, const __m128i* const* rk, size_t nr)
+{
+    __m128i b0 = blocks[0];
+    __m128i b1 = blocks[1];
+    __m128i b2 = blocks[2];
+    __m128i b3 = blocks[3];
+    __m128i b4 = blocks[4];
+    __m128i b5 = blocks[5];
+    __m128i b6 = blocks[6];
+    __m128i b7 = blocks[7];
+
+    AES_ROUND_8(_mm_xor_si128, 0);
+    for (size_t round = 1; round < nr; ++round) {
+        AES_ROUND_8(_mm_aesenc_si128, round);
+    }
+    AES_ROUND_8(_mm_aesenclast_si128, nr);
+
+    blocks[0] = b0;
+    blocks[1] = b1;
+    blocks[2] = b2;
+    blocks[3] = b3;
+    blocks[4] = b4;
+    blocks[5] = b5;
+    blocks[6] = b6;
+    blocks[7] = b7;
+}
+
+AesNIMultiBuffer::AesNIMultiBuffer(Callback completed, size_t flushBytes, clock::duration maxLatency)
+    : _completed(completed), _flushBytes(flushBytes), _maxLatency(maxLatency), _queuedBytes(0), _flushing(false)
+{
+}
+
+void AesNIMultiBuffer::submit(const Job& job)
+{
+    // lanes only run the rounds of the three AES key sizes, so any other job would never complete.
+    // rounds() falls back to 10 for an unknown size, hence the key size is checked instead
+    if (job.cipher->roundKeys() == nullptr) {
+        throw "Illegal cipher";
+    }
+
+    auto keysize = job.cipher->keysize();
+    if (keysize != 16 && keysize != 24 && keysize != 32) {
+        throw "Illegal cipher";
+    }
+
+    if (_queue.empty()) {
+        _oldest = clock::now();
+    }
+
+    _queue.push_back(job);
+    _queuedBytes += job.length;
+
+    if (_queuedBytes >= _flushBytes && _flushing == false) {
+        flush();
+    }
+}
+
+void AesNIMultiBuffer::poll()
+{
+    if (_queue.empty() == false && clock::now() - _oldest >= _maxLatency) {
+        flush();
+    }
+}
+
+size_t AesNIMultiBuffer::pending() const
+{
+    return _queue.size();
+}
+
+void AesNIMultiBuffer::flush()
+{
+    if (_flushing) {
+        return;
+    }
+
+    // callbacks may submit new jobs, which go to the emptied queue and wait for the next flush
+    std::vector<Job> jobs;
+    jobs.swap(_queue);
+    _queuedBytes = 0;
+    _flushing = true;
+
+    try {
+        // lanes share the number of rounds, so each key size is scheduled on its own
+        for (auto rounds : {10, 12, 14}) {
+            process(jobs, rounds);
+        }
+    } catch (...) {
+        _flushing = false;
+        throw;
+    }
+    _flushing = false;
+
+    // the allocation is kept for the next batch when no callback has queued one
+    if (_queue.empty()) {
+        jobs.clear();
+        _queue.swap(jobs);
+    }
+}
+
+void AesNIMultiBuffer::process(std::vector<Job>& jobs, size_t rounds)
+{
+    lane_t lanes[LANES];
+    size_t active = 0;
+    size_t next = 0;
+
+    alignas(16) __m128i blocks[LANES];
+    const __m128i* rk[LANES];
+
+    auto admit = [&](lane_t& lane) {
+        while (next < jobs.size()) {
+            auto& job = jobs[next++];
+            if (job.cipher->rounds() != rounds) {
+                continue;
+            }
+
+            // empty jobs complete without taking a lane
+            if (job.length == 0) {
+                _completed(job);
+                continue;
+            }
+
+            lane.job = next - 1;
+            lane.rk = reinterpret_cast<const __m128i*>(job.cipher->roundKeys());
+            lane.offset = 0;
+            lane.high = load_be64(job.counter);
+            lane.low = load_be64(job.counter + 8);
+            return true;
+        }
+        return false;
+    };
+
+    while (active < LANES && admit(lanes[active])) {
+        active += 1;
+    }
+
+    while (active > 0) {
+        for (size_t l = 0; l < LANES; ++l) {
+            // idle lanes repeat the first one, and their output is dropped
+            auto& lane = lanes[l < active ? l : 0];
+            blocks[l] = counter_block(lane);
+            rk[l] = lane.rk;
+        }
+
+        encrypt_lanes(blocks, rk, rounds);
+
+        for (size_t l = 0; l < active;) {
+            auto& lane = lanes[l];
+            auto& job = jobs[lane.job];
+            auto length = std::min(job.length - lane.offset, AES_BLOCKSIZE);
+            auto keystream = reinterpret_cast<const uint8_t*>(blocks + l);
+
+            if (length == AES_BLOCKSIZE) {
+                auto in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(job.in + lane.offset));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(job.out + lane.offset), _mm_xor_si128(in, blocks[l]));
+            } else {
+                for (size_t i = 0; i < length; ++i) {
+                    job.out[lane.offset + i] = job.in[lane.offset + i] ^ keystream[i];
+                }
+            }
+
+            lane.offset += length;
+            lane.low += 1;
+            lane.high += (lane.low == 0) ? 1 : 0;
+
+            if (lane.offset < job.length) {
+                l += 1;
+                continue;
+            }
+
+            _completed(job);
+
+            // a finished lane takes the next job, or the last lane moves into it
+            if (admit(lane) == false) {
+                active -= 1;
+                lane = lanes[active];
+                blocks[l] = blocks[active];
+                if (l == active) {
+                    break;
+                }
+                continue;
+            }
+            l += 1;
+        }
+    }
+}
@@ -22,53 +22,188 @@
  * THE SOFTWARE.
  */
 
+#include <immintrin.h>
+
 #include "../../include/hash/lsh.h"
 
 using namespace mockup::crypto::hash;
 
+static constexpr size_t LSH256_BLOCKSIZE = 128;
+static constexpr size_t LSH256_STEPS = 26;
+
+// byte shuffles rotating the right half left by gamma = {0, 8, 16, 24, 24, 16, 8, 0}
+alignas(32) static const uint8_t GAMMA_SHUFFLE[32] = {
+    0, 1, 2, 3, 7, 4, 5, 6, 10, 11, 8, 9, 13, 14, 15, 12,
+    1, 2, 3, 0, 6, 7, 4, 5, 11, 8, 9, 10, 12, 13, 14, 15,
+};
+
+// the word permutation takes {6, 4, 5, 7} and {2, 0, 1, 3} of the left half, {12, 15, 14, 13} and {8, 11, 10, 9} of the right
+static constexpr int PERMUTE_LEFT = 0xd2;
+static constexpr int PERMUTE_RIGHT = 0x6c;
+
+// the message expansion permutes every eight words by {3, 2, 0, 1, 7, 4, 5, 6}
+static constexpr int PERMUTE_MESSAGE_LOW = 0x4b;
+static constexpr int PERMUTE_MESSAGE_HIGH = 0x93;
+
+template <int ROT>
+__attribute__((target("avx2")))
+static inline __m256i rotl_avx2(__m256i x)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(x, ROT), _mm256_srli_epi32(x, 32 - ROT));
+}
+
+template <int ALPHA, int BETA>
+__attribute__((target("avx2")))
+static inline void step_avx2(__m256i& l, __m256i& r, __m256i ml, __m256i mr, const uint32_t* sc, __m256i gamma)
+{
+    l = _mm256_xor_si256(l, ml);
+    r = _mm256_xor_si256(r, mr);
+
+    l = _mm256_xor_si256(rotl_avx2<ALPHA>(_mm256_add_epi32(l, r)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sc)));
+    r = rotl_avx2<BETA>(_mm256_add_epi32(l, r));
+    l = _mm256_add_epi32(l, r);
+    r = _mm256_shuffle_epi8(r, gamma);
+
+    auto pl = _mm256_shuffle_epi32(l, PERMUTE_LEFT);
+    auto pr = _mm256_shuffle_epi32(r, PERMUTE_RIGHT);
+    l = _mm256_permute2x128_si256(pl, pr, 0x31);
+    r = _mm256_permute2x128_si256(pl, pr, 0x20);
+}
+
+// m, n hold the sub-messages of the current and the next step, and move on by one step
+__attribute__((target("avx2")))
+static inline void expand_avx2(__m256i& ml, __m256i& mr, __m256i& nl, __m256i& nr)
+{
+    const auto tau = _mm256_setr_epi32(3, 2, 0, 1, 7, 4, 5, 6);
+    auto tl = _mm256_add_epi32(nl, _mm256_permutevar8x32_epi32(ml, tau));
+    auto tr = _mm256_add_epi32(nr, _mm256_permutevar8x32_epi32(mr, tau));
+    ml = nl;
+    mr = nr;
+    nl = tl;
+    nr = tr;
+}
+
+__attribute__((target("avx2")))
+static void compress_avx2(uint32_t* state, const uint32_t* sc, const uint8_t* data, size_t count)
+{
+    auto gamma = _mm256_load_si256(reinterpret_cast<const __m256i*>(GAMMA_SHUFFLE));
+    auto l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state));
+    auto r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 8));
+
+    for (size_t i = 0; i < count; ++i) {
+        auto in = reinterpret_cast<const __m256i*>(data + i * LSH256_BLOCKSIZE);
+        auto ml = _mm256_loadu_si256(in);
+        auto mr = _mm256_loadu_si256(in + 1);
+        auto nl = _mm256_loadu_si256(in + 2);
+        auto nr = _mm256_loadu_si256(in + 3);
+
+        for (size_t j = 0; j < LSH256_STEPS; j += 2) {
+            step_avx2<29, 1>(l, r, ml, mr, sc + 8 * j, gamma);
+            expand_avx2(ml, mr, nl, nr);
+            step_avx2<5, 17>(l, r, ml, mr, sc + 8 * j + 8, gamma);
+            expand_avx2(ml, mr, nl, nr);
+        }
+
+        l = _mm256_xor_si256(l, ml);
+        r = _mm256_xor_si256(r, mr);
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state), l);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 8), r);
+}
+
+template <int ROT>
+__attribute__((target("ssse3")))
+static inline __m128i rotl_ssse3(__m128i x)
+{
+    return _mm_or_si128(_mm_slli_epi32(x, ROT), _mm_srli_epi32(x, 32 - ROT));
+}
+
+// the same step on four registers, l0 and l1 for the left half, r0 and r1 for the right
+template <int ALPHA, int BETA>
+__attribute__((target("ssse3")))
+static inline void step_ssse3(__m128i* x, const __m128i* m, const uint32_t* sc, const __m128i* gamma)
+{
+    auto l0 = _mm_xor_si128(x[0], m[0]);
+    auto l1 = _mm_xor_si128(x[1], m[1]);
+    auto r0 = _mm_xor_si128(x[2], m[2]);
+    auto r1 = _mm_xor_si128(x[3], m[3]);
+
+    l0 = _mm_xor_si128(rotl_ssse3<ALPHA>(_mm_add_epi32(l0, r0)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(sc)));
+    l1 = _mm_xor_si128(rotl_ssse3<ALPHA>(_mm_add_epi32(l1, r1)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(sc + 4)));
+    r0 = rotl_ssse3<BETA>(_mm_add_epi32(l0, r0));
+    r1 = rotl_ssse3<BETA>(_mm_add_epi32(l1, r1));
+    l0 = _mm_add_epi32(l0, r0);
+    l1 = _mm_add_epi32(l1, r1);
+    r0 = _mm_shuffle_epi8(r0, gamma[0]);
+    r1 = _mm_shuffle_epi8(r1, gamma[1]);
+
+    x[0] = _mm_shuffle_epi32(l1, PERMUTE_LEFT);
+    x[1] = _mm_shuffle_epi32(r1, PERMUTE_RIGHT);
+    x[2] = _mm_shuffle_epi32(l0, PERMUTE_LEFT);
+    x[3] = _mm_shuffle_epi32(r0, PERMUTE_RIGHT);
+}
+
+__attribute__((target("ssse3")))
+static inline void expand_ssse3(__m128i* m, __m128i* n)
+{
+    for (auto k = 0; k < 4; k += 2) {
+        auto t0 = _mm_add_epi32(n[k], _mm_shuffle_epi32(m[k], PERMUTE_MESSAGE_LOW));
+        auto t1 = _mm_add_epi32(n[k + 1], _mm_shuffle_epi32(m[k + 1], PERMUTE_MESSAGE_HIGH));
+        m[k] = n[k];
+        m[k + 1] = n[k + 1];
+        n[k] = t0;
+        n[k + 1] = t1;
+    }
+}
+
+__attribute__((target("ssse3")))
+static void compress_ssse3(uint32_t* state, const uint32_t* sc, const uint8_t* data, size_t count)
+{
+    __m128i gamma[2];
+    __m128i x[4];
+    for (auto k = 0; k < 4; ++k) {
+        x[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state) + k);
+    }
+    gamma[0] = _mm_load_si128(reinterpret_cast<const __m128i*>(GAMMA_SHUFFLE));
+    gamma[1] = _mm_load_si128(reinterpret_cast<const __m128i*>(GAMMA_SHUFFLE) + 1);
+
+    for (size_t i = 0; i < count; ++i) {
+        auto in = reinterpret_cast<const __m128i*>(data + i * LSH256_BLOCKSIZE);
+
+        __m128i m[4];
+        __m128i n[4];
+        for (auto k = 0; k < 4; ++k) {
+            m[k] = _mm_loadu_si128(in + k);
+            n[k] = _mm_loadu_si128(in + 4 + k);
+        }
+
+        for (size_t j = 0; j < LSH256_STEPS; j += 2) {
+            step_ssse3<29, 1>(x, m, sc + 8 * j, gamma);
+            expand_ssse3(m, n);
+            step_ssse3<5, 17>(x, m, sc + 8 * j + 8, gamma);
+            expand_ssse3(m, n);
+        }
+
+        for (auto k = 0; k < 4; ++k) {
+            x[k] = _mm_xor_si128(x[k], m[k]);
+        }
+    }
+
+    for (auto k = 0; k < 4; ++k) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state) + k, x[k]);
+    }
+}
+
 Lsh256::Lsh256() : Lsh256(BIT_256)
 {}
 
-Lsh256::Lsh256(size_t outlen)
+Lsh256::Lsh256(size_t outlen, LshSimd simd)
 {
     this->_output_length = outlen;
+    this->_simd = supported(simd);
 
-    this->_alpha1 = 29;
-    this->_beta1 = 1;
-
-    this->_alpha2 = 5;    
-    this->_beta2 = 17;
-
-    this->_gamma = {0, 8, 16, 24, 24, 16, 8, 0};
-
-    this->_step_constant = {
-        0x917caf90, 0x6c1b10a2, 0x6f352943, 0xcf778243, 0x2ceb7472, 0x29e96ff2, 0x8a9ba428, 0x2eeb2642, 
-        0x0e2c4021, 0x872bb30e, 0xa45e6cb2, 0x46f9c612, 0x185fe69e, 0x1359621b, 0x263fccb2, 0x1a116870, 
-        0x3a6c612f, 0xb2dec195, 0x02cb1f56, 0x40bfd858, 0x784684b6, 0x6cbb7d2e, 0x660c7ed8, 0x2b79d88a, 
-        0xa6cd9069, 0x91a05747, 0xcdea7558, 0x00983098, 0xbecb3b2e, 0x2838ab9a, 0x728b573e, 0xa55262b5, 
-        0x745dfa0f, 0x31f79ed8, 0xb85fce25, 0x98c8c898, 0x8a0669ec, 0x60e445c2, 0xfde295b0, 0xf7b5185a, 
-        0xd2580983, 0x29967709, 0x182df3dd, 0x61916130, 0x90705676, 0x452a0822, 0xe07846ad, 0xaccd7351, 
-        0x2a618d55, 0xc00d8032, 0x4621d0f5, 0xf2f29191, 0x00c6cd06, 0x6f322a67, 0x58bef48d, 0x7a40c4fd, 
-        0x8beee27f, 0xcd8db2f2, 0x67f2c63b, 0xe5842383, 0xc793d306, 0xa15c91d6, 0x17b381e5, 0xbb05c277, 
-        0x7ad1620a, 0x5b40a5bf, 0x5ab901a2, 0x69a7a768, 0x5b66d9cd, 0xfdee6877, 0xcb3566fc, 0xc0c83a32, 
-        0x4c336c84, 0x9be6651a, 0x13baa3fc, 0x114f0fd1, 0xc240a728, 0xec56e074, 0x009c63c7, 0x89026cf2, 
-        0x7f9ff0d0, 0x824b7fb5, 0xce5ea00f, 0x605ee0e2, 0x02e7cfea, 0x43375560, 0x9d002ac7, 0x8b6f5f7b, 
-        0x1f90c14f, 0xcdcb3537, 0x2cfeafdd, 0xbf3fc342, 0xeab7b9ec, 0x7a8cb5a3, 0x9d2af264, 0xfacedb06, 
-        0xb052106e, 0x99006d04, 0x2bae8d09, 0xff030601, 0xa271a6d6, 0x0742591d, 0xc81d5701, 0xc9a9e200, 
-        0x02627f1e, 0x996d719d, 0xda3b9634, 0x02090800, 0x14187d78, 0x499b7624, 0xe57458c9, 0x738be2c9, 
-        0x64e19d20, 0x06df0f36, 0x15d1cb0e, 0x0b110802, 0x2c95f58c, 0xe5119a6d, 0x59cd22ae, 0xff6eac3c, 
-        0x467ebd84, 0xe5ee453c, 0xe79cd923, 0x1c190a0d, 0xc28b81b8, 0xf6ac0852, 0x26efd107, 0x6e1ae93b, 
-        0xc53c41ca, 0xd4338221, 0x8475fd0a, 0x35231729, 0x4e0d3a7a, 0xa2b45b48, 0x16c0d82d, 0x890424a9, 
-        0x017e0c8f, 0x07b5a3f5, 0xfa73078e, 0x583a405e, 0x5b47b4c8, 0x570fa3ea, 0xd7990543, 0x8d28ce32, 
-        0x7f8a9b90, 0xbd5998fc, 0x6d7a9688, 0x927a9eb6, 0xa2fc7d23, 0x66b38e41, 0x709e491a, 0xb5f700bf, 
-        0x0a262c0f, 0x16f295b9, 0xe8111ef5, 0x0d195548, 0x9f79a0c5, 0x1a41cfa7, 0x0ee7638a, 0xacf7c074, 
-        0x30523b19, 0x09884ecf, 0xf93014dd, 0x266e9d55, 0x191a6664, 0x5c1176c1, 0xf64aed98, 0xa4b83520, 
-        0x828d5449, 0x91d71dd8, 0x2944f2d6, 0x950bf27b, 0x3380ca7d, 0x6d88381d, 0x4138868e, 0x5ced55c4, 
-        0x0fe19dcb, 0x68f4f669, 0x6e37c8ff, 0xa0fe6e10, 0xb44b47b0, 0xf5c0558a, 0x79bf14cf, 0x4a431a20, 
-        0xf17f68da, 0x5deb5fd1, 0xa600c86d, 0x9f6c7eb0, 0xff92f864, 0xb615e07f, 0x38d3e448, 0x8d5d3a6a, 
-        0x70e843cb, 0x494b312e, 0xa6c93613, 0x0beb2f4f, 0x928b5d63, 0xcbf66035, 0x0cb82c80, 0xea97a4f7, 
-        0x592c0f3b, 0x947c5f77, 0x6fff49b9, 0xf71a7e5a, 0x1de8c0f5, 0xc2569600, 0xc4e4ac8c, 0x823c9ce1
-    };
+    init();
 }
 
 Lsh256::~Lsh256()
@@ -76,6 +211,24 @@ Lsh256::~Lsh256()
     init();
 }
 
+void Lsh256::compressBlocks(const uint8_t* data, size_t count)
+{
+    switch (this->_simd)
+    {
+    case LshSimd::AVX2:
+        compress_avx2(this->_state.data(), STEP_CONSTANTS, data, count);
+        break;
+
+    case LshSimd::SSSE3:
+        compress_ssse3(this->_state.data(), STEP_CONSTANTS, data, count);
+        break;
+
+    default:
+        Lsh256_t::compressBlocks(data, count);
+        break;
+    }
+}
+
 void Lsh256::init()
 {
     Lsh256_t::init();
@@ -83,27 +236,11 @@ void Lsh256::init()
     switch(this->_output_length) 
     {
     case BIT_224:
-        init224();
+        std::copy(IV_224, IV_224 + 16, this->_state.begin());
         break;
 
     case BIT_256:
-        init256();
+        std::copy(IV_256, IV_256 + 16, this->_state.begin());
         break;
     }
 }
-
-void Lsh256::init224() 
-{
-    this->_state = {
-        0x068608D3, 0x62D8F7A7, 0xD76652AB, 0x4C600A43, 0xBDC40AA8, 0x1ECA0B68, 0xDA1A89BE, 0x3147D354,
-        0x707EB4F9, 0xF65B3862, 0x6B0B2ABE, 0x56B8EC0A, 0xCF237286, 0xEE0D1727, 0x33636595, 0x8BB8D05F,
-    };
-}
-
-void Lsh256::init256() 
-{
-    this->_state = {
-        0x46a10f1f, 0xfddce486, 0xb41443a8, 0x198e6b9d, 0x3304388d, 0xb0f5a3c7, 0xb36061c4, 0x7adbd553,
-        0x105d5378, 0x2f74de54, 0x5c2f2d95, 0xf2553fbe, 0x8051357a, 0x138668c8, 0x47aa4484, 0xe01afb41,
-    };
-}
\ No newline at end of file
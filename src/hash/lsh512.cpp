@@ -22,83 +22,221 @@
  * THE SOFTWARE.
  */
 
+#include <immintrin.h>
+
 #include "../../include/hash/lsh.h"
 
 using namespace mockup::crypto::hash;
 
+static constexpr size_t LSH512_BLOCKSIZE = 256;
+static constexpr size_t LSH512_STEPS = 28;
+
+// byte shuffles rotating the right half left by gamma = {0, 16, 32, 48, 8, 24, 40, 56}
+alignas(32) static const uint8_t GAMMA_SHUFFLE[64] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 14, 15, 8, 9, 10, 11, 12, 13,
+    4, 5, 6, 7, 0, 1, 2, 3, 10, 11, 12, 13, 14, 15, 8, 9,
+    7, 0, 1, 2, 3, 4, 5, 6, 13, 14, 15, 8, 9, 10, 11, 12,
+    3, 4, 5, 6, 7, 0, 1, 2, 9, 10, 11, 12, 13, 14, 15, 8,
+};
+
+// the word permutation takes {6, 4, 5, 7} and {2, 0, 1, 3} of the left half, {12, 15, 14, 13} and {8, 11, 10, 9} of the right
+static constexpr int PERMUTE_LEFT = 0xd2;
+static constexpr int PERMUTE_RIGHT = 0x6c;
+
+// the message expansion permutes every eight words by {3, 2, 0, 1, 7, 4, 5, 6}
+static constexpr int PERMUTE_MESSAGE_LOW = 0x4b;
+static constexpr int PERMUTE_MESSAGE_HIGH = 0x93;
+
+template <int ROT>
+__attribute__((target("avx2")))
+static inline __m256i rotl_avx2(__m256i x)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(x, ROT), _mm256_srli_epi64(x, 64 - ROT));
+}
+
+// x holds the left half in x[0], x[1] and the right half in x[2], x[3]
+template <int ALPHA, int BETA>
+__attribute__((target("avx2")))
+static inline void step_avx2(__m256i* x, const __m256i* m, const uint64_t* sc, const __m256i* gamma)
+{
+    auto l0 = _mm256_xor_si256(x[0], m[0]);
+    auto l1 = _mm256_xor_si256(x[1], m[1]);
+    auto r0 = _mm256_xor_si256(x[2], m[2]);
+    auto r1 = _mm256_xor_si256(x[3], m[3]);
+
+    l0 = _mm256_xor_si256(rotl_avx2<ALPHA>(_mm256_add_epi64(l0, r0)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sc)));
+    l1 = _mm256_xor_si256(rotl_avx2<ALPHA>(_mm256_add_epi64(l1, r1)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sc + 4)));
+    r0 = rotl_avx2<BETA>(_mm256_add_epi64(l0, r0));
+    r1 = rotl_avx2<BETA>(_mm256_add_epi64(l1, r1));
+    l0 = _mm256_add_epi64(l0, r0);
+    l1 = _mm256_add_epi64(l1, r1);
+    r0 = _mm256_shuffle_epi8(r0, gamma[0]);
+    r1 = _mm256_shuffle_epi8(r1, gamma[1]);
+
+    x[0] = _mm256_permute4x64_epi64(l1, PERMUTE_LEFT);
+    x[1] = _mm256_permute4x64_epi64(r1, PERMUTE_RIGHT);
+    x[2] = _mm256_permute4x64_epi64(l0, PERMUTE_LEFT);
+    x[3] = _mm256_permute4x64_epi64(r0, PERMUTE_RIGHT);
+}
+
+// m, n hold the sub-messages of the current and the next step, and move on by one step
+__attribute__((target("avx2")))
+static inline void expand_avx2(__m256i* m, __m256i* n)
+{
+    for (auto k = 0; k < 4; k += 2) {
+        auto t0 = _mm256_add_epi64(n[k], _mm256_permute4x64_epi64(m[k], PERMUTE_MESSAGE_LOW));
+        auto t1 = _mm256_add_epi64(n[k + 1], _mm256_permute4x64_epi64(m[k + 1], PERMUTE_MESSAGE_HIGH));
+        m[k] = n[k];
+        m[k + 1] = n[k + 1];
+        n[k] = t0;
+        n[k + 1] = t1;
+    }
+}
+
+__attribute__((target("avx2")))
+static void compress_avx2(uint64_t* state, const uint64_t* sc, const uint8_t* data, size_t count)
+{
+    __m256i gamma[2];
+    __m256i x[4];
+    for (auto k = 0; k < 4; ++k) {
+        x[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state) + k);
+    }
+    gamma[0] = _mm256_load_si256(reinterpret_cast<const __m256i*>(GAMMA_SHUFFLE));
+    gamma[1] = _mm256_load_si256(reinterpret_cast<const __m256i*>(GAMMA_SHUFFLE) + 1);
+
+    for (size_t i = 0; i < count; ++i) {
+        auto in = reinterpret_cast<const __m256i*>(data + i * LSH512_BLOCKSIZE);
+
+        __m256i m[4];
+        __m256i n[4];
+        for (auto k = 0; k < 4; ++k) {
+            m[k] = _mm256_loadu_si256(in + k);
+            n[k] = _mm256_loadu_si256(in + 4 + k);
+        }
+
+        for (size_t j = 0; j < LSH512_STEPS; j += 2) {
+            step_avx2<23, 59>(x, m, sc + 8 * j, gamma);
+            expand_avx2(m, n);
+            step_avx2<7, 3>(x, m, sc + 8 * j + 8, gamma);
+            expand_avx2(m, n);
+        }
+
+        for (auto k = 0; k < 4; ++k) {
+            x[k] = _mm256_xor_si256(x[k], m[k]);
+        }
+    }
+
+    for (auto k = 0; k < 4; ++k) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state) + k, x[k]);
+    }
+}
+
+template <int ROT>
+__attribute__((target("ssse3")))
+static inline __m128i rotl_ssse3(__m128i x)
+{
+    return _mm_or_si128(_mm_slli_epi64(x, ROT), _mm_srli_epi64(x, 64 - ROT));
+}
+
+// picks the low word of a and the high word of b
+__attribute__((target("ssse3")))
+static inline __m128i blend_ssse3(__m128i a, __m128i b)
+{
+    return _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 2));
+}
+
+// two words per register, x[0..3] for the left half and x[4..7] for the right
+template <int ALPHA, int BETA>
+__attribute__((target("ssse3")))
+static inline void step_ssse3(__m128i* x, const __m128i* m, const uint64_t* sc, const __m128i* gamma)
+{
+    __m128i l[4];
+    __m128i r[4];
+    for (auto k = 0; k < 4; ++k) {
+        l[k] = _mm_xor_si128(x[k], m[k]);
+        r[k] = _mm_xor_si128(x[k + 4], m[k + 4]);
+
+        l[k] = _mm_xor_si128(rotl_ssse3<ALPHA>(_mm_add_epi64(l[k], r[k])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(sc + 2 * k)));
+        r[k] = rotl_ssse3<BETA>(_mm_add_epi64(l[k], r[k]));
+        l[k] = _mm_add_epi64(l[k], r[k]);
+        r[k] = _mm_shuffle_epi8(r[k], gamma[k]);
+    }
+
+    x[0] = _mm_unpacklo_epi64(l[3], l[2]);
+    x[1] = _mm_unpackhi_epi64(l[2], l[3]);
+    x[2] = blend_ssse3(r[2], r[3]);
+    x[3] = blend_ssse3(r[3], r[2]);
+    x[4] = _mm_unpacklo_epi64(l[1], l[0]);
+    x[5] = _mm_unpackhi_epi64(l[0], l[1]);
+    x[6] = blend_ssse3(r[0], r[1]);
+    x[7] = blend_ssse3(r[1], r[0]);
+}
+
+__attribute__((target("ssse3")))
+static inline void expand_ssse3(__m128i* m, __m128i* n)
+{
+    // two registers per four words, {3, 2, 0, 1} in the first four and {3, 0, 1, 2} in the next
+    for (auto k = 0; k < 8; k += 4) {
+        __m128i t[4];
+        t[0] = _mm_add_epi64(n[k], _mm_shuffle_epi32(m[k + 1], 0x4e));
+        t[1] = _mm_add_epi64(n[k + 1], m[k]);
+        t[2] = _mm_add_epi64(n[k + 2], _mm_alignr_epi8(m[k + 2], m[k + 3], 8));
+        t[3] = _mm_add_epi64(n[k + 3], _mm_alignr_epi8(m[k + 3], m[k + 2], 8));
+        for (auto q = 0; q < 4; ++q) {
+            m[k + q] = n[k + q];
+            n[k + q] = t[q];
+        }
+    }
+}
+
+__attribute__((target("ssse3")))
+static void compress_ssse3(uint64_t* state, const uint64_t* sc, const uint8_t* data, size_t count)
+{
+    __m128i gamma[4];
+    __m128i x[8];
+    for (auto k = 0; k < 8; ++k) {
+        x[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state) + k);
+    }
+    for (auto k = 0; k < 4; ++k) {
+        gamma[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(GAMMA_SHUFFLE) + k);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        auto in = reinterpret_cast<const __m128i*>(data + i * LSH512_BLOCKSIZE);
+
+        __m128i m[8];
+        __m128i n[8];
+        for (auto k = 0; k < 8; ++k) {
+            m[k] = _mm_loadu_si128(in + k);
+            n[k] = _mm_loadu_si128(in + 8 + k);
+        }
+
+        for (size_t j = 0; j < LSH512_STEPS; j += 2) {
+            step_ssse3<23, 59>(x, m, sc + 8 * j, gamma);
+            expand_ssse3(m, n);
+            step_ssse3<7, 3>(x, m, sc + 8 * j + 8, gamma);
+            expand_ssse3(m, n);
+        }
+
+        for (auto k = 0; k < 8; ++k) {
+            x[k] = _mm_xor_si128(x[k], m[k]);
+        }
+    }
+
+    for (auto k = 0; k < 8; ++k) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state) + k, x[k]);
+    }
+}
+
 Lsh512::Lsh512() : Lsh512(BIT_512)
 {}
 
-Lsh512::Lsh512(size_t outlen)
+Lsh512::Lsh512(size_t outlen, LshSimd simd)
 {
     this->_output_length = outlen;
+    this->_simd = supported(simd);
 
-    this->_alpha1 = 23;
-    this->_beta1 = 59;
-
-    this->_alpha2 = 7;    
-    this->_beta2 = 3;
-
-    this->_gamma = {0, 16, 32, 48, 8, 24, 40, 56};
-
-    this->_step_constant = {
-        0x97884283c938982aL, 0xba1fca93533e2355L, 0xc519a2e87aeb1c03L, 0x9a0fc95462af17b1L,
-        0xfc3dda8ab019a82bL, 0x02825d079a895407L, 0x79f2d0a7ee06a6f7L, 0xd76d15eed9fdf5feL,
-        0x1fcac64d01d0c2c1L, 0xd9ea5de69161790fL, 0xdebc8b6366071fc8L, 0xa9d91db711c6c94bL,
-        0x3a18653ac9c1d427L, 0x84df64a223dd5b09L, 0x6cc37895f4ad9e70L, 0x448304c8d7f3f4d5L,
-        0xea91134ed29383e0L, 0xc4484477f2da88e8L, 0x9b47eec96d26e8a6L, 0x82f6d4c8d89014f4L,
-        0x527da0048b95fb61L, 0x644406c60138648dL, 0x303c0e8aa24c0edcL, 0xc787cda0cbe8ca19L,
-        0x7ba46221661764caL, 0x0c8cbc6acd6371acL, 0xe336b836940f8f41L, 0x79cb9da168a50976L,
-        0xd01da49021915cb3L, 0xa84accc7399cf1f1L, 0x6c4a992cee5aeb0cL, 0x4f556e6cb4b2e3e0L,
-        0x200683877d7c2f45L, 0x9949273830d51db8L, 0x19eeeecaa39ed124L, 0x45693f0a0dae7fefL,
-        0xedc234b1b2ee1083L, 0xf3179400d68ee399L, 0xb6e3c61b4945f778L, 0xa4c3db216796c42fL,
-        0x268a0b04f9ab7465L, 0xe2705f6905f2d651L, 0x08ddb96e426ff53dL, 0xaea84917bc2e6f34L,
-        0xaff6e664a0fe9470L, 0x0aab94d765727d8cL, 0x9aa9e1648f3d702eL, 0x689efc88fe5af3d3L,
-        0xb0950ffea51fd98bL, 0x52cfc86ef8c92833L, 0xe69727b0b2653245L, 0x56f160d3ea9da3e2L,
-        0xa6dd4b059f93051fL, 0xb6406c3cd7f00996L, 0x448b45f3ccad9ec8L, 0x079b8587594ec73bL,
-        0x45a50ea3c4f9653bL, 0x22983767c1f15b85L, 0x7dbed8631797782bL, 0x485234be88418638L,
-        0x842850a5329824c5L, 0xf6aca914c7f9a04cL, 0xcfd139c07a4c670cL, 0xa3210ce0a8160242L,
-        0xeab3b268be5ea080L, 0xbacf9f29b34ce0a7L, 0x3c973b7aaf0fa3a8L, 0x9a86f346c9c7be80L,
-        0xac78f5d7cabcea49L, 0xa355bddcc199ed42L, 0xa10afa3ac6b373dbL, 0xc42ded88be1844e5L,
-        0x9e661b271cff216aL, 0x8a6ec8dd002d8861L, 0xd3d2b629beb34be4L, 0x217a3a1091863f1aL,
-        0x256ecda287a733f5L, 0xf9139a9e5b872fe5L, 0xac0535017a274f7cL, 0xf21b7646d65d2aa9L,
-        0x048142441c208c08L, 0xf937a5dd2db5e9ebL, 0xa688dfe871ff30b7L, 0x9bb44aa217c5593bL,
-        0x943c702a2edb291aL, 0x0cae38f9e2b715deL, 0xb13a367ba176cc28L, 0x0d91bd1d3387d49bL,
-        0x85c386603cac940cL, 0x30dd830ae39fd5e4L, 0x2f68c85a712fe85dL, 0x4ffeecb9dd1e94d6L,
-        0xd0ac9a590a0443aeL, 0xbae732dc99ccf3eaL, 0xeb70b21d1842f4d9L, 0x9f4eda50bb5c6fa8L,
-        0x4949e69ce940a091L, 0x0e608dee8375ba14L, 0x983122cba118458cL, 0x4eeba696fbb36b25L,
-        0x7d46f3630e47f27eL, 0xa21a0f7666c0dea4L, 0x5c22cf355b37cec4L, 0xee292b0c17cc1847L,
-        0x9330838629e131daL, 0x6eee7c71f92fce22L, 0xc953ee6cb95dd224L, 0x3a923d92af1e9073L,
-        0xc43a5671563a70fbL, 0xbc2985dd279f8346L, 0x7ef2049093069320L, 0x17543723e3e46035L,
-        0xc3b409b00b130c6dL, 0x5d6aee6b28fdf090L, 0x1d425b26172ff6edL, 0xcccfd041cdaf03adL,
-        0xfe90c7c790ab6cbfL, 0xe5af6304c722ca02L, 0x70f695239999b39eL, 0x6b8b5b07c844954cL,
-        0x77bdb9bb1e1f7a30L, 0xc859599426ee80edL, 0x5f9d813d4726e40aL, 0x9ca0120f7cb2b179L,
-        0x8f588f583c182cbdL, 0x951267cbe9eccce7L, 0x678bb8bd334d520eL, 0xf6e662d00cd9e1b7L,
-        0x357774d93d99aaa7L, 0x21b2edbb156f6eb5L, 0xfd1ebe846e0aee69L, 0x3cb2218c2f642b15L,
-        0xe7e7e7945444ea4cL, 0xa77a33b5d6b9b47cL, 0xf34475f0809f6075L, 0xdd4932dce6bb99adL,
-        0xacec4e16d74451dcL, 0xd4a0a8d084de23d6L, 0x1bdd42f278f95866L, 0xeed3adbb938f4051L,
-        0xcfcf7be8992f3733L, 0x21ade98c906e3123L, 0x37ba66711fffd668L, 0x267c0fc3a255478aL,
-        0x993a64ee1b962e88L, 0x754979556301faaaL, 0xf920356b7251be81L, 0xc281694f22cf923fL,
-        0x9f4b6481c8666b02L, 0xcf97761cfe9f5444L, 0xf220d7911fd63e9fL, 0xa28bd365f79cd1b0L,
-        0xd39f5309b1c4b721L, 0xbec2ceb864fca51fL, 0x1955a0ddc410407aL, 0x43eab871f261d201L,
-        0xeaafe64a2ed16da1L, 0x670d931b9df39913L, 0x12f868b0f614de91L, 0x2e5f395d946e8252L,
-        0x72f25cbb767bd8f4L, 0x8191871d61a1c4ddL, 0x6ef67ea1d450ba93L, 0x2ea32a645433d344L,
-        0x9a963079003f0f8bL, 0x74a0aeb9918cac7aL, 0x0b6119a70af36fa3L, 0x8d9896f202f0d480L,
-        0x654f1831f254cd66L, 0x1318a47f0366a25eL, 0x65752076250b4e01L, 0xd1cd8eb888071772L,
-        0x30c6a9793f4e9b25L, 0x154f684b1e3926eeL, 0x6c7ac0b1fe6312aeL, 0x262f88f4f3c5550dL,
-        0xb4674a24472233cbL, 0x2bbd23826a090071L, 0xda95969b30594f66L, 0x9f5c47408f1e8a43L,
-        0xf77022b88de9c055L, 0x64b7b36957601503L, 0xe73b72b06175c11aL, 0x55b87de8b91a6233L,
-        0x1bb16e6b6955ff7fL, 0xe8e0a5ec7309719cL, 0x702c31cb89a8b640L, 0xfba387cfada8cde2L,
-        0x6792db4677aa164cL, 0x1c6b1cc0b7751867L, 0x22ae2311d736dc01L, 0x0e3666a1d37c9588L,
-        0xcd1fd9d4bf557e9aL, 0xc986925f7c7b0e84L, 0x9c5dfd55325ef6b0L, 0x9f2b577d5676b0ddL,
-        0xfa6e21be21c062b3L, 0x8787dd782c8d7f83L, 0xd0d134e90e12dd23L, 0x449d087550121d96L,
-        0xecf9ae9414d41967L, 0x5018f1dbf789934dL, 0xfa5b52879155a74cL, 0xca82d4d3cd278e7cL,
-        0x688fdfdfe22316adL, 0x0f6555a4ba0d030aL, 0xa2061df720f000f3L, 0xe1a57dc5622fb3daL,
-        0xe6a842a8e8ed8153L, 0x690acdd3811ce09dL, 0x55adda18e6fcf446L, 0x4d57a8a0f4b60b46L,
-        0xf86fbfc20539c415L, 0x74bafa5ec7100d19L, 0xa824151810f0f495L, 0x8723432791e38ebbL,
-        0x8eeaeb91d66ed539L, 0x73d8a1549dfd7e06L, 0x0387f2ffe3f13a9bL, 0xa5004995aac15193L,
-        0x682f81c73efdda0dL, 0x2fb55925d71d268dL, 0xcc392d2901e58a3dL, 0xaa666ab975724a42L,
-    };
+    init();
 }
 
 Lsh512::~Lsh512()
@@ -106,6 +244,24 @@ Lsh512::~Lsh512()
     init();
 }
 
+void Lsh512::compressBlocks(const uint8_t* data, size_t count)
+{
+    switch (this->_simd)
+    {
+    case LshSimd::AVX2:
+        compress_avx2(this->_state.data(), STEP_CONSTANTS, data, count);
+        break;
+
+    case LshSimd::SSSE3:
+        compress_ssse3(this->_state.data(), STEP_CONSTANTS, data, count);
+        break;
+
+    default:
+        Lsh512_t::compressBlocks(data, count);
+        break;
+    }
+}
+
 void Lsh512::init()
 {
     Lsh512_t::init();
@@ -113,59 +269,19 @@ void Lsh512::init()
     switch(this->_output_length) 
     {
     case BIT_224:
-        init224();
+        std::copy(IV_224, IV_224 + 16, this->_state.begin());
         break;
 
     case BIT_256:
-        init256();
+        std::copy(IV_256, IV_256 + 16, this->_state.begin());
         break;
 
     case BIT_384:
-        init384();
+        std::copy(IV_384, IV_384 + 16, this->_state.begin());
         break;
 
     case BIT_512:
-        init512();
+        std::copy(IV_512, IV_512 + 16, this->_state.begin());
         break;
     }
 }
-
-void Lsh512::init224() 
-{
-    this->_state = {
-        0x0C401E9FE8813A55L, 0x4A5F446268FD3D35L, 0xFF13E452334F612AL, 0xF8227661037E354AL,
-        0xA5F223723C9CA29DL, 0x95D965A11AED3979L, 0x01E23835B9AB02CCL, 0x52D49CBAD5B30616L,
-        0x9E5C2027773F4ED3L, 0x66A5C8801925B701L, 0x22BBC85B4C6779D9L, 0xC13171A42C559C23L,
-        0x31E2B67D25BE3813L, 0xD522C4DEED8E4D83L, 0xA79F5509B43FBAFEL, 0xE00D2CD88B4B6C6AL,
-    };
-}
-
-void Lsh512::init256() 
-{
-    this->_state = {
-        0x6DC57C33DF989423L, 0xD8EA7F6E8342C199L, 0x76DF8356F8603AC4L, 0x40F1B44DE838223AL,
-        0x39FFE7CFC31484CDL, 0x39C4326CC5281548L, 0x8A2FF85A346045D8L, 0xFF202AA46DBDD61EL,
-        0xCF785B3CD5FCDB8BL, 0x1F0323B64A8150BFL, 0xFF75D972F29EA355L, 0x2E567F30BF1CA9E1L,
-        0xB596875BF8FF6DBAL, 0xFCCA39B089EF4615L, 0xECFF4017D020B4B6L, 0x7E77384C772ED802L,
-    };
-}
-
-void Lsh512::init384() 
-{
-    this->_state = {
-        0x53156A66292808F6L, 0xB2C4F362B204C2BCL, 0xB84B7213BFA05C4EL, 0x976CEB7C1B299F73L,
-        0xDF0CC63C0570AE97L, 0xDA4441BAA486CE3FL, 0x6559F5D9B5F2ACC2L, 0x22DACF19B4B52A16L,
-        0xBBCDACEFDE80953AL, 0xC9891A2879725B3EL, 0x7C9FE6330237E440L, 0xA30BA550553F7431L,
-        0xBB08043FB34E3E30L, 0xA0DEC48D54618EADL, 0x150317267464BC57L, 0x32D1501FDE63DC93L,
-    };
-}
-
-void Lsh512::init512() 
-{
-    this->_state = {
-        0xadd50f3c7f07094eL, 0xe3f3cee8f9418a4fL, 0xb527ecde5b3d0ae9L, 0x2ef6dec68076f501L,
-        0x8cb994cae5aca216L, 0xfbb9eae4bba48cc7L, 0x650a526174725feaL, 0x1f9a61a73f8d8085L,
-        0xb6607378173b539bL, 0x1bc99853b0c0b9edL, 0xdf727fc19b182d47L, 0xdbef360cf893a457L,
-        0x4981f5e570147e80L, 0xd00c4490ca7d3e30L, 0x5d73940c0e4ae1ecL, 0x894085e2edb2d819L,
-    };
-}
\ No newline at end of file
@@ -0,0 +1,196 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "../../include/hash/lsh_multi_buffer.h"
+#include "../../include/hash/lsh.h"
+#include "../../include/hash/multi_buffer_lanes.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+using namespace mockup::crypto::hash;
+
+// one compression per lane, the state kept transposed as state[word * MAX_LANES + lane]
+template <typename LSH, typename WORD_T, typename V, size_t N, size_t MAX_LANES>
+__attribute__((always_inline))
+static inline void compress_lanes(WORD_T* state, const uint8_t* const* blocks)
+{
+    constexpr size_t steps = std::size(LSH::STEP_CONSTANTS) / 8;
+
+    V s[16];
+    V m[32];
+
+    for (auto i = 0; i < 16; ++i) {
+        std::memcpy(&s[i], state + i * MAX_LANES, sizeof(V));
+    }
+    load_lanes<V, N>(m, blocks, 32);
+
+    for (size_t j = 0; j < steps; j += 2) {
+        LSH::template step<LSH::ALPHA_EVEN, LSH::BETA_EVEN>(s, m, j);
+        LSH::expand_message(m, j);
+        LSH::template step<LSH::ALPHA_ODD, LSH::BETA_ODD>(s, m, j + 1);
+        LSH::expand_message(m, j + 1);
+    }
+
+    for (auto i = 0; i < 16; ++i) {
+        s[i] ^= m[i];
+        std::memcpy(state + i * MAX_LANES, &s[i], sizeof(V));
+    }
+}
+
+static void compress256_sse2(uint32_t* state, const uint8_t* const* blocks)
+{
+    compress_lanes<Lsh256, uint32_t, v4_t, 4, Lsh256MultiBuffer::MAX_LANES>(state, blocks);
+}
+
+__attribute__((target("avx2")))
+static void compress256_avx2(uint32_t* state, const uint8_t* const* blocks)
+{
+    compress_lanes<Lsh256, uint32_t, v8_t, 8, Lsh256MultiBuffer::MAX_LANES>(state, blocks);
+}
+
+static void compress512_sse2(uint64_t* state, const uint8_t* const* blocks)
+{
+    compress_lanes<Lsh512, uint64_t, v2q_t, 2, Lsh512MultiBuffer::MAX_LANES>(state, blocks);
+}
+
+__attribute__((target("avx2")))
+static void compress512_avx2(uint64_t* state, const uint8_t* const* blocks)
+{
+    compress_lanes<Lsh512, uint64_t, v4q_t, 4, Lsh512MultiBuffer::MAX_LANES>(state, blocks);
+}
+
+// the initial value and digest of one LSH output length, for hash_lanes
+template <typename WORD_T, size_t BLOCK_SIZE, size_t LANES>
+struct lsh_lanes_t {
+    using word_t = WORD_T;
+
+    static constexpr size_t STATE_WORDS = 16;
+    static constexpr size_t BLOCKSIZE = BLOCK_SIZE;
+    static constexpr size_t MAX_LANES = LANES;
+
+    const WORD_T* iv;
+    size_t outlen;
+
+    // LSH pads with a single one bit and no length, so the tail is always one block
+    size_t pad(uint8_t* tail, size_t remain, size_t length) const
+    {
+        return 1;
+    }
+
+    void init(WORD_T* state, size_t lane) const
+    {
+        for (auto j = 0; j < 16; ++j) {
+            state[j * MAX_LANES + lane] = iv[j];
+        }
+    }
+
+    void digest(uint8_t* out, const WORD_T* state, size_t lane) const
+    {
+        WORD_T words[8];
+        for (auto j = 0; j < 8; ++j) {
+            words[j] = state[j * MAX_LANES + lane] ^ state[(j + 8) * MAX_LANES + lane];
+        }
+        std::memcpy(out, words, outlen);
+    }
+};
+
+Lsh256MultiBuffer::Lsh256MultiBuffer(size_t outlen, bool useAvx2)
+{
+    switch (outlen) {
+    case BIT_224:
+        _iv = Lsh256::IV_224;
+        break;
+
+    case BIT_256:
+        _iv = Lsh256::IV_256;
+        break;
+
+    default:
+        throw "Illegal length";
+    }
+
+    _output_length = outlen;
+    _lanes = (useAvx2 && __builtin_cpu_supports("avx2")) ? 8 : 4;
+}
+
+size_t Lsh256MultiBuffer::lanes() const
+{
+    return _lanes;
+}
+
+size_t Lsh256MultiBuffer::outputsize() const
+{
+    return _output_length;
+}
+
+void Lsh256MultiBuffer::hashMany(const uint8_t* const* inputs, const size_t* lengths, uint8_t* const* outputs, size_t count) const
+{
+    auto compress = (_lanes == 8) ? compress256_avx2 : compress256_sse2;
+    hash_lanes(lsh_lanes_t<uint32_t, BLOCKSIZE, MAX_LANES>{_iv, _output_length}, compress, _lanes, inputs, lengths, outputs, count);
+}
+
+Lsh512MultiBuffer::Lsh512MultiBuffer(size_t outlen, bool useAvx2)
+{
+    switch (outlen) {
+    case BIT_224:
+        _iv = Lsh512::IV_224;
+        break;
+
+    case BIT_256:
+        _iv = Lsh512::IV_256;
+        break;
+
+    case BIT_384:
+        _iv = Lsh512::IV_384;
+        break;
+
+    case BIT_512:
+        _iv = Lsh512::IV_512;
+        break;
+
+    default:
+        throw "Illegal length";
+    }
+
+    _output_length = outlen;
+    _lanes = (useAvx2 && __builtin_cpu_supports("avx2")) ? 4 : 2;
+}
+
+size_t Lsh512MultiBuffer::lanes() const
+{
+    return _lanes;
+}
+
+size_t Lsh512MultiBuffer::outputsize() const
+{
+    return _output_length;
+}
+
+void Lsh512MultiBuffer::hashMany(const uint8_t* const* inputs, const size_t* lengths, uint8_t* const* outputs, size_t count) const
+{
+    auto compress = (_lanes == 4) ? compress512_avx2 : compress512_sse2;
+    hash_lanes(lsh_lanes_t<uint64_t, BLOCKSIZE, MAX_LANES>{_iv, _output_length}, compress, _lanes, inputs, lengths, outputs, count);
+}
@@ -24,121 +24,85 @@
 
 #include "../../include/hash/sha2.h"
 
-using namespace mockup::crypto::hash;
-
-Sha256::Sha256() : Sha2()
-{
-    K = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5, 
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3, 
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
-    };
-
-    H = {
-        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
-    };
-
-    init();
-}
-
-const std::string Sha256::name() const 
-{
-    return "SHA256";
-}
+#include <immintrin.h>
 
-size_t Sha256::blocksize() const 
-{
-    return 64;
-}
+using namespace mockup::crypto::hash;
 
-size_t Sha256::outputsize() const 
+// four rounds on the ABEF/CDGH register pair, the schedule words w already byte swapped
+__attribute__((target("sha,sse4.1")))
+static inline void shani_rounds(__m128i& abef, __m128i& cdgh, __m128i w, int i)
 {
-    return 32;
+    auto wk = _mm_add_epi32(w, _mm_load_si128(reinterpret_cast<const __m128i*>(Sha256::ROUND_CONSTANTS + i)));
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+    abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
 }
 
-void Sha256::init()
+// w0 = sigma1(w3) + w2[..] + sigma0(w1) + w0, the next four schedule words
+__attribute__((target("sha,sse4.1")))
+static inline __m128i shani_schedule(__m128i w0, __m128i w1, __m128i w2, __m128i w3)
 {
-    offset = 0;
-    totalLength = 0;
-
-    W.clear();
-    W.assign(64, 0);
-
-    block.clear();
-    block.assign(64, 0);
-
-    state.clear();
-    state.assign(H.begin(), H.end());
+    auto w = _mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4));
+    return _mm_sha256msg2_epu32(w, w3);
 }
 
-void Sha256::expandMessage(const uint8_t* data) 
+__attribute__((target("sha,sse4.1")))
+static void shani_compress(uint32_t* state, const uint8_t* data, size_t count)
 {
-    for (auto i = 0; i < 16; ++i) {                
-        W[i]  = static_cast<uint32_t>(data[0]) << 24;
-        W[i] |= static_cast<uint32_t>(data[1]) << 16;
-        W[i] |= static_cast<uint32_t>(data[2]) << 8;
-        W[i] |= static_cast<uint32_t>(data[3]);
-
-        data += 4;
+    const auto bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // the instructions keep the state as ABEF and CDGH
+    auto dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+    auto hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+    auto badc = _mm_shuffle_epi32(dcba, 0xb1);
+    auto fehg = _mm_shuffle_epi32(hgfe, 0x1b);
+    auto abef = _mm_alignr_epi8(badc, fehg, 8);
+    auto cdgh = _mm_blend_epi16(fehg, badc, 0xf0);
+
+    for (size_t n = 0; n < count; ++n) {
+        auto saved_abef = abef;
+        auto saved_cdgh = cdgh;
+
+        __m128i w[4];
+        for (auto j = 0; j < 4; ++j) {
+            w[j] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * j)), bswap);
+            shani_rounds(abef, cdgh, w[j], 4 * j);
+        }
+
+        for (auto i = 16; i < 64; i += 4) {
+            auto j = (i >> 2) & 3;
+            w[j] = shani_schedule(w[j], w[(j + 1) & 3], w[(j + 2) & 3], w[(j + 3) & 3]);
+            shani_rounds(abef, cdgh, w[j], i);
+        }
+
+        abef = _mm_add_epi32(abef, saved_abef);
+        cdgh = _mm_add_epi32(cdgh, saved_cdgh);
+        data += 64;
     }
 
-    for (auto t = 16; t < 64; ++t) {
-        W[t] = sigma1(W[t - 2]) + W[t - 7] + sigma0(W[t - 15]) + W[t - 16];
-    }
-}
-
-std::vector<uint8_t> Sha256::toOutput() const
-{
-    std::vector<uint8_t> digest;
-    for (auto h : state) {
-        digest.push_back(h >> 24);
-        digest.push_back(h >> 16);
-        digest.push_back(h >> 8);
-        digest.push_back(h);
-    }
+    auto feba = _mm_shuffle_epi32(abef, 0x1b);
+    auto dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    dcba = _mm_blend_epi16(feba, dchg, 0xf0);
+    hgfe = _mm_alignr_epi8(dchg, feba, 8);
 
-    return digest;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), dcba);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), hgfe);
 }
 
-void Sha256::processLength()
+Sha256::Sha256(bool useShaNi) : Sha2()
 {
-    if (offset > 56) {
-        updateBlock(block.data());
-        std::fill(block.begin(), block.end(), 0);
-    }
-
-    totalLength <<= 3;
-    block[56] = totalLength >> 56;
-    block[57] = totalLength >> 48;
-    block[58] = totalLength >> 40;
-    block[59] = totalLength >> 32;
-    block[60] = totalLength >> 24;
-    block[61] = totalLength >> 16;
-    block[62] = totalLength >> 8;
-    block[63] = totalLength;
+    _shani = useShaNi && __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
 }
 
-uint32_t Sha256::sum0(uint32_t x) const
-{
-    return Arx::rotr(x, 2) ^ Arx::rotr(x, 13) ^ Arx::rotr(x, 22);
-}
-
-uint32_t Sha256::sum1(uint32_t x) const
+const std::string Sha256::name() const 
 {
-    return Arx::rotr(x, 6) ^ Arx::rotr(x, 11) ^ Arx::rotr(x, 25);
+    return "SHA256";
 }
 
-uint32_t Sha256::sigma0(uint32_t x) const
+void Sha256::updateBlocks(const uint8_t* data, size_t count)
 {
-    return Arx::rotr(x, 7) ^ Arx::rotr(x, 18) ^ (x >> 3);
+    if (_shani) {
+        shani_compress(state.data(), data, count);
+    } else {
+        Sha2::updateBlocks(data, count);
+    }
 }
-
-uint32_t Sha256::sigma1(uint32_t x) const
-{
-    return Arx::rotr(x, 17) ^ Arx::rotr(x, 19) ^ (x >> 10);
-}
\ No newline at end of file
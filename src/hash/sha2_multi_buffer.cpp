@@ -0,0 +1,239 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "../../include/hash/sha256_multi_buffer.h"
+#include "../../include/hash/sha512_multi_buffer.h"
+#include "../../include/hash/sha2.h"
+#include "../../include/hash/multi_buffer_lanes.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+using namespace mockup::crypto::hash;
+
+typedef uint8_t b16_t __attribute__((vector_size(16)));
+typedef uint8_t b32_t __attribute__((vector_size(32)));
+
+// the rotation and shift amounts of the round functions, the last one of sigma being a shift
+template <typename SHA>
+struct rotations_t;
+
+template <>
+struct rotations_t<Sha256> {
+    using word_t = uint32_t;
+    static constexpr int SUM0[3] = {2, 13, 22};
+    static constexpr int SUM1[3] = {6, 11, 25};
+    static constexpr int SIGMA0[3] = {7, 18, 3};
+    static constexpr int SIGMA1[3] = {17, 19, 10};
+};
+
+template <>
+struct rotations_t<Sha512> {
+    using word_t = uint64_t;
+    static constexpr int SUM0[3] = {28, 34, 39};
+    static constexpr int SUM1[3] = {14, 18, 41};
+    static constexpr int SIGMA0[3] = {1, 8, 7};
+    static constexpr int SIGMA1[3] = {19, 61, 6};
+};
+
+template <typename WORD_T>
+static inline void store_be(uint8_t* out, WORD_T value)
+{
+    if constexpr (sizeof(WORD_T) == 4) {
+        value = __builtin_bswap32(value);
+    } else {
+        value = __builtin_bswap64(value);
+    }
+    std::memcpy(out, &value, sizeof(value));
+}
+
+#define ROTR(x, n, bits) (((x) >> (n)) | ((x) << ((bits) - (n))))
+#define SUM(x, r, bits) (ROTR(x, r[0], bits) ^ ROTR(x, r[1], bits) ^ ROTR(x, r[2], bits))
+#define SIGMA(x, r, bits) (ROTR(x, r[0], bits) ^ ROTR(x, r[1], bits) ^ ((x) >> r[2]))
+
+// the big endian message words of a block, in one byte shuffle per vector
+template <typename WORD_T, typename V>
+__attribute__((always_inline))
+static inline void byteswap_lanes(V* w, size_t count)
+{
+    using bytes_t = std::conditional_t<sizeof(V) == 16, b16_t, b32_t>;
+    constexpr size_t last = sizeof(WORD_T) - 1;
+
+    bytes_t mask;
+    for (size_t i = 0; i < sizeof(V); ++i) {
+        mask[i] = (i & ~last) | (last - (i & last));
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        w[i] = reinterpret_cast<V>(__builtin_shuffle(reinterpret_cast<bytes_t>(w[i]), mask));
+    }
+}
+
+// one compression per lane, the state kept transposed as state[word * MAX_LANES + lane]
+template <typename SHA, typename V, size_t N, size_t MAX_LANES>
+__attribute__((always_inline))
+static inline void compress_lanes(typename rotations_t<SHA>::word_t* state, const uint8_t* const* blocks)
+{
+    using R = rotations_t<SHA>;
+    using word_t = typename R::word_t;
+    constexpr size_t bits = 8 * sizeof(word_t);
+    constexpr size_t rounds = std::size(SHA::ROUND_CONSTANTS);
+
+    V s[8];
+    V w[16];
+
+    for (auto i = 0; i < 8; ++i) {
+        std::memcpy(&s[i], state + i * MAX_LANES, sizeof(V));
+    }
+
+    load_lanes<V, N>(w, blocks, 16);
+    byteswap_lanes<word_t>(w, 16);
+
+    auto a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (size_t t = 0; t < rounds; ++t) {
+        auto& wt = w[t & 15];
+        if (t >= 16) {
+            auto w2 = w[(t - 2) & 15];
+            auto w15 = w[(t - 15) & 15];
+            wt += SIGMA(w2, R::SIGMA1, bits) + w[(t - 7) & 15] + SIGMA(w15, R::SIGMA0, bits);
+        }
+
+        auto t1 = h + SUM(e, R::SUM1, bits) + (((f ^ g) & e) ^ g) + SHA::ROUND_CONSTANTS[t] + wt;
+        auto t2 = SUM(a, R::SUM0, bits) + ((a & b) | ((a | b) & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+    s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+
+    for (auto i = 0; i < 8; ++i) {
+        std::memcpy(state + i * MAX_LANES, &s[i], sizeof(V));
+    }
+}
+
+static void compress256_sse2(uint32_t* state, const uint8_t* const* blocks)
+{
+    compress_lanes<Sha256, v4_t, 4, Sha256MultiBuffer::MAX_LANES>(state, blocks);
+}
+
+__attribute__((target("avx2")))
+static void compress256_avx2(uint32_t* state, const uint8_t* const* blocks)
+{
+    compress_lanes<Sha256, v8_t, 8, Sha256MultiBuffer::MAX_LANES>(state, blocks);
+}
+
+static void compress512_sse2(uint64_t* state, const uint8_t* const* blocks)
+{
+    compress_lanes<Sha512, v2q_t, 2, Sha512MultiBuffer::MAX_LANES>(state, blocks);
+}
+
+__attribute__((target("avx2")))
+static void compress512_avx2(uint64_t* state, const uint8_t* const* blocks)
+{
+    compress_lanes<Sha512, v4q_t, 4, Sha512MultiBuffer::MAX_LANES>(state, blocks);
+}
+
+// the padding, initial value and digest of SHA, for hash_lanes
+template <typename SHA, size_t LANES>
+struct sha2_lanes_t {
+    using word_t = typename rotations_t<SHA>::word_t;
+
+    static constexpr size_t STATE_WORDS = 8;
+    static constexpr size_t BLOCKSIZE = SHA::BLOCKSIZE;
+    static constexpr size_t MAX_LANES = LANES;
+
+    size_t pad(uint8_t* tail, size_t remain, size_t length) const
+    {
+        // the message length takes the last two words, of which the upper half stays zero for SHA-512
+        size_t tailBlocks = (remain < BLOCKSIZE - 2 * sizeof(word_t)) ? 1 : 2;
+        store_be(tail + tailBlocks * BLOCKSIZE - 8, static_cast<uint64_t>(length) << 3);
+        return tailBlocks;
+    }
+
+    void init(word_t* state, size_t lane) const
+    {
+        for (auto j = 0; j < 8; ++j) {
+            state[j * MAX_LANES + lane] = SHA::IV[j];
+        }
+    }
+
+    void digest(uint8_t* out, const word_t* state, size_t lane) const
+    {
+        for (auto j = 0; j < 8; ++j) {
+            store_be(out + sizeof(word_t) * j, state[j * MAX_LANES + lane]);
+        }
+    }
+};
+
+Sha256MultiBuffer::Sha256MultiBuffer(bool useAvx2, bool useShaNi)
+{
+    _shani = useShaNi && __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+    _lanes = _shani ? 1 : (useAvx2 && __builtin_cpu_supports("avx2")) ? 8 : 4;
+}
+
+size_t Sha256MultiBuffer::lanes() const
+{
+    return _lanes;
+}
+
+void Sha256MultiBuffer::hashMany(const uint8_t* const* inputs, const size_t* lengths, uint8_t* const* outputs, size_t count) const
+{
+    if (_shani) {
+        Sha256 sha;
+        for (size_t i = 0; i < count; ++i) {
+            sha.update(inputs[i], lengths[i]);
+            sha.doFinal(outputs[i]);
+        }
+        return;
+    }
+
+    auto compress = (_lanes == 8) ? compress256_avx2 : compress256_sse2;
+    hash_lanes(sha2_lanes_t<Sha256, MAX_LANES>(), compress, _lanes, inputs, lengths, outputs, count);
+}
+
+Sha512MultiBuffer::Sha512MultiBuffer(bool useAvx2)
+{
+    _lanes = (useAvx2 && __builtin_cpu_supports("avx2")) ? 4 : 2;
+}
+
+size_t Sha512MultiBuffer::lanes() const
+{
+    return _lanes;
+}
+
+void Sha512MultiBuffer::hashMany(const uint8_t* const* inputs, const size_t* lengths, uint8_t* const* outputs, size_t count) const
+{
+    auto compress = (_lanes == 4) ? compress512_avx2 : compress512_sse2;
+    hash_lanes(sha2_lanes_t<Sha512, MAX_LANES>(), compress, _lanes, inputs, lengths, outputs, count);
+}
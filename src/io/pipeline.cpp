@@ -0,0 +1,536 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "../../include/io/pipeline.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace mockup::crypto::io;
+
+static constexpr size_t PIPELINE_ALIGNMENT = 4096;
+static constexpr size_t PIPELINE_IO_THREADS = 2;
+
+struct io_request_t {
+    size_t slot;
+    bool write;
+    int fd;
+    uint8_t* buffer;
+    size_t length;
+    uint64_t offset;
+};
+
+struct io_completion_t {
+    size_t slot;
+    bool write;
+    ssize_t result;
+};
+
+class Pipeline::IoQueue {
+public:
+    virtual ~IoQueue() = default;
+
+    virtual Backend backend() const = 0;
+    virtual void submit(const io_request_t& request) = 0;
+    virtual io_completion_t wait() = 0;
+
+    // hands queued requests to the kernel without waiting, for queues that batch them
+    virtual void flush() {}
+};
+
+/******************************************************************************
+ * io_uring through the kernel interface, without liburing
+ *****************************************************************************/
+class UringQueue : public Pipeline::IoQueue {
+private:
+    int _fd;
+    uint8_t* _buffers;
+    size_t _capacity;
+    bool _fixed;
+    unsigned _pending;
+
+    void* _sqRing;
+    void* _cqRing;
+    size_t _sqRingSize;
+    size_t _cqRingSize;
+    io_uring_sqe* _sqes;
+    size_t _sqesSize;
+
+    unsigned* _sqTail;
+    unsigned* _sqMask;
+    unsigned* _sqArray;
+    unsigned* _cqHead;
+    unsigned* _cqTail;
+    unsigned* _cqMask;
+    io_uring_cqe* _cqes;
+
+public:
+    UringQueue(uint8_t* buffers, size_t capacity, size_t depth) 
+        : _fd(-1), _buffers(buffers), _capacity(capacity), _fixed(false), _pending(0), _sqRing(MAP_FAILED), _cqRing(MAP_FAILED), _sqes(nullptr)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        _fd = syscall(__NR_io_uring_setup, depth, &params);
+        if (_fd < 0) {
+            throw "io_uring is not available";
+        }
+
+        _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+        }
+
+        _sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        _cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? _sqRing : 
+            mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+
+        _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        auto sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+
+        if (_sqRing == MAP_FAILED || _cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+            release();
+            throw "io_uring is not available";
+        }
+        _sqes = static_cast<io_uring_sqe*>(sqes);
+
+        auto sq = static_cast<uint8_t*>(_sqRing);
+        auto cq = static_cast<uint8_t*>(_cqRing);
+        _sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        _sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        _sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        _cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        _cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        _cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // registered buffers save pinning pages on every request, but plain reads and writes do when pinning is not allowed
+        std::vector<iovec> iovs(depth);
+        for (size_t i = 0; i < depth; ++i) {
+            iovs[i] = {buffers + i * capacity, capacity};
+        }
+        _fixed = syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS, iovs.data(), depth) == 0;
+    }
+
+    ~UringQueue()
+    {
+        release();
+    }
+
+    Pipeline::Backend backend() const override
+    {
+        return Pipeline::Backend::URING;
+    }
+
+    void submit(const io_request_t& request) override
+    {
+        auto tail = *_sqTail;
+        auto index = tail & *_sqMask;
+        auto sqe = _sqes + index;
+
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        if (_fixed) {
+            sqe->opcode = request.write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->buf_index = request.slot;
+        } else {
+            sqe->opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+        }
+        sqe->fd = request.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(request.buffer);
+        sqe->len = request.length;
+        sqe->off = request.offset;
+        sqe->user_data = (request.slot << 1) | (request.write ? 1 : 0);
+
+        _sqArray[index] = index;
+        __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+        _pending += 1;
+    }
+
+    void flush() override
+    {
+        while (_pending > 0) {
+            auto submitted = syscall(__NR_io_uring_enter, _fd, _pending, 0, 0, nullptr, 0);
+            if (submitted < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw "I/O error";
+            }
+            if (submitted == 0) {
+                // whatever is left goes with the next wait
+                break;
+            }
+            _pending -= std::min(_pending, static_cast<unsigned>(submitted));
+        }
+    }
+
+    io_completion_t wait() override
+    {
+        // requests queued since the last flush are submitted by the same system call
+        while (true) {
+            auto head = *_cqHead;
+            if (head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+                auto cqe = _cqes + (head & *_cqMask);
+                io_completion_t completion = {static_cast<size_t>(cqe->user_data >> 1), (cqe->user_data & 1) != 0, cqe->res};
+
+                __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+                return completion;
+            }
+
+            auto submitted = syscall(__NR_io_uring_enter, _fd, _pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw "I/O error";
+            }
+            _pending -= std::min(_pending, static_cast<unsigned>(submitted));
+        }
+    }
+
+private:
+    void release()
+    {
+        if (_sqes != nullptr) {
+            munmap(_sqes, _sqesSize);
+        }
+        if (_cqRing != MAP_FAILED && _cqRing != _sqRing) {
+            munmap(_cqRing, _cqRingSize);
+        }
+        if (_sqRing != MAP_FAILED) {
+            munmap(_sqRing, _sqRingSize);
+        }
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+};
+
+/******************************************************************************
+ * pread and pwrite on a pool of threads
+ *****************************************************************************/
+class ThreadQueue : public Pipeline::IoQueue {
+private:
+    std::mutex _mutex;
+    std::condition_variable _requested;
+    std::condition_variable _completed;
+    std::deque<io_request_t> _requests;
+    std::deque<io_completion_t> _completions;
+    std::vector<std::thread> _threads;
+    bool _stopping;
+
+public:
+    ThreadQueue(size_t threads) : _stopping(false)
+    {
+        for (size_t i = 0; i < threads; ++i) {
+            _threads.emplace_back([this] { work(); });
+        }
+    }
+
+    ~ThreadQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _requested.notify_all();
+
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+    }
+
+    Pipeline::Backend backend() const override
+    {
+        return Pipeline::Backend::THREADS;
+    }
+
+    void submit(const io_request_t& request) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _requests.push_back(request);
+        }
+        _requested.notify_one();
+    }
+
+    io_completion_t wait() override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _completed.wait(lock, [this] { return _completions.empty() == false; });
+
+        auto completion = _completions.front();
+        _completions.pop_front();
+        return completion;
+    }
+
+private:
+    void work()
+    {
+        while (true) {
+            io_request_t request;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _requested.wait(lock, [this] { return _stopping || _requests.empty() == false; });
+                if (_requests.empty()) {
+                    return;
+                }
+
+                request = _requests.front();
+                _requests.pop_front();
+            }
+
+            auto result = request.write ? pwrite(request.fd, request.buffer, request.length, request.offset) 
+                : pread(request.fd, request.buffer, request.length, request.offset);
+            auto completion = io_completion_t{request.slot, request.write, (result < 0) ? -errno : result};
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _completions.push_back(completion);
+            }
+            _completed.notify_one();
+        }
+    }
+};
+
+/******************************************************************************
+ * Pipeline
+ *****************************************************************************/
+enum class slot_state_t {
+    FREE,
+    READING,
+    READY,
+    WRITING
+};
+
+struct slot_t {
+    slot_state_t state;
+    uint64_t chunk;
+    uint64_t offset;
+    size_t length;
+    size_t done;
+};
+
+Pipeline::Pipeline(size_t chunkSize, size_t slack, size_t depth, Backend backend) 
+    : _chunkSize(chunkSize), _depth(depth), _buffers(nullptr)
+{
+    if (chunkSize == 0 || depth == 0) {
+        throw "Illegal length";
+    }
+
+    // the ring of buffers must not wrap around the size of the address space
+    if (chunkSize > SIZE_MAX / 2 / depth || slack > SIZE_MAX / 2 / depth) {
+        throw "Illegal length";
+    }
+
+    _capacity = (chunkSize + slack + PIPELINE_ALIGNMENT - 1) / PIPELINE_ALIGNMENT * PIPELINE_ALIGNMENT;
+    _buffers = static_cast<uint8_t*>(std::aligned_alloc(PIPELINE_ALIGNMENT, _capacity * _depth));
+    if (_buffers == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    try {
+        if (backend == Backend::URING) {
+            try {
+                _queue.reset(new UringQueue(_buffers, _capacity, _depth));
+            } catch (const char* e) {
+            }
+        }
+
+        if (_queue == nullptr) {
+            _queue.reset(new ThreadQueue(PIPELINE_IO_THREADS));
+        }
+
+    } catch (...) {
+        // the destructor does not run for a constructor that throws
+        std::free(_buffers);
+        throw;
+    }
+}
+
+Pipeline::~Pipeline()
+{
+    _queue.reset();
+    std::free(_buffers);
+}
+
+Pipeline::Backend Pipeline::backend() const
+{
+    return _queue->backend();
+}
+
+uint64_t Pipeline::run(int infd, int outfd, const Stage& stage)
+{
+    if (_buffers == nullptr) {
+        throw "Illegal state";
+    }
+
+    struct stat st;
+    if (fstat(infd, &st) != 0) {
+        throw "I/O error";
+    }
+
+    // an empty file is still one empty last chunk, so that the stage can finish its output
+    uint64_t size = st.st_size;
+    uint64_t chunks = std::max((size + _chunkSize - 1) / _chunkSize, static_cast<uint64_t>(1));
+
+    std::vector<slot_t> slots(_depth, slot_t{slot_state_t::FREE, 0, 0, 0, 0});
+    uint64_t nextRead = 0;
+    uint64_t nextCompute = 0;
+    uint64_t written = 0;
+    size_t inflight = 0;
+
+    auto submit = [&](size_t i, bool write, int fd) {
+        auto& slot = slots[i];
+        _queue->submit({i, write, fd, _buffers + i * _capacity + slot.done, slot.length - slot.done, slot.offset + slot.done});
+        inflight += 1;
+    };
+
+    try {
+        while (nextCompute < chunks) {
+            // every free buffer reads ahead
+            for (size_t i = 0; i < _depth && nextRead < chunks; ++i) {
+                auto& slot = slots[i];
+                if (slot.state != slot_state_t::FREE) {
+                    continue;
+                }
+
+                slot = {slot_state_t::READING, nextRead, nextRead * _chunkSize, 0, 0};
+                slot.length = std::min(static_cast<uint64_t>(_chunkSize), size - slot.offset);
+                nextRead += 1;
+
+                if (slot.length == 0) {
+                    slot.state = slot_state_t::READY;
+                } else {
+                    submit(i, false, infd);
+                }
+            }
+
+            auto ready = [&]() {
+                size_t i = 0;
+                while (i < _depth && (slots[i].state != slot_state_t::READY || slots[i].chunk != nextCompute)) {
+                    i += 1;
+                }
+                return i;
+            };
+
+            // chunks are processed strictly in order, while other buffers are still being read or written
+            auto computed = false;
+            for (auto i = ready(); i < _depth; i = ready()) {
+                // the reads ahead and the previous write are in flight while this chunk is computed
+                _queue->flush();
+
+                auto& slot = slots[i];
+                auto outlen = stage(_buffers + i * _capacity, slot.length, slot.chunk, slot.chunk == chunks - 1);
+                if (outlen > _capacity) {
+                    throw "Illegal length";
+                }
+
+                nextCompute += 1;
+                computed = true;
+
+                if (outfd < 0 || outlen == 0) {
+                    slot.state = slot_state_t::FREE;
+                } else {
+                    slot = {slot_state_t::WRITING, slot.chunk, written, outlen, 0};
+                    written += outlen;
+                    submit(i, true, outfd);
+                }
+            }
+
+            if (computed || nextCompute == chunks) {
+                continue;
+            }
+
+            auto completion = _queue->wait();
+            auto& slot = slots[completion.slot];
+            inflight -= 1;
+
+            if (completion.result < 0 || (completion.result == 0 && slot.done < slot.length)) {
+                throw "I/O error";
+            }
+
+            slot.done += completion.result;
+            if (slot.done < slot.length) {
+                submit(completion.slot, completion.write, completion.write ? outfd : infd);
+            } else {
+                slot.state = completion.write ? slot_state_t::FREE : slot_state_t::READY;
+            }
+        }
+
+        // the last writes
+        while (inflight > 0) {
+            auto completion = _queue->wait();
+            auto& slot = slots[completion.slot];
+            inflight -= 1;
+
+            if (completion.result <= 0) {
+                throw "I/O error";
+            }
+
+            slot.done += completion.result;
+            if (slot.done < slot.length) {
+                submit(completion.slot, true, outfd);
+            }
+        }
+
+    } catch (...) {
+        drain(inflight);
+        throw;
+    }
+
+    return written;
+}
+
+// the buffers stay owned by requests in flight until they complete, and the exception being handled must not be replaced
+void Pipeline::drain(size_t inflight) noexcept
+{
+    try {
+        while (inflight > 0) {
+            _queue->wait();
+            inflight -= 1;
+        }
+
+    } catch (...) {
+        // requests that cannot be reaped may still write into the buffers, so they are given up rather than freed,
+        // and the pipeline refuses to run again
+        _buffers = nullptr;
+    }
+}
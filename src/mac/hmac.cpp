@@ -33,6 +33,13 @@ Hmac::Hmac(std::shared_ptr<Hash> hash) : hash(hash)
 {
     blocksize = hash->blocksize();
     block.assign(blocksize, 0);
+
+    opad.assign(blocksize, 0);
+    ipad.assign(blocksize, 0);
+    digest.assign(hash->outputsize(), 0);
+
+    inner = hash->clone();
+    outer = hash->clone();
 }
 
 const std::string Hmac::name() const 
@@ -40,26 +47,34 @@ const std::string Hmac::name() const
     return "HMAC_" + hash->name();
 }
 
+size_t Hmac::outputsize() const
+{
+    return hash->outputsize();
+}
+
 void Hmac::init(const uint8_t* key, size_t keysize)
 {
     offset = 0;
 
-    std::vector<uint8_t> ptr;
-    if (keysize > hash->blocksize()) {
+    if (keysize > blocksize) {
+        hash->init();
         hash->update(key, keysize);
-        ptr = hash->doFinal();
-    } else {
-        ptr.assign(key, key + keysize);
+        keysize = hash->doFinal(digest.data());
+        key = digest.data();
     }
 
-    opad.assign(hash->blocksize(), 0x5c);
-    ipad.assign(hash->blocksize(), 0x36);
+    std::fill(opad.begin(), opad.end(), 0x5c);
+    std::fill(ipad.begin(), ipad.end(), 0x36);
 
-    std::transform(ptr.begin(), ptr.end(), opad.begin(), opad.begin(), std::bit_xor<uint8_t>());
-    std::transform(ptr.begin(), ptr.end(), ipad.begin(), ipad.begin(), std::bit_xor<uint8_t>());
+    std::transform(key, key + keysize, opad.begin(), opad.begin(), std::bit_xor<uint8_t>());
+    std::transform(key, key + keysize, ipad.begin(), ipad.begin(), std::bit_xor<uint8_t>());
+
+    outer->init();
+    outer->update(opad);
 
     hash->init();
     hash->update(ipad);
+    inner->restore(*hash);
 }
 
 void Hmac::updateBlock(const uint8_t* data)
@@ -67,17 +82,20 @@ void Hmac::updateBlock(const uint8_t* data)
     hash->update(data, blocksize);
 }
 
-std::vector<uint8_t> Hmac::doFinal()
+size_t Hmac::doFinal(uint8_t* out)
 {
     if (offset > 0) {
         hash->update(block.data(), offset);
     }
-    auto tag = hash->doFinal();
+    hash->doFinal(digest.data());
 
-    hash->init();
-    hash->update(opad);
-    tag = hash->doFinal(tag);
+    hash->restore(*outer);
+    hash->update(digest);
+    auto outlen = hash->doFinal(out);
+
+    hash->restore(*inner);
+    offset = 0;
 
-    return tag;
+    return outlen;
 }
 
@@ -0,0 +1,192 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "../../include/mode/cbc.h"
+#include "../../include/padding/pkcs7_padding.h"
+#include "../../include/util/arrays.h"
+
+#include <algorithm>
+
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::padding;
+using namespace mockup::crypto::util;
+
+static constexpr size_t CBC_PARALLEL_BLOCKS = 8;
+static constexpr size_t CBC_MAX_BLOCKSIZE = 32;
+
+// xors 16 bytes at a time, leaving only the tail of 64-bit block ciphers to the byte loop
+static inline void xor_blocks(uint8_t* out, const uint8_t* rhs, size_t count)
+{
+    auto wide = count & ~static_cast<size_t>(15);
+    bitwise_xor128(out, rhs, wide);
+    bitwise_xor(out + wide, rhs + wide, count - wide);
+}
+
+static inline void xor_blocks(uint8_t* out, const uint8_t* lhs, const uint8_t* rhs, size_t count)
+{
+    auto wide = count & ~static_cast<size_t>(15);
+    bitwise_xor128(out, lhs, rhs, wide);
+    bitwise_xor(out + wide, lhs + wide, rhs + wide, count - wide);
+}
+
+const std::string CBC::name() const
+{
+    return "CBC/" + _cipher->name();
+}
+
+void CBC::initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen)
+{
+    BufferedBlockCipher::initCipher(cipher, mk, keylen);
+
+    if (_blocksize > CBC_MAX_BLOCKSIZE) {
+        throw "Illegal blocksize";
+    }
+
+    _padding = std::make_shared<Pkcs7Padding>(_blocksize);
+}
+
+void CBC::initMode(CipherMode mode, const uint8_t* iv, size_t ivLen)
+{
+    if (ivLen != _blocksize) {
+        throw "Illegal length";
+    }
+
+    _mode = mode;
+    _buffered = 0;
+    _chain.assign(iv, iv + ivLen);
+}
+
+size_t CBC::doFinal(uint8_t* out)
+{
+    uint8_t block[CBC_MAX_BLOCKSIZE];
+
+    if (_mode == CipherMode::ENCRYPT) {
+        _padding->Pad(block, _buffer, _buffered);
+        _buffered = 0;
+        updateBlock(out, block);
+
+        return _blocksize;
+    }
+
+    if (_buffered != _blocksize) {
+        throw "Illegal length";
+    }
+
+    updateBlock(block, _buffer);
+    _buffered = 0;
+
+    return _padding->UnPad(out, block);
+}
+
+void CBC::updateBlock(uint8_t* out, const uint8_t* in)
+{
+    if (_mode == CipherMode::ENCRYPT) {
+        xor_blocks(out, in, _chain.data(), _blocksize);
+        _cipher->encryptBlock(out, out);
+        std::copy(out, out + _blocksize, _chain.begin());
+
+    } else {
+        uint8_t saved[CBC_MAX_BLOCKSIZE];
+        std::copy(in, in + _blocksize, saved);
+
+        _cipher->decryptBlock(out, in);
+        xor_blocks(out, _chain.data(), _blocksize);
+        std::copy(saved, saved + _blocksize, _chain.begin());
+    }
+}
+
+void CBC::updateBlocks(uint8_t* out, const uint8_t* in, size_t count)
+{
+    // encryption is chained through every block, so only decryption can be batched
+    if (_mode == CipherMode::ENCRYPT) {
+        BufferedBlockCipher::updateBlocks(out, in, count);
+        return;
+    }
+
+    uint8_t saved[CBC_PARALLEL_BLOCKS * CBC_MAX_BLOCKSIZE];
+
+    while (count > 0) {
+        auto blocks = std::min(count, CBC_PARALLEL_BLOCKS);
+        auto length = blocks * _blocksize;
+
+        // ciphertext is kept aside, since out may overwrite in when in-place
+        std::copy(in, in + length, saved);
+        _cipher->decryptBlocks(out, in, blocks);
+
+        xor_blocks(out, _chain.data(), _blocksize);
+        xor_blocks(out + _blocksize, saved, length - _blocksize);
+        std::copy(saved + length - _blocksize, saved + length, _chain.begin());
+
+        out += length;
+        in += length;
+        count -= blocks;
+    }
+}
+
+void CBC::encryptMany(uint8_t* const* outs, size_t* outlens, const uint8_t* const* msgs, const size_t* msglens, const uint8_t* const* ivs, size_t count)
+{
+    uint8_t batch[CBC_PARALLEL_BLOCKS * CBC_MAX_BLOCKSIZE];
+    size_t lanes[CBC_PARALLEL_BLOCKS];
+
+    for (size_t first = 0; first < count; first += CBC_PARALLEL_BLOCKS) {
+        auto streams = std::min(count - first, CBC_PARALLEL_BLOCKS);
+        size_t maxBlocks = 0;
+
+        for (auto i = first; i < first + streams; ++i) {
+            outlens[i] = (msglens[i] / _blocksize + 1) * _blocksize;
+            maxBlocks = std::max(maxBlocks, outlens[i] / _blocksize);
+        }
+
+        // block j of every stream still running goes through a single cipher call
+        for (size_t j = 0; j < maxBlocks; ++j) {
+            auto offset = j * _blocksize;
+            size_t active = 0;
+
+            for (auto i = first; i < first + streams; ++i) {
+                if (offset >= outlens[i]) {
+                    continue;
+                }
+
+                auto block = batch + active * _blocksize;
+                auto chain = (j == 0) ? ivs[i] : outs[i] + offset - _blocksize;
+
+                if (offset + _blocksize <= msglens[i]) {
+                    xor_blocks(block, msgs[i] + offset, chain, _blocksize);
+                } else {
+                    _padding->Pad(block, msgs[i] + offset, msglens[i] - offset);
+                    xor_blocks(block, chain, _blocksize);
+                }
+
+                lanes[active++] = i;
+            }
+
+            _cipher->encryptBlocks(batch, batch, active);
+
+            for (size_t n = 0; n < active; ++n) {
+                std::copy(batch + n * _blocksize, batch + (n + 1) * _blocksize, outs[lanes[n]] + offset);
+            }
+        }
+    }
+}
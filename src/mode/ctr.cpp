@@ -25,9 +25,14 @@
 #include "../../include/mode/ctr.h"
 #include "../../include/util/arrays.h"
 
+#include <algorithm>
+
 using namespace mockup::crypto::mode;
 using namespace mockup::crypto::util;
 
+static constexpr size_t CTR_PARALLEL_BLOCKS = 8;
+static constexpr size_t CTR_MAX_BLOCKSIZE = 32;
+
 const std::string CTR::name() const
 {
     return "CTR/" + _cipher->name();
@@ -35,6 +40,12 @@ const std::string CTR::name() const
 
 void CTR::initMode(CipherMode mode, const uint8_t* iv, size_t ivLen)
 {
+    if (ivLen > _blocksize) {
+        throw "Illegal length";
+    }
+
+    _mode = mode;
+    _buffered = 0;
     _counter.clear();
     _counter.assign(_blocksize, 0x00);
     std::copy(iv, iv + ivLen, _counter.data());
@@ -43,7 +54,7 @@ void CTR::initMode(CipherMode mode, const uint8_t* iv, size_t ivLen)
 size_t CTR::doFinal(uint8_t* out)
 {
     auto outlen = 0;
-    auto offset = _buffer.size();
+    auto offset = _buffered;
 
     if (offset > 0) {
         uint8_t ks[64] = {0};
@@ -51,7 +62,7 @@ size_t CTR::doFinal(uint8_t* out)
         _cipher->encryptBlock(ks, _counter.data());
         increaseCounter();
 
-        bitwise_xor(out, _buffer.data(), ks, offset);
+        bitwise_xor(out, _buffer, ks, offset);
 
         outlen += offset;
     }
@@ -69,10 +80,50 @@ void CTR::updateBlock(uint8_t* out, const uint8_t* in)
     bitwise_xor(out, in, ks, _blocksize);
 }
 
+void CTR::updateBlocks(uint8_t* out, const uint8_t* in, size_t count)
+{
+    uint8_t ks[CTR_PARALLEL_BLOCKS * CTR_MAX_BLOCKSIZE];
+
+    while (count > 0) {
+        auto blocks = std::min(count, CTR_PARALLEL_BLOCKS);
+        auto length = blocks * _blocksize;
+
+        for (auto i = 0; i < blocks; ++i) {
+            std::copy(_counter.begin(), _counter.end(), ks + i * _blocksize);
+            increaseCounter();
+        }
+
+        _cipher->encryptBlocks(ks, ks, blocks);
+
+        auto wide = length & ~static_cast<size_t>(15);
+        bitwise_xor128(out, in, ks, wide);
+        bitwise_xor(out + wide, in + wide, ks + wide, length - wide);
+
+        out += length;
+        in += length;
+        count -= blocks;
+    }
+}
+
+void CTR::skipBlocks(uint64_t count)
+{
+    if (_buffered != 0) {
+        throw "Illegal length";
+    }
+
+    // counter += count, as a big endian integer over the whole block
+    uint64_t carry = count;
+    for (auto i = _counter.size(); i > 0 && carry > 0; --i) {
+        auto sum = static_cast<uint64_t>(_counter[i - 1]) + (carry & 0xff);
+        _counter[i - 1] = static_cast<uint8_t>(sum);
+        carry = (carry >> 8) + (sum >> 8);
+    }
+}
+
 void CTR::increaseCounter()
 {
-    for (auto i = _counter.size(); ++_counter[i] == 0; --i) {
-        if (i == 0) {
+    for (auto i = _counter.size(); i > 0; --i) {
+        if (++_counter[i - 1] != 0) {
             break;
         }
     }
@@ -24,17 +24,75 @@
 
 #include "../../include/mode/ecb.h"
 
+#include <algorithm>
+#include <thread>
+
 using namespace mockup::crypto;
 using namespace mockup::crypto::mode;
 
+// below this, starting threads costs more than it saves
+static constexpr size_t ECB_PARALLEL_THRESHOLD = 256 * 1024;
+
 const std::string Ecb::name() const
 {
     return "ECB/" + _cipher->name();
 }
 
+void Ecb::initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen)
+{
+    BufferedBlockCipher::initCipher(cipher, mk, keylen);
+
+    for (auto& worker : _workers) {
+        worker->init(mk, keylen);
+
+        if (worker->blocksize() != _blocksize) {
+            throw "Illegal blocksize";
+        }
+    }
+}
+
+void Ecb::setWorkers(const std::vector<std::shared_ptr<BlockCipher>>& workers)
+{
+    // the workers are keyed by initCipher, so they would otherwise stay unkeyed
+    if (_cipher != nullptr) {
+        throw "Illegal state";
+    }
+
+    _workers = workers;
+}
+
+size_t Ecb::updateBulk(uint8_t* out, const uint8_t* in, size_t length)
+{
+    if (_buffered != 0 || length % _blocksize != 0) {
+        throw "Illegal length";
+    }
+
+    auto blocks = length / _blocksize;
+    auto threads = (length >= ECB_PARALLEL_THRESHOLD) ? _workers.size() + 1 : 1;
+    auto share = (blocks + threads - 1) / threads;
+
+    // the calling thread takes the first share with the main cipher, and every worker one of the rest
+    std::vector<std::thread> running;
+    for (size_t t = 1; t < threads && t * share < blocks; ++t) {
+        auto offset = t * share * _blocksize;
+        auto count = std::min(share, blocks - t * share);
+
+        running.emplace_back(processBlocks, _workers[t - 1].get(), _mode, out + offset, in + offset, count);
+    }
+
+    processBlocks(_cipher.get(), _mode, out, in, std::min(share, blocks));
+
+    for (auto& thread : running) {
+        thread.join();
+    }
+
+    return length;
+}
+
 void Ecb::initMode(CipherMode mode, const uint8_t* iv, size_t ivLen)
 {
     _mode = mode;
+    _buffered = 0;
 }
 
 size_t Ecb::doFinal(uint8_t* out)
@@ -52,28 +110,44 @@ void Ecb::updateBlock(uint8_t* out, const uint8_t* in)
     }
 }
 
+void Ecb::updateBlocks(uint8_t* out, const uint8_t* in, size_t count)
+{
+    processBlocks(_cipher.get(), _mode, out, in, count);
+}
+
+void Ecb::processBlocks(BlockCipher* cipher, CipherMode mode, uint8_t* out, const uint8_t* in, size_t count)
+{
+    // the direction is resolved once, and the cipher strides over the blocks with its multi-block kernel
+    if (mode == CipherMode::ENCRYPT) {
+        cipher->encryptBlocks(out, in, count);
+
+    } else {
+        cipher->decryptBlocks(out, in, count);
+    }
+}
+
 size_t Ecb::DoFinalWithPadding(uint8_t* out)
 {
-    std::vector<uint8_t> padded(_blocksize);
-    auto pdata = padded.data();
+    uint8_t padded[MAX_BLOCKSIZE];
 
     if (_mode == CipherMode::ENCRYPT) {
-        _padding->Pad(pdata, _buffer.data(), _buffer.size());
-        _cipher->encryptBlock(out, pdata);
+        _padding->Pad(padded, _buffer, _buffered);
+        _cipher->encryptBlock(out, padded);
+        return _blocksize;
 
     } else {
-        if (_buffer.size() != _blocksize) {
+        if (_buffered != _blocksize) {
             throw "Illegal length";
         }
         
-        _cipher->decryptBlock(pdata, _buffer.data());
-        _padding->UnPad(out, pdata);
+        _cipher->decryptBlock(padded, _buffer);
+        return _padding->UnPad(out, padded);
     }
 }
 
 size_t Ecb::DoFinalWithoutPadding(uint8_t* out)
 {
-    auto residue = _buffer.size();
+    auto residue = _buffered;
     if (residue == 0) {
         return 0;
 
@@ -81,6 +155,6 @@ size_t Ecb::DoFinalWithoutPadding(uint8_t* out)
         throw "Illegal length";
     }
 
-    updateBlock(out, _buffer.data());
+    updateBlock(out, _buffer);
     return _blocksize;
 }
\ No newline at end of file
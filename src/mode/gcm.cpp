@@ -0,0 +1,500 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "../../include/mode/gcm.h"
+#include "../../include/util/arrays.h"
+
+#include <algorithm>
+
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
+
+// reduction constants of the 4-bit table method, R = 0xe1 || 0^120 shifted by the dropped nibble
+static const uint64_t LAST4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+static inline uint64_t load_be64(const uint8_t* in)
+{
+    uint64_t value = 0;
+    for (auto i = 0; i < 8; ++i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+static inline void store_be64(uint8_t* out, uint64_t value)
+{
+    for (auto i = 7; i >= 0; --i) {
+        out[i] = static_cast<uint8_t>(value);
+        value >>= 8;
+    }
+}
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i bswap128(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// accumulates the unreduced 256-bit product a * b into lo, mid and hi
+__attribute__((target("pclmul,ssse3")))
+static inline void clmul_accumulate(__m128i a, __m128i b, __m128i& lo, __m128i& mid, __m128i& hi)
+{
+    lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+    hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x10));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x01));
+}
+
+// reduces the byte-reflected 256-bit product modulo x^128 + x^7 + x^2 + x + 1
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i clmul_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    // the product of bit-reflected operands is one bit short, so shift [hi:lo] left by 1
+    __m128i carryLo = _mm_srli_epi32(lo, 31);
+    __m128i carryHi = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+
+    __m128i carry = _mm_srli_si128(carryLo, 12);
+    carryHi = _mm_slli_si128(carryHi, 4);
+    carryLo = _mm_slli_si128(carryLo, 4);
+    lo = _mm_or_si128(lo, carryLo);
+    hi = _mm_or_si128(hi, carryHi);
+    hi = _mm_or_si128(hi, carry);
+
+    __m128i t0 = _mm_slli_epi32(lo, 31);
+    __m128i t1 = _mm_slli_epi32(lo, 30);
+    __m128i t2 = _mm_slli_epi32(lo, 25);
+    t0 = _mm_xor_si128(t0, t1);
+    t0 = _mm_xor_si128(t0, t2);
+    t1 = _mm_srli_si128(t0, 4);
+    t0 = _mm_slli_si128(t0, 12);
+    lo = _mm_xor_si128(lo, t0);
+
+    t2 = _mm_srli_epi32(lo, 1);
+    t0 = _mm_srli_epi32(lo, 2);
+    t2 = _mm_xor_si128(t2, t0);
+    t0 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, t0);
+    t2 = _mm_xor_si128(t2, t1);
+    lo = _mm_xor_si128(lo, t2);
+
+    return _mm_xor_si128(hi, lo);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static void clmul_init_powers(uint8_t* powers, const uint8_t* h, size_t count)
+{
+    auto zero = _mm_setzero_si128();
+    auto hr = bswap128(_mm_loadu_si128((const __m128i*) h));
+    auto power = hr;
+
+    _mm_storeu_si128((__m128i*) powers, power);
+    for (auto i = 1; i < count; ++i) {
+        auto lo = zero, mid = zero, hi = zero;
+        clmul_accumulate(power, hr, lo, mid, hi);
+        power = clmul_reduce(lo, mid, hi);
+        _mm_storeu_si128((__m128i*) (powers + 16 * i), power);
+    }
+}
+
+// up to eight blocks share a single reduction, Y = (Y ^ X1)H^n ^ X2H^(n-1) ^ ... ^ XnH
+__attribute__((target("pclmul,ssse3")))
+static void clmul_ghash(uint8_t* state, const uint8_t* powers, size_t maxBlocks, const uint8_t* data, size_t count)
+{
+    auto zero = _mm_setzero_si128();
+    auto y = bswap128(_mm_loadu_si128((const __m128i*) state));
+
+    while (count > 0) {
+        auto blocks = std::min(count, maxBlocks);
+        auto lo = zero, mid = zero, hi = zero;
+
+        for (auto i = 0; i < blocks; ++i) {
+            auto x = bswap128(_mm_loadu_si128((const __m128i*) (data + 16 * i)));
+            if (i == 0) {
+                x = _mm_xor_si128(x, y);
+            }
+
+            auto h = _mm_loadu_si128((const __m128i*) (powers + 16 * (blocks - 1 - i)));
+            clmul_accumulate(x, h, lo, mid, hi);
+        }
+        y = clmul_reduce(lo, mid, hi);
+
+        data += 16 * blocks;
+        count -= blocks;
+    }
+
+    _mm_storeu_si128((__m128i*) state, bswap128(y));
+}
+
+GCM::GCM(bool useClmul)
+{
+    _clmul = useClmul && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+const std::string GCM::name() const
+{
+    return "GCM/" + _cipher->name();
+}
+
+void GCM::initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen)
+{
+    BufferedBlockCipher::initCipher(cipher, mk, keylen);
+
+    if (_blocksize != GCM_BLOCKSIZE) {
+        throw "Illegal blocksize";
+    }
+
+    // H = E(K, 0^128)
+    block_t h = {0};
+    _cipher->encryptBlock(h.data(), h.data());
+    initTables(h);
+}
+
+void GCM::initMode(CipherMode mode, const uint8_t* iv, size_t ivLen, size_t taglen)
+{
+    // SP 800-38D allows tags of 4 and 8 bytes, for restricted uses, and of 12 to 16 bytes
+    if (ivLen == 0 || (taglen != 4 && taglen != 8 && (taglen < 12 || taglen > GCM_BLOCKSIZE))) {
+        throw "Illegal length";
+    }
+
+    _mode = mode;
+    _taglen = taglen;
+    _buffered = 0;
+
+    _ghash.fill(0);
+    _aadPartialLen = 0;
+    _aadlen = 0;
+    _msglen = 0;
+    _blocks = 0;
+
+    if (ivLen == 12) {
+        // J0 = IV || 0^31 || 1
+        std::copy(iv, iv + ivLen, _j0.begin());
+        _j0[12] = 0;
+        _j0[13] = 0;
+        _j0[14] = 0;
+        _j0[15] = 1;
+
+    } else {
+        // J0 = GHASH(IV || 0^s || 0^64 || [len(IV)]64)
+        block_t block = {0};
+        auto count = ivLen / GCM_BLOCKSIZE;
+        auto residue = ivLen % GCM_BLOCKSIZE;
+
+        ghash(iv, count);
+        if (residue > 0) {
+            std::copy(iv + count * GCM_BLOCKSIZE, iv + ivLen, block.begin());
+            ghash(block.data(), 1);
+        }
+
+        block.fill(0);
+        store_be64(block.data() + 8, static_cast<uint64_t>(ivLen) << 3);
+        ghash(block.data(), 1);
+
+        _j0 = _ghash;
+        _ghash.fill(0);
+    }
+
+    _counter = _j0;
+}
+
+void GCM::updateAAD(const uint8_t* aad, size_t aadlen)
+{
+    // AAD is hashed ahead of the message, so none may follow it
+    if (_msglen > 0 || _buffered > 0) {
+        throw "Illegal state";
+    }
+
+    _aadlen += aadlen;
+
+    // a partial block is kept so that AAD may be given in several pieces
+    if (_aadPartialLen > 0) {
+        auto gap = std::min(GCM_BLOCKSIZE - _aadPartialLen, aadlen);
+        std::copy(aad, aad + gap, _aadPartial.begin() + _aadPartialLen);
+        _aadPartialLen += gap;
+        aad += gap;
+        aadlen -= gap;
+
+        if (_aadPartialLen < GCM_BLOCKSIZE) {
+            return;
+        }
+
+        ghash(_aadPartial.data(), 1);
+        _aadPartialLen = 0;
+    }
+
+    auto count = aadlen / GCM_BLOCKSIZE;
+    ghash(aad, count);
+
+    aad += count * GCM_BLOCKSIZE;
+    aadlen -= count * GCM_BLOCKSIZE;
+
+    std::copy(aad, aad + aadlen, _aadPartial.begin());
+    _aadPartialLen = aadlen;
+}
+
+void GCM::updateBlock(uint8_t* out, const uint8_t* in)
+{
+    updateBlocks(out, in, 1);
+}
+
+void GCM::updateBlocks(uint8_t* out, const uint8_t* in, size_t count)
+{
+    uint8_t keystream[GCM_PARALLEL_BLOCKS * GCM_BLOCKSIZE];
+
+    // rejected before any block is written
+    if (count > GCM_MAX_BLOCKS - _blocks) {
+        throw "Illegal length";
+    }
+
+    flushAAD();
+
+    // each batch of counters is encrypted and hashed while it is still in cache
+    while (count > 0) {
+        auto blocks = std::min(count, GCM_PARALLEL_BLOCKS);
+        auto length = blocks * GCM_BLOCKSIZE;
+
+        increaseCounter(keystream, blocks);
+        _cipher->encryptBlocks(keystream, keystream, blocks);
+
+        // GHASH is taken over the ciphertext, before out overwrites in when in-place
+        if (_mode == CipherMode::DECRYPT) {
+            ghash(in, blocks);
+        }
+
+        bitwise_xor128(out, in, keystream, length);
+
+        if (_mode == CipherMode::ENCRYPT) {
+            ghash(out, blocks);
+        }
+
+        _msglen += length;
+        out += length;
+        in += length;
+        count -= blocks;
+    }
+}
+
+size_t GCM::doFinal(uint8_t* out)
+{
+    if (_mode == CipherMode::DECRYPT) {
+        size_t outlen = 0;
+        if (verifyFinal(out, outlen) == false) {
+            throw "Invalid tag";
+        }
+
+        return outlen;
+    }
+
+    auto outlen = finalBlock(out, _buffered);
+
+    block_t tag;
+    generateTag(tag.data());
+    std::copy(tag.begin(), tag.begin() + _taglen, out + outlen);
+
+    return outlen + _taglen;
+}
+
+bool GCM::verifyFinal(uint8_t* out, size_t& outlen)
+{
+    if (_buffered < _taglen) {
+        outlen = 0;
+        return false;
+    }
+
+    auto residue = _buffered - _taglen;
+    block_t expected;
+    block_t tag;
+    std::copy(_buffer + residue, _buffer + _buffered, expected.begin());
+
+    _buffered = residue;
+    outlen = finalBlock(out, residue);
+    generateTag(tag.data());
+
+    return constant_time_equals(tag.data(), expected.data(), _taglen);
+}
+
+void GCM::initTables(const block_t& h)
+{
+    // HL[i], HH[i] = i * H for the 4-bit nibble i, in GCM bit order
+    uint64_t vh = load_be64(h.data());
+    uint64_t vl = load_be64(h.data() + 8);
+
+    _tableHigh.fill(0);
+    _tableLow.fill(0);
+    _tableHigh[8] = vh;
+    _tableLow[8] = vl;
+
+    for (auto i = 4; i > 0; i >>= 1) {
+        uint64_t reduce = (vl & 1) * 0xe1000000;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ (reduce << 32);
+        _tableHigh[i] = vh;
+        _tableLow[i] = vl;
+    }
+
+    for (auto i = 2; i <= 8; i <<= 1) {
+        for (auto j = 1; j < i; ++j) {
+            _tableHigh[i + j] = _tableHigh[i] ^ _tableHigh[j];
+            _tableLow[i + j] = _tableLow[i] ^ _tableLow[j];
+        }
+    }
+
+    if (_clmul) {
+        clmul_init_powers(_powers[0].data(), h.data(), GCM_PARALLEL_BLOCKS);
+    }
+}
+
+void GCM::ghash(const uint8_t* data, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    if (_clmul) {
+        clmul_ghash(_ghash.data(), _powers[0].data(), GCM_PARALLEL_BLOCKS, data, count);
+    } else {
+        ghashPortable(data, count);
+    }
+}
+
+void GCM::ghashPortable(const uint8_t* data, size_t count)
+{
+    block_t x;
+
+    for (auto n = 0; n < count; ++n) {
+        bitwise_xor(x.data(), _ghash.data(), data + n * GCM_BLOCKSIZE, GCM_BLOCKSIZE);
+
+        // Y = X * H, processed from the last nibble to the first
+        auto lo = x[15] & 0x0f;
+        uint64_t zh = _tableHigh[lo];
+        uint64_t zl = _tableLow[lo];
+
+        for (auto i = 15; i >= 0; --i) {
+            lo = x[i] & 0x0f;
+            auto hi = x[i] >> 4;
+
+            if (i != 15) {
+                auto rem = zl & 0x0f;
+                zl = (zh << 60) | (zl >> 4);
+                zh = (zh >> 4) ^ (LAST4[rem] << 48);
+                zh ^= _tableHigh[lo];
+                zl ^= _tableLow[lo];
+            }
+
+            auto rem = zl & 0x0f;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (LAST4[rem] << 48);
+            zh ^= _tableHigh[hi];
+            zl ^= _tableLow[hi];
+        }
+
+        store_be64(_ghash.data(), zh);
+        store_be64(_ghash.data() + 8, zl);
+    }
+}
+
+void GCM::flushAAD()
+{
+    if (_aadPartialLen > 0) {
+        std::fill(_aadPartial.begin() + _aadPartialLen, _aadPartial.end(), 0);
+        ghash(_aadPartial.data(), 1);
+        _aadPartialLen = 0;
+    }
+}
+
+void GCM::increaseCounter(uint8_t* out, size_t count)
+{
+    if (count > GCM_MAX_BLOCKS - _blocks) {
+        throw "Illegal length";
+    }
+    _blocks += count;
+
+    // inc32 only touches the rightmost 32 bits of the counter block
+    for (auto i = 0; i < count; ++i) {
+        for (auto j = GCM_BLOCKSIZE - 1; j >= GCM_BLOCKSIZE - 4; --j) {
+            if (++_counter[j] != 0) {
+                break;
+            }
+        }
+
+        std::copy(_counter.begin(), _counter.end(), out + i * GCM_BLOCKSIZE);
+    }
+}
+
+size_t GCM::finalBlock(uint8_t* out, size_t residue)
+{
+    flushAAD();
+
+    if (residue == 0) {
+        return 0;
+    }
+
+    block_t block = {0};
+    block_t keystream;
+    std::copy(_buffer, _buffer + residue, block.begin());
+
+    increaseCounter(keystream.data(), 1);
+    _cipher->encryptBlock(keystream.data(), keystream.data());
+
+    if (_mode == CipherMode::DECRYPT) {
+        ghash(block.data(), 1);
+    }
+
+    bitwise_xor(out, block.data(), keystream.data(), residue);
+
+    if (_mode == CipherMode::ENCRYPT) {
+        std::copy(out, out + residue, block.begin());
+        ghash(block.data(), 1);
+    }
+
+    _msglen += residue;
+
+    return residue;
+}
+
+void GCM::generateTag(uint8_t* out)
+{
+    flushAAD();
+
+    // S = GHASH(A || C || [len(A)]64 || [len(C)]64), T = E(K, J0) ^ S
+    block_t lengths;
+    store_be64(lengths.data(), _aadlen << 3);
+    store_be64(lengths.data() + 8, _msglen << 3);
+    ghash(lengths.data(), 1);
+
+    _cipher->encryptBlock(out, _j0.data());
+    bitwise_xor(out, _ghash.data(), GCM_BLOCKSIZE);
+}
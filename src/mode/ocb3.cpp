@@ -26,16 +26,21 @@
 #include "../../include/util/hex.h"
 #include "../../include/util/arrays.h"
 
-#include <cmath>
 #include <algorithm>
 #include <functional>
 
 using namespace mockup::crypto::mode;
 using namespace mockup::crypto::util;
 
-static size_t ntz(size_t i)
+static constexpr size_t OCB_PARALLEL_BLOCKS = 8;
+static constexpr size_t OCB_MAX_BLOCKSIZE = 32;
+
+// enough L_i for 2^32 blocks per message, so that offsets never have to allocate
+static constexpr size_t OCB_PRECOMPUTED_L = 32;
+
+static inline size_t ntz(size_t i)
 {
-    return std::log2(i & -i);
+    return __builtin_ctzll(i);
 }
 
 const std::string OCB3::name() const
@@ -61,24 +66,16 @@ void OCB3::initBlocksize(size_t blocksize)
     }
 }
         
-void OCB3::initMode(CipherMode mode, const uint8_t* iv, size_t ivLen, size_t taglen = 0)
+void OCB3::initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen)
 {
+    BufferedBlockCipher::initCipher(cipher, mk, keylen);
     initBlocksize(_blocksize);
 
-    _mode = mode;
-    _taglen = taglen;
-
-    _deltaAAD.assign(_blocksize, 0);
-    _checksum.assign(_blocksize, 0);
-
-    _buffer.assign(_blocksize, 0);
+    // init L
+    block_t zero(_blocksize, 0);
     _lstar.assign(_blocksize, 0);
     _ldollar.assign(_blocksize, 0);
-    _auth.assign(_blocksize, 0);
-
-    // init L
-    _cipher->encryptBlock(_lstar.data(), _buffer.data());
-    _buffer.clear();
+    _cipher->encryptBlock(_lstar.data(), zero.data());
 
     times2(_ldollar, _lstar);
     block_t l0(_blocksize);
@@ -86,108 +83,424 @@ void OCB3::initMode(CipherMode mode, const uint8_t* iv, size_t ivLen, size_t tag
 
     _L.clear();
     _L.push_back(l0);
+    while (_L.size() < OCB_PRECOMPUTED_L) {
+        block_t doubled(_blocksize);
+        times2(doubled, _L.back());
+        _L.push_back(doubled);
+    }
+
+    // per message state is sized once per key, so initMode reuses it without allocating
+    _delta.assign(_blocksize, 0);
+    _deltaAAD.assign(_blocksize, 0);
+    _checksum.assign(_blocksize, 0);
+    _auth.assign(_blocksize, 0);
+    _aadPartial.assign(_blocksize, 0);
+    _stretch.assign(3 * _blocksize, 0);
+
+    // ktop depends on the key, so the cached one is no longer valid
+    _ktopNonce.assign(_blocksize, 0);
+    _ktopValid = false;
+}
+
+void OCB3::initMode(CipherMode mode, const uint8_t* iv, size_t ivLen, size_t taglen = 0)
+{
+    if (taglen == 0 || taglen > _blocksize || ivLen == 0 || ivLen >= _blocksize) {
+        throw "Illegal length";
+    }
+
+    _mode = mode;
+    _taglen = taglen;
+
+    std::fill(_deltaAAD.begin(), _deltaAAD.end(), 0);
+    std::fill(_checksum.begin(), _checksum.end(), 0);
+    std::fill(_auth.begin(), _auth.end(), 0);
+    _aadPartialLen = 0;
+    _buffered = 0;
+
+    _index = 0;
+    _indexAAD = 0;
 
-    // nonce = 0...01||iv
-    block_t nonce(_blocksize - ivLen - 1, 0x00);
-    nonce.push_back(0x01);
-    nonce.insert(nonce.end(), iv, iv + ivLen);
+    uint8_t top[OCB_MAX_BLOCKSIZE];
+    auto bottom = formatNonce(top, iv, ivLen, _taglen);
+
+    // nonces differing only in bottom share ktop, so reuse the cached stretch
+    if (!_ktopValid || !std::equal(top, top + _blocksize, _ktopNonce.begin())) {
+        std::copy(top, top + _blocksize, _ktopNonce.begin());
+        _ktopValid = true;
+        initStretch(top);
+    }
+
+    stretchOffset(_delta.data(), _stretch.data(), bottom);
+}
+
+size_t OCB3::formatNonce(uint8_t* top, const uint8_t* iv, size_t ivLen, size_t taglen) const
+{
+    // nonce = taglen mod 128||0...01||iv
+    uint8_t nonce[OCB_MAX_BLOCKSIZE] = {0};
+    nonce[_blocksize - ivLen - 1] = 0x01;
+    std::copy(iv, iv + ivLen, nonce + _blocksize - ivLen);
+    nonce[0] |= static_cast<uint8_t>(((taglen << 3) & 0x7f) << 1);
 
     // top = nonce ^ (1...1 || 0...0)
-    block_t top(nonce);
+    std::copy(nonce, nonce + _blocksize, top);
     top[_blocksize - 2] &= (_mask[0] ^ 0xff);
     top[_blocksize - 1] &= (_mask[1] ^ 0xff);
 
-    _cipher->encryptBlock(top.data(), top.data());
+    // bottom is the bit offset of the initial delta in the stretch
+    return ((nonce[_blocksize - 2] & _mask[0]) << 8) | (nonce[_blocksize-1] & _mask[1]);
+}
 
-    size_t bottom = ((nonce[_blocksize - 2] & _mask[0]) << 8) | (nonce[_blocksize-1] & _mask[1]);
-    size_t bytes = bottom >> 3;
-    size_t bits = bottom & 0x7;
+void OCB3::initStretch(const uint8_t* top)
+{
+    uint8_t ktop[2 * OCB_MAX_BLOCKSIZE] = {0};
+    _cipher->encryptBlock(ktop, top);
+
+    stretchKtop(_stretch.data(), ktop);
+}
 
-    // stretch = ktop || (ktop ^ (ktop << shift))
+void OCB3::stretchKtop(uint8_t* stretch, const uint8_t* ktop) const
+{
+    // stretch = ktop || (ktop ^ (ktop << shift)) || 0...0, where ktop is zero padded to two blocks
 
     size_t shift_bytes = _shift >> 3;
     size_t shift_bits = _shift & 0b0111;
 
-    //std::cout << shift_bytes << " and " << shift_bits << std::endl;
-
-    block_t stretch(top);
-    top.insert(top.end(), _blocksize, 0x00);
+    std::copy(ktop, ktop + _blocksize, stretch);
     for (auto i = 0; i < _blocksize; ++i) {
-        auto shifted = (top[i + shift_bytes] << shift_bits) | (top[i + shift_bytes + 1] >> (8 - shift_bits));
-        stretch.push_back(top[i] ^ shifted);
+        auto shifted = (ktop[i + shift_bytes] << shift_bits) | (ktop[i + shift_bytes + 1] >> (8 - shift_bits));
+        stretch[_blocksize + i] = ktop[i] ^ shifted;
     }
-    stretch.insert(stretch.end(), _blocksize, 0x00);
+    std::fill(stretch + 2 * _blocksize, stretch + 3 * _blocksize, 0);
+}
+
+void OCB3::stretchOffset(uint8_t* delta, const uint8_t* stretch, size_t bottom) const
+{
+    size_t bytes = bottom >> 3;
+    size_t bits = bottom & 0x7;
 
-    _delta.assign(_blocksize, 0x00);
     for (auto i = 0; i < _blocksize; ++i) {
-        _delta[i] = (stretch[bytes + i] << bits) | (stretch[bytes + i + 1] >> (8-bits));
+        delta[i] = (stretch[bytes + i] << bits) | (stretch[bytes + i + 1] >> (8-bits));
     }
 }
 
 void OCB3::updateAAD(const uint8_t* aad, size_t aadlen)
 {
-    while (aadlen >= _blocksize) {
-        updateAADBlock(aad);
+    // a partial block is kept so that AAD may be given in several pieces
+    if (_aadPartialLen > 0) {
+        auto gap = std::min(_blocksize - _aadPartialLen, aadlen);
+        std::copy(aad, aad + gap, _aadPartial.begin() + _aadPartialLen);
+        _aadPartialLen += gap;
+        aad += gap;
+        aadlen -= gap;
+
+        if (_aadPartialLen < _blocksize) {
+            return;
+        }
+
+        updateAADBlocks(_aadPartial.data(), 1);
+        _aadPartialLen = 0;
+    }
 
-        aad += _blocksize;
-        aadlen -= _blocksize;
+    if (aadlen >= _blocksize) {
+        auto count = aadlen / _blocksize;
+        updateAADBlocks(aad, count);
+
+        aad += count * _blocksize;
+        aadlen -= count * _blocksize;
     }
 
-    if (aadlen > 0) {        
-        block_t buffer(aad, aad + aadlen);
-        buffer.insert(buffer.end(), _blocksize - buffer.size(), 0);
-        buffer[aadlen] = 0x80;
+    std::copy(aad, aad + aadlen, _aadPartial.begin());
+    _aadPartialLen = aadlen;
+}
+
+void OCB3::flushAAD()
+{
+    if (_aadPartialLen > 0) {
+        uint8_t buffer[OCB_MAX_BLOCKSIZE] = {0};
+        std::copy(_aadPartial.begin(), _aadPartial.begin() + _aadPartialLen, buffer);
+        buffer[_aadPartialLen] = 0x80;
 
         bitwise_xor(_deltaAAD.data(), _lstar.data(), _blocksize);
-        bitwise_xor(buffer.data(), _deltaAAD.data(), _blocksize);
-        _cipher->encryptBlock(buffer.data(), buffer.data());        
-        bitwise_xor(_auth.data(), buffer.data(), _blocksize);
-    }
+        bitwise_xor(buffer, _deltaAAD.data(), _blocksize);
+        _cipher->encryptBlock(buffer, buffer);        
+        bitwise_xor(_auth.data(), buffer, _blocksize);
 
-    _index = 0;
+        _aadPartialLen = 0;
+    }
 }
 
 void OCB3::updateBlock(uint8_t* out, const uint8_t* in)
 {
-    block_t buffer(_blocksize);
-    
-    increaseDelta(_delta);
+    updateBlocks(out, in, 1);
+}
 
-    bitwise_xor(buffer.data(), in, _delta.data(), _blocksize);
-    
-    _cipher->encryptBlock(buffer.data(), buffer.data());
-    bitwise_xor(out, buffer.data(), _delta.data(), _blocksize);
+void OCB3::updateBlocks(uint8_t* out, const uint8_t* in, size_t count)
+{
+    uint8_t offsets[OCB_PARALLEL_BLOCKS * OCB_MAX_BLOCKSIZE];
+    uint8_t buffer[OCB_PARALLEL_BLOCKS * OCB_MAX_BLOCKSIZE];
 
-    bitwise_xor(_checksum.data(), _checksum.data(), in, _blocksize);
+    while (count > 0) {
+        auto blocks = std::min(count, OCB_PARALLEL_BLOCKS);
+        auto length = blocks * _blocksize;
+
+        for (auto i = 0; i < blocks; ++i) {
+            increaseDelta(_delta.data(), _index);
+            std::copy(_delta.begin(), _delta.end(), offsets + i * _blocksize);
+        }
+
+        bitwise_xor128(buffer, in, offsets, length);
+
+        // checksum is taken over the plaintext, before out overwrites in when in-place
+        if (_mode == CipherMode::ENCRYPT) {
+            for (auto i = 0; i < blocks; ++i) {
+                bitwise_xor128(_checksum.data(), in + i * _blocksize, _blocksize);
+            }
+
+            _cipher->encryptBlocks(buffer, buffer, blocks);
+            bitwise_xor128(out, buffer, offsets, length);
+
+        } else {
+            _cipher->decryptBlocks(buffer, buffer, blocks);
+            bitwise_xor128(out, buffer, offsets, length);
+
+            for (auto i = 0; i < blocks; ++i) {
+                bitwise_xor128(_checksum.data(), out + i * _blocksize, _blocksize);
+            }
+        }
+
+        out += length;
+        in += length;
+        count -= blocks;
+    }
 }
 
-size_t OCB3::doFinal(uint8_t* out)
+void OCB3::sealMany(uint8_t* const* outs, size_t* outlens, const uint8_t* const* nonces, size_t nonceLen, 
+    const uint8_t* const* aads, const size_t* aadlens, const uint8_t* const* msgs, const size_t* msglens, size_t count, size_t taglen)
 {
-    auto outlen = 0;
-    auto offset = _buffer.size();
-    
-    if (offset > 0) 
-    {   
-        _buffer.insert(_buffer.end(), _blocksize - offset, 0);
+    if (taglen == 0 || taglen > _blocksize || nonceLen == 0 || nonceLen >= _blocksize) {
+        throw "Illegal length";
+    }
 
-        block_t pad(_blocksize);
-        bitwise_xor(_delta.data(), _lstar.data(), _blocksize);
-        _cipher->encryptBlock(pad.data(), _delta.data());
-        bitwise_xor(out, pad.data(), _buffer.data(), offset);
+    struct Lane {
+        uint8_t delta[OCB_MAX_BLOCKSIZE];
+        uint8_t deltaAAD[OCB_MAX_BLOCKSIZE];
+        uint8_t checksum[OCB_MAX_BLOCKSIZE];
+        uint8_t auth[OCB_MAX_BLOCKSIZE];
+        size_t index;
+        size_t indexAAD;
+        size_t aadBlocks;
+        size_t blocks;
+    };
+
+    Lane lanes[OCB_PARALLEL_BLOCKS];
+    size_t bottoms[OCB_PARALLEL_BLOCKS];
+    size_t active[OCB_PARALLEL_BLOCKS];
+    uint8_t tops[OCB_PARALLEL_BLOCKS * OCB_MAX_BLOCKSIZE];
+    uint8_t batch[OCB_PARALLEL_BLOCKS * OCB_MAX_BLOCKSIZE];
+
+    for (size_t first = 0; first < count; first += OCB_PARALLEL_BLOCKS) {
+        auto streams = std::min(count - first, OCB_PARALLEL_BLOCKS);
+        size_t maxBlocks = 0;
+        size_t misses = 0;
+
+        // nonces sharing the cached ktop take their offset from the cached stretch,
+        // and the ktop of every other nonce goes through a single cipher call
+        for (size_t n = 0; n < streams; ++n) {
+            auto top = tops + n * _blocksize;
+            bottoms[n] = formatNonce(top, nonces[first + n], nonceLen, taglen);
+
+            if (_ktopValid && std::equal(top, top + _blocksize, _ktopNonce.begin())) {
+                stretchOffset(lanes[n].delta, _stretch.data(), bottoms[n]);
+            } else {
+                std::copy(top, top + _blocksize, batch + misses * _blocksize);
+                active[misses++] = n;
+            }
+        }
+
+        _cipher->encryptBlocks(batch, batch, misses);
+
+        for (size_t m = 0; m < misses; ++m) {
+            auto n = active[m];
+            auto top = tops + n * _blocksize;
+
+            uint8_t ktop[2 * OCB_MAX_BLOCKSIZE] = {0};
+            std::copy(batch + m * _blocksize, batch + (m + 1) * _blocksize, ktop);
+            stretchKtop(_stretch.data(), ktop);
+            stretchOffset(lanes[n].delta, _stretch.data(), bottoms[n]);
+
+            std::copy(top, top + _blocksize, _ktopNonce.begin());
+            _ktopValid = true;
+        }
+
+        for (size_t n = 0; n < streams; ++n) {
+            auto& lane = lanes[n];
+            auto i = first + n;
+
+            std::fill(lane.deltaAAD, lane.deltaAAD + _blocksize, 0);
+            std::fill(lane.checksum, lane.checksum + _blocksize, 0);
+            std::fill(lane.auth, lane.auth + _blocksize, 0);
+            lane.index = 0;
+            lane.indexAAD = 0;
+
+            // every AAD and message block, partial ones included, costs one cipher call
+            lane.aadBlocks = (aadlens[i] + _blocksize - 1) / _blocksize;
+            lane.blocks = lane.aadBlocks + (msglens[i] + _blocksize - 1) / _blocksize;
+            maxBlocks = std::max(maxBlocks, lane.blocks);
+
+            outlens[i] = msglens[i] + taglen;
+        }
+
+        // block j of every lane still running goes through a single cipher call, AAD blocks first
+        for (size_t j = 0; j < maxBlocks; ++j) {
+            size_t blocks = 0;
+
+            for (size_t n = 0; n < streams; ++n) {
+                auto& lane = lanes[n];
+                auto i = first + n;
+                auto block = batch + blocks * _blocksize;
+
+                if (j >= lane.blocks) {
+                    continue;
+                }
+
+                if (j < lane.aadBlocks) {
+                    auto offset = j * _blocksize;
+                    auto remaining = aadlens[i] - offset;
+
+                    if (remaining >= _blocksize) {
+                        increaseDelta(lane.deltaAAD, lane.indexAAD);
+                        bitwise_xor128(block, aads[i] + offset, lane.deltaAAD, _blocksize);
+                    } else {
+                        std::fill(block, block + _blocksize, 0);
+                        std::copy(aads[i] + offset, aads[i] + aadlens[i], block);
+                        block[remaining] = 0x80;
+
+                        bitwise_xor128(lane.deltaAAD, _lstar.data(), _blocksize);
+                        bitwise_xor128(block, lane.deltaAAD, _blocksize);
+                    }
+
+                } else {
+                    auto offset = (j - lane.aadBlocks) * _blocksize;
+                    auto remaining = msglens[i] - offset;
+
+                    // checksum is taken over the plaintext, before the output may overwrite it
+                    if (remaining >= _blocksize) {
+                        increaseDelta(lane.delta, lane.index);
+                        bitwise_xor128(lane.checksum, msgs[i] + offset, _blocksize);
+                        bitwise_xor128(block, msgs[i] + offset, lane.delta, _blocksize);
+                    } else {
+                        uint8_t padded[OCB_MAX_BLOCKSIZE] = {0};
+                        std::copy(msgs[i] + offset, msgs[i] + msglens[i], padded);
+                        padded[remaining] = 0x80;
+                        bitwise_xor128(lane.checksum, padded, _blocksize);
+
+                        bitwise_xor128(lane.delta, _lstar.data(), _blocksize);
+                        std::copy(lane.delta, lane.delta + _blocksize, block);
+                    }
+                }
+
+                active[blocks++] = n;
+            }
+
+            _cipher->encryptBlocks(batch, batch, blocks);
+
+            for (size_t b = 0; b < blocks; ++b) {
+                auto& lane = lanes[active[b]];
+                auto i = first + active[b];
+                auto block = batch + b * _blocksize;
+
+                if (j < lane.aadBlocks) {
+                    bitwise_xor128(lane.auth, block, _blocksize);
+                    continue;
+                }
+
+                auto offset = (j - lane.aadBlocks) * _blocksize;
+                auto remaining = msglens[i] - offset;
+
+                if (remaining >= _blocksize) {
+                    bitwise_xor128(outs[i] + offset, block, lane.delta, _blocksize);
+                } else {
+                    bitwise_xor(outs[i] + offset, block, msgs[i] + offset, remaining);
+                }
+            }
+        }
+
+        // tag = E(checksum ^ delta ^ L$) ^ auth, again one cipher call for every lane
+        for (size_t n = 0; n < streams; ++n) {
+            auto& lane = lanes[n];
+
+            bitwise_xor128(lane.delta, _ldollar.data(), _blocksize);
+            bitwise_xor128(batch + n * _blocksize, lane.checksum, lane.delta, _blocksize);
+        }
+
+        _cipher->encryptBlocks(batch, batch, streams);
+
+        for (size_t n = 0; n < streams; ++n) {
+            auto i = first + n;
+            bitwise_xor(outs[i] + msglens[i], batch + n * _blocksize, lanes[n].auth, taglen);
+        }
+    }
+}
 
-        // final checksum
-        _buffer[offset] = 0x80;
-        bitwise_xor(_checksum.data(), _buffer.data(), _blocksize);
+size_t OCB3::doFinal(uint8_t* out)
+{
+    if (_mode == CipherMode::DECRYPT) {
+        size_t outlen = 0;
+        if (verifyFinal(out, outlen) == false) {
+            throw "Invalid tag";
+        }
 
-        out += offset;
-        outlen += offset;
+        return outlen;
     }
 
-    outlen += generateTag(out);
+    auto outlen = finalBlock(out, _buffered);
+    outlen += generateTag(out + outlen);
 
     return outlen;
 }
 
+bool OCB3::verifyFinal(uint8_t* out, size_t& outlen)
+{
+    if (_buffered < _taglen) {
+        outlen = 0;
+        return false;
+    }
+
+    auto residue = _buffered - _taglen;
+    uint8_t expected[OCB_MAX_BLOCKSIZE];
+    uint8_t tag[OCB_MAX_BLOCKSIZE];
+    std::copy(_buffer + residue, _buffer + _buffered, expected);
+
+    _buffered = residue;
+    outlen = finalBlock(out, residue);
+    generateTag(tag);
+
+    return constant_time_equals(tag, expected, _taglen);
+}
+
+size_t OCB3::finalBlock(uint8_t* out, size_t residue)
+{
+    if (residue == 0) {
+        return 0;
+    }
+
+    std::fill(_buffer + residue, _buffer + _blocksize, 0);
+
+    uint8_t pad[OCB_MAX_BLOCKSIZE];
+    bitwise_xor(_delta.data(), _lstar.data(), _blocksize);
+    _cipher->encryptBlock(pad, _delta.data());
+    bitwise_xor(out, pad, _buffer, residue);
+
+    // final checksum is taken over the plaintext
+    if (_mode == CipherMode::DECRYPT) {
+        std::copy(out, out + residue, _buffer);
+    }
+    _buffer[residue] = 0x80;
+    bitwise_xor(_checksum.data(), _buffer, _blocksize);
+
+    return residue;
+}
+
 void OCB3::times2(block_t& dst, const block_t& src)
 {
     for (auto i = 0; i < _blocksize - 1; ++i) 
@@ -203,38 +516,55 @@ void OCB3::times2(block_t& dst, const block_t& src)
     }
 }
 
-void OCB3::updateAADBlock(const uint8_t* block)
+void OCB3::updateAADBlocks(const uint8_t* aad, size_t count)
 {
-    block_t buffer(_blocksize);
+    uint8_t buffer[OCB_PARALLEL_BLOCKS * OCB_MAX_BLOCKSIZE];
 
-    increaseDelta(_deltaAAD);
-    bitwise_xor(buffer.data(), block, _delta.data(), _blocksize);
-    _cipher->encryptBlock(buffer.data(), buffer.data());
-    bitwise_xor(_auth.data(), buffer.data(), _blocksize);
+    while (count > 0) {
+        auto blocks = std::min(count, OCB_PARALLEL_BLOCKS);
+        auto length = blocks * _blocksize;
+
+        for (auto i = 0; i < blocks; ++i) {
+            increaseDelta(_deltaAAD.data(), _indexAAD);
+            bitwise_xor128(buffer + i * _blocksize, aad + i * _blocksize, _deltaAAD.data(), _blocksize);
+        }
+
+        _cipher->encryptBlocks(buffer, buffer, blocks);
+
+        for (auto i = 0; i < blocks; ++i) {
+            bitwise_xor128(_auth.data(), buffer + i * _blocksize, _blocksize);
+        }
+
+        aad += length;
+        count -= blocks;
+    }
 }
 
-void OCB3::increaseDelta(block_t& delta)
+void OCB3::increaseDelta(uint8_t* delta, size_t& index)
 {
-    _index += 1;
+    index += 1;
+    auto i = ntz(index);
 
-    while (_L.size() < ntz(_index) + 1) {
+    while (_L.size() < i + 1) {
         block_t doubled(_blocksize);
         times2(doubled, *_L.rbegin());
         _L.push_back(doubled);
     }
 
-    bitwise_xor(delta.data(), _L[ntz(_index)].data(), _blocksize);
+    bitwise_xor128(delta, _L[i].data(), _blocksize);
 }
 
 size_t OCB3::generateTag(uint8_t* out)
 {
-    auto tag = block_t(_taglen);
+    flushAAD();
+
+    uint8_t tag[OCB_MAX_BLOCKSIZE];
     
     bitwise_xor(_delta.data(), _ldollar.data(), _blocksize);
-    bitwise_xor(tag.data(), _checksum.data(), _delta.data(), _blocksize);
+    bitwise_xor(tag, _checksum.data(), _delta.data(), _blocksize);
     
-    _cipher->encryptBlock(tag.data(), tag.data());
-    bitwise_xor(out, tag.data(), _auth.data(), _taglen);
+    _cipher->encryptBlock(tag, tag);
+    bitwise_xor(out, tag, _auth.data(), _taglen);
 
     return _taglen;
 }
\ No newline at end of file
@@ -0,0 +1,366 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "../../include/mode/ocb3_stream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace mockup::crypto;
+using namespace mockup::crypto::mode;
+
+// chunk indices are 32 bits in the nonce
+static constexpr uint64_t STREAM_MAX_CHUNKS = 1ull << 32;
+
+// chunks kept in memory per thread when the batch is not given
+static constexpr size_t STREAM_CHUNKS_PER_THREAD = 4;
+
+Ocb3Stream::Ocb3Stream(size_t chunkSize) : _chunkSize(chunkSize)
+{
+    if (chunkSize == 0) {
+        throw "Illegal length";
+    }
+}
+
+const std::string Ocb3Stream::name() const
+{
+    return "STREAM/" + _ocbs[0]->name();
+}
+
+void Ocb3Stream::setWorkers(const std::vector<std::shared_ptr<BlockCipher>>& workers)
+{
+    _workers = workers;
+}
+
+void Ocb3Stream::initCipher(std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, size_t keylen)
+{
+    _ocbs.clear();
+    _ocbs.push_back(std::make_shared<OCB3>());
+    _ocbs[0]->initCipher(cipher, mk, keylen);
+
+    for (auto& worker : _workers) {
+        auto ocb = std::make_shared<OCB3>();
+        ocb->initCipher(worker, mk, keylen);
+        _ocbs.push_back(ocb);
+    }
+}
+
+size_t Ocb3Stream::chunkSize() const
+{
+    return _chunkSize;
+}
+
+size_t Ocb3Stream::sealedChunkSize() const
+{
+    return _chunkSize + TAG_LENGTH;
+}
+
+size_t Ocb3Stream::threads() const
+{
+    return _ocbs.size();
+}
+
+void Ocb3Stream::formatNonce(uint8_t* nonce, const uint8_t* prefix, uint32_t index, bool last) const
+{
+    // nonce = prefix||index||last, with index in big endian
+    std::copy(prefix, prefix + PREFIX_LENGTH, nonce);
+    nonce[PREFIX_LENGTH + 0] = static_cast<uint8_t>(index >> 24);
+    nonce[PREFIX_LENGTH + 1] = static_cast<uint8_t>(index >> 16);
+    nonce[PREFIX_LENGTH + 2] = static_cast<uint8_t>(index >> 8);
+    nonce[PREFIX_LENGTH + 3] = static_cast<uint8_t>(index);
+    nonce[PREFIX_LENGTH + 4] = last ? 0x01 : 0x00;
+}
+
+size_t Ocb3Stream::sealChunk(uint8_t* out, const uint8_t* prefix, uint32_t index, bool last, const uint8_t* in, size_t inlen)
+{
+    if (inlen > _chunkSize) {
+        throw "Illegal length";
+    }
+
+    uint8_t nonce[NONCE_LENGTH];
+    formatNonce(nonce, prefix, index, last);
+
+    return _ocbs[0]->seal(out, nonce, NONCE_LENGTH, nullptr, 0, in, inlen, TAG_LENGTH);
+}
+
+size_t Ocb3Stream::openChunk(uint8_t* out, const uint8_t* prefix, uint32_t index, bool last, const uint8_t* in, size_t inlen)
+{
+    if (inlen > sealedChunkSize()) {
+        throw "Illegal length";
+    }
+
+    uint8_t nonce[NONCE_LENGTH];
+    formatNonce(nonce, prefix, index, last);
+
+    return _ocbs[0]->open(out, nonce, NONCE_LENGTH, nullptr, 0, in, inlen, TAG_LENGTH);
+}
+
+size_t Ocb3Stream::sealChunks(uint8_t* out, const uint8_t* prefix, uint64_t first, const uint8_t* in, size_t inlen, bool final)
+{
+    // only the last chunk of a stream may be partial or empty
+    if (final == false && inlen % _chunkSize != 0) {
+        throw "Illegal length";
+    }
+
+    auto count = std::max((inlen + _chunkSize - 1) / _chunkSize, static_cast<size_t>(final ? 1 : 0));
+    if (first + count > STREAM_MAX_CHUNKS) {
+        throw "Illegal length";
+    }
+
+    forEachChunk(count, [&](OCB3& ocb, size_t k) {
+        auto offset = k * _chunkSize;
+        auto length = std::min(_chunkSize, inlen - offset);
+
+        uint8_t nonce[NONCE_LENGTH];
+        formatNonce(nonce, prefix, first + k, final && k == count - 1);
+        ocb.seal(out + k * sealedChunkSize(), nonce, NONCE_LENGTH, nullptr, 0, in + offset, length, TAG_LENGTH);
+    });
+
+    return inlen + count * TAG_LENGTH;
+}
+
+size_t Ocb3Stream::openChunks(uint8_t* out, const uint8_t* prefix, uint64_t first, const uint8_t* in, size_t inlen, bool final)
+{
+    auto sealed = sealedChunkSize();
+    if (final == false && inlen % sealed != 0) {
+        throw "Illegal length";
+    }
+
+    // a stream ends with its last chunk, which may be empty but is never missing
+    auto count = (inlen + sealed - 1) / sealed;
+    if (final && count == 0) {
+        throw "Invalid tag";
+    }
+
+    if (first + count > STREAM_MAX_CHUNKS) {
+        throw "Illegal length";
+    }
+
+    std::atomic<bool> verified(true);
+    forEachChunk(count, [&](OCB3& ocb, size_t k) {
+        auto offset = k * sealed;
+        auto length = std::min(sealed, inlen - offset);
+
+        uint8_t nonce[NONCE_LENGTH];
+        formatNonce(nonce, prefix, first + k, final && k == count - 1);
+        if (ocb.decryptAndVerify(out + k * _chunkSize, nonce, NONCE_LENGTH, nullptr, 0, in + offset, length, TAG_LENGTH) == false) {
+            verified = false;
+        }
+    });
+
+    auto outlen = (inlen > count * TAG_LENGTH) ? inlen - count * TAG_LENGTH : 0;
+    if (verified == false) {
+        std::fill(out, out + outlen, 0);
+        throw "Invalid tag";
+    }
+
+    return outlen;
+}
+
+void Ocb3Stream::forEachChunk(size_t count, const std::function<void(OCB3&, size_t)>& process)
+{
+    if (count == 0) {
+        return;
+    }
+
+    auto threads = std::min(_ocbs.size(), count);
+    auto share = (count + threads - 1) / threads;
+
+    auto run = [&](size_t t) {
+        for (auto k = t * share; k < std::min((t + 1) * share, count); ++k) {
+            process(*_ocbs[t], k);
+        }
+    };
+
+    // the calling thread takes the first share, and every worker one of the rest
+    std::vector<std::thread> running;
+    for (size_t t = 1; t < threads && t * share < count; ++t) {
+        running.emplace_back(run, t);
+    }
+
+    run(0);
+
+    for (auto& thread : running) {
+        thread.join();
+    }
+}
+
+Ocb3StreamWriter::Ocb3StreamWriter(Ocb3Stream& stream, const uint8_t* prefix, std::ostream& os, size_t batchChunks)
+    : _stream(stream), _os(os), _buffered(0), _index(0), _finished(false)
+{
+    if (batchChunks == 0) {
+        batchChunks = STREAM_CHUNKS_PER_THREAD * stream.threads();
+    }
+
+    std::copy(prefix, prefix + Ocb3Stream::PREFIX_LENGTH, _prefix);
+    _plain.resize(batchChunks * stream.chunkSize());
+    _sealed.resize(batchChunks * stream.sealedChunkSize());
+}
+
+void Ocb3StreamWriter::write(const uint8_t* data, size_t length)
+{
+    if (_finished) {
+        throw "Stream is finished";
+    }
+
+    while (length > 0) {
+        // a full batch is sealed only when more data follows, since its last chunk could be the last of the stream
+        if (_buffered == _plain.size()) {
+            flush(false);
+        }
+
+        auto chunk = std::min(length, _plain.size() - _buffered);
+        std::copy(data, data + chunk, _plain.begin() + _buffered);
+
+        _buffered += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+void Ocb3StreamWriter::finish()
+{
+    if (_finished == false) {
+        flush(true);
+        _finished = true;
+    }
+}
+
+void Ocb3StreamWriter::flush(bool final)
+{
+    auto chunkSize = _stream.chunkSize();
+    auto chunks = std::max((_buffered + chunkSize - 1) / chunkSize, static_cast<size_t>(final ? 1 : 0));
+
+    auto sealedLen = _stream.sealChunks(_sealed.data(), _prefix, _index, _plain.data(), _buffered, final);
+    _os.write(reinterpret_cast<const char*>(_sealed.data()), sealedLen);
+
+    _index += chunks;
+    _buffered = 0;
+}
+
+Ocb3StreamReader::Ocb3StreamReader(Ocb3Stream& stream, const uint8_t* prefix, std::istream& is, size_t batchChunks)
+    : _stream(stream), _is(is), _offset(0), _available(0), _index(0), _finished(false)
+{
+    if (batchChunks == 0) {
+        batchChunks = STREAM_CHUNKS_PER_THREAD * stream.threads();
+    }
+
+    std::copy(prefix, prefix + Ocb3Stream::PREFIX_LENGTH, _prefix);
+    _plain.resize(batchChunks * stream.chunkSize());
+    _sealed.resize(batchChunks * stream.sealedChunkSize());
+}
+
+size_t Ocb3StreamReader::read(uint8_t* out, size_t length)
+{
+    size_t outlen = 0;
+
+    while (outlen < length) {
+        if (_offset == _available) {
+            if (_finished) {
+                break;
+            }
+
+            fill();
+            continue;
+        }
+
+        auto chunk = std::min(length - outlen, _available - _offset);
+        std::copy(_plain.begin() + _offset, _plain.begin() + _offset + chunk, out + outlen);
+
+        _offset += chunk;
+        outlen += chunk;
+    }
+
+    return outlen;
+}
+
+void Ocb3StreamReader::seek(uint64_t offset)
+{
+    auto chunkSize = _stream.chunkSize();
+    auto index = offset / chunkSize;
+    auto skip = static_cast<size_t>(offset % chunkSize);
+
+    // the end of a chunk is reached through that chunk, so that seeking to the end still checks the last flag
+    if (skip == 0 && index > 0) {
+        index -= 1;
+        skip = chunkSize;
+    }
+
+    _is.clear();
+    _is.seekg(index * _stream.sealedChunkSize());
+    _index = index;
+    _finished = false;
+
+    fill();
+
+    if (skip > _available) {
+        throw "Illegal length";
+    }
+    _offset = skip;
+}
+
+size_t Ocb3StreamReader::readChunk(uint32_t index, uint8_t* out)
+{
+    _is.clear();
+    auto position = _is.tellg();
+    _is.seekg(static_cast<uint64_t>(index) * _stream.sealedChunkSize());
+
+    bool last = false;
+    auto sealedLen = readSealed(_sealed.data(), _stream.sealedChunkSize(), last);
+    if (sealedLen == 0) {
+        throw "Invalid tag";
+    }
+
+    auto outlen = _stream.openChunk(out, _prefix, index, last, _sealed.data(), sealedLen);
+
+    _is.clear();
+    _is.seekg(position);
+
+    return outlen;
+}
+
+void Ocb3StreamReader::fill()
+{
+    bool final = false;
+    auto sealedLen = readSealed(_sealed.data(), _sealed.size(), final);
+    auto sealedChunkSize = _stream.sealedChunkSize();
+
+    _available = _stream.openChunks(_plain.data(), _prefix, _index, _sealed.data(), sealedLen, final);
+    _index += (sealedLen + sealedChunkSize - 1) / sealedChunkSize;
+    _offset = 0;
+    _finished = final;
+}
+
+size_t Ocb3StreamReader::readSealed(uint8_t* sealed, size_t length, bool& final)
+{
+    _is.read(reinterpret_cast<char*>(sealed), length);
+    auto sealedLen = static_cast<size_t>(_is.gcount());
+
+    // the last chunk is the one followed by the end of the stream
+    final = (sealedLen < length) || (_is.peek() == std::istream::traits_type::eof());
+    _is.clear();
+
+    return sealedLen;
+}
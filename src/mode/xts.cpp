@@ -0,0 +1,206 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "../../include/mode/xts.h"
+#include "../../include/util/arrays.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
+
+static constexpr size_t XTS_BLOCKSIZE = 16;
+static constexpr size_t XTS_PARALLEL_BLOCKS = 8;
+
+// T = T * alpha in GF(2^128), on the little-endian 64-bit halves of the tweak
+static inline void times_alpha(uint64_t* tweak)
+{
+    uint64_t carry = tweak[1] >> 63;
+    tweak[1] = (tweak[1] << 1) | (tweak[0] >> 63);
+    tweak[0] = (tweak[0] << 1) ^ (carry * 0x87);
+}
+
+const std::string XTS::name() const
+{
+    return "XTS/" + _cipher->name();
+}
+
+void XTS::initCipher(std::shared_ptr<BlockCipher> cipher, std::shared_ptr<BlockCipher> tweakCipher, const uint8_t* mk, size_t keylen)
+{
+    if (cipher == tweakCipher) {
+        throw "Illegal cipher";
+    }
+
+    _cipher = cipher;
+    _tweakCipher = tweakCipher;
+
+    if (_cipher->blocksize() != XTS_BLOCKSIZE || _tweakCipher->blocksize() != XTS_BLOCKSIZE || keylen % 2 != 0) {
+        throw "Illegal length";
+    }
+
+    _cipher->init(mk, keylen / 2);
+    _tweakCipher->init(mk + keylen / 2, keylen / 2);
+}
+
+void XTS::encryptSector(uint8_t* out, const uint8_t* in, size_t length, uint64_t sector)
+{
+    processSectors(out, in, length, 1, sector, true);
+}
+
+void XTS::decryptSector(uint8_t* out, const uint8_t* in, size_t length, uint64_t sector)
+{
+    processSectors(out, in, length, 1, sector, false);
+}
+
+void XTS::encryptSectors(uint8_t* out, const uint8_t* in, size_t sectorSize, size_t count, uint64_t firstSector)
+{
+    processSectors(out, in, sectorSize, count, firstSector, true);
+}
+
+void XTS::decryptSectors(uint8_t* out, const uint8_t* in, size_t sectorSize, size_t count, uint64_t firstSector)
+{
+    processSectors(out, in, sectorSize, count, firstSector, false);
+}
+
+void XTS::processSectors(uint8_t* out, const uint8_t* in, size_t sectorSize, size_t count, uint64_t firstSector, bool encrypt)
+{
+    if (sectorSize < XTS_BLOCKSIZE) {
+        throw "Illegal length";
+    }
+
+    uint8_t tweaks[XTS_PARALLEL_BLOCKS * XTS_BLOCKSIZE];
+
+    while (count > 0) {
+        auto sectors = std::min(count, XTS_PARALLEL_BLOCKS);
+
+        // the tweaks of several sectors are encrypted in a single call
+        std::fill(tweaks, tweaks + sectors * XTS_BLOCKSIZE, 0);
+        for (auto i = 0; i < sectors; ++i) {
+            auto sector = firstSector + i;
+            for (auto j = 0; j < 8; ++j) {
+                tweaks[i * XTS_BLOCKSIZE + j] = static_cast<uint8_t>(sector >> (8 * j));
+            }
+        }
+        _tweakCipher->encryptBlocks(tweaks, tweaks, sectors);
+
+        for (auto i = 0; i < sectors; ++i) {
+            processSector(out, in, sectorSize, tweaks + i * XTS_BLOCKSIZE, encrypt);
+            out += sectorSize;
+            in += sectorSize;
+        }
+
+        firstSector += sectors;
+        count -= sectors;
+    }
+}
+
+void XTS::processSector(uint8_t* out, const uint8_t* in, size_t length, const uint8_t* tweak, bool encrypt)
+{
+    uint64_t t[2];
+    std::memcpy(t, tweak, XTS_BLOCKSIZE);
+
+    auto blocks = length / XTS_BLOCKSIZE;
+    auto residue = length % XTS_BLOCKSIZE;
+
+    // with ciphertext stealing, the last whole block is processed together with the partial one
+    auto bulk = (residue > 0) ? blocks - 1 : blocks;
+    processBlocks(out, in, bulk, t, encrypt);
+
+    if (residue == 0) {
+        return;
+    }
+
+    out += bulk * XTS_BLOCKSIZE;
+    in += bulk * XTS_BLOCKSIZE;
+
+    uint64_t last[2] = {t[0], t[1]};
+    uint64_t next[2] = {t[0], t[1]};
+    times_alpha(next);
+
+    // decryption takes the two tweaks in the reverse order
+    auto first = encrypt ? last : next;
+    auto second = encrypt ? next : last;
+
+    uint8_t block[XTS_BLOCKSIZE];
+    uint8_t partial[XTS_BLOCKSIZE];
+    std::copy(in + XTS_BLOCKSIZE, in + XTS_BLOCKSIZE + residue, partial);
+
+    processBlock(block, in, first, encrypt);
+
+    std::copy(block, block + residue, out + XTS_BLOCKSIZE);
+    std::copy(partial, partial + residue, block);
+
+    processBlock(out, block, second, encrypt);
+}
+
+void XTS::processBlocks(uint8_t* out, const uint8_t* in, size_t count, uint64_t* tweak, bool encrypt)
+{
+    uint64_t tweaks[XTS_PARALLEL_BLOCKS * 2];
+    uint8_t buffer[XTS_PARALLEL_BLOCKS * XTS_BLOCKSIZE];
+
+    while (count > 0) {
+        auto blocks = std::min(count, XTS_PARALLEL_BLOCKS);
+        auto length = blocks * XTS_BLOCKSIZE;
+
+        // tweaks for the whole batch are doubled ahead, so the cipher sees eight independent blocks
+        for (auto i = 0; i < blocks; ++i) {
+            tweaks[2 * i] = tweak[0];
+            tweaks[2 * i + 1] = tweak[1];
+            times_alpha(tweak);
+        }
+
+        auto masks = reinterpret_cast<const uint8_t*>(tweaks);
+        bitwise_xor128(buffer, in, masks, length);
+
+        if (encrypt) {
+            _cipher->encryptBlocks(buffer, buffer, blocks);
+        } else {
+            _cipher->decryptBlocks(buffer, buffer, blocks);
+        }
+
+        bitwise_xor128(out, buffer, masks, length);
+
+        out += length;
+        in += length;
+        count -= blocks;
+    }
+}
+
+void XTS::processBlock(uint8_t* out, const uint8_t* in, const uint64_t* tweak, bool encrypt)
+{
+    uint8_t buffer[XTS_BLOCKSIZE];
+    auto mask = reinterpret_cast<const uint8_t*>(tweak);
+
+    bitwise_xor128(buffer, in, mask, XTS_BLOCKSIZE);
+
+    if (encrypt) {
+        _cipher->encryptBlock(buffer, buffer);
+    } else {
+        _cipher->decryptBlock(buffer, buffer);
+    }
+
+    bitwise_xor128(out, buffer, mask, XTS_BLOCKSIZE);
+}
@@ -41,6 +41,10 @@ void Pkcs7Padding::Pad(uint8_t* dst, const uint8_t* src, size_t srclen)
 size_t Pkcs7Padding::UnPad(uint8_t* dst, const uint8_t* src)
 {
     auto pad = src[_blocksize - 1];
+    if (pad == 0 || pad > _blocksize) {
+        throw "Invalid padding";
+    }
+
     size_t length = _blocksize - pad;
 
     for (auto i = length; i < _blocksize; ++i) {
@@ -31,18 +31,6 @@
 using namespace mockup::crypto;
 using namespace mockup::crypto::mac;
 
-static std::vector<uint8_t> i2bs(uint32_t i)
-{
-    std::vector<uint8_t> bs;
-
-    bs.push_back(i >> 24);
-    bs.push_back(i >> 16);    
-    bs.push_back(i >> 8);
-    bs.push_back(i);
-
-    return bs;
-}
-
 Pbkdf2::Pbkdf2(std::shared_ptr<Hash> hash)
 {
     hmac = std::make_shared<Hmac>(hash);
@@ -57,18 +45,27 @@ std::vector<uint8_t> Pbkdf2::derive(const std::vector<uint8_t>& password, const
 {
     std::vector<uint8_t> derived;
 
+    // the iterations run in place on these, so no digest is allocated per iteration
+    std::vector<uint8_t> chunk(hmac->outputsize());
+    std::vector<uint8_t> block(hmac->outputsize());
+
+    // the mac stays keyed across messages, so the password pads are hashed only once
+    hmac->init(password);
+
     uint32_t idx = 1;
     while (outsize > 0) {
-        hmac->init(password);
+        uint8_t index[4] = {
+            static_cast<uint8_t>(idx >> 24), static_cast<uint8_t>(idx >> 16), static_cast<uint8_t>(idx >> 8), static_cast<uint8_t>(idx)
+        };
+
         hmac->update(salt);
-        hmac->update(i2bs(idx));
-        auto chunk = hmac->doFinal();
-        auto block = std::vector<uint8_t>(chunk);
+        hmac->update(index, sizeof(index));
+        hmac->doFinal(chunk.data());
+        std::copy(chunk.begin(), chunk.end(), block.begin());
 
         for (auto i = 1; i < iterations; ++i) {
-            hmac->init(password);
             hmac->update(chunk);
-            chunk = hmac->doFinal();
+            hmac->doFinal(chunk.data());
 
             std::transform(chunk.begin(), chunk.end(), block.begin(), block.begin(), std::bit_xor<uint8_t>());
         }
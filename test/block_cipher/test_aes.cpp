@@ -25,6 +25,12 @@
 #include "../../include/block_cipher/aes.h"
 #include "test_tool.h"
 #include "test_ocb.h"
+#include "test_gcm.h"
+#include "test_cbc.h"
+#include "test_xts.h"
+#include "test_ecb.h"
+#include "test_ctr.h"
+#include "test_stream.h"
 
 #include <cstdio>
 #include <algorithm>
@@ -137,9 +143,17 @@ int main(int argc, const char** argv)
     test_256();
 
     aes_ocb_test();
+    verify_ocb(std::make_shared<Aes>());
+    verify_gcm(std::make_shared<Aes>());
+    verify_cbc(std::make_shared<Aes>());
+    verify_ctr(std::make_shared<Aes>());
+    verify_ecb(std::make_shared<Aes>(), {std::make_shared<Aes>(), std::make_shared<Aes>(), std::make_shared<Aes>()});
+    verify_xts(std::make_shared<Aes>(), std::make_shared<Aes>());
+    verify_ocb_stream(std::make_shared<Aes>(), {std::make_shared<Aes>(), std::make_shared<Aes>()});
     
     benchmark_ocb(std::make_shared<Aes>(), 16, 4096, 0, 16);
     benchmark_ocb(std::make_shared<Aes>(), 16, 4096, 4096, 16);
+    benchmark_gcm(std::make_shared<Aes>(), 16, 4096, 0);
 
     return 0;
 }
\ No newline at end of file
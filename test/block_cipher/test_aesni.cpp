@@ -25,6 +25,13 @@
 #include "../../include/block_cipher/aesni.h"
 #include "test_tool.h"
 #include "test_ocb.h"
+#include "test_gcm.h"
+#include "test_cbc.h"
+#include "test_xts.h"
+#include "test_ecb.h"
+#include "test_ctr.h"
+#include "test_stream.h"
+#include "test_multi_buffer.h"
 
 #include <cstdio>
 #include <algorithm>
@@ -147,13 +154,26 @@ int main(int argc, const char** argv)
     test_256();
 
     aes_ocb_test();
+    verify_ocb(std::make_shared<AesNI>());
+    verify_gcm(std::make_shared<AesNI>());
+    verify_cbc(std::make_shared<AesNI>());
+    verify_ctr(std::make_shared<AesNI>());
+    verify_ecb(std::make_shared<AesNI>(), {std::make_shared<AesNI>(), std::make_shared<AesNI>(), std::make_shared<AesNI>()});
+    verify_xts(std::make_shared<AesNI>(), std::make_shared<AesNI>());
+    verify_ocb_stream(std::make_shared<AesNI>(), {std::make_shared<AesNI>(), std::make_shared<AesNI>()});
+    verify_aesni_multi_buffer();
 
     benchmark_ocb(std::make_shared<AesNI>(), 16, 4096, 0, 16);
     benchmark_ocb(std::make_shared<AesNI>(), 16, 4096, 4096, 16);
+    benchmark_ocb_batch(std::make_shared<AesNI>(), 16, 64, 8);
+    benchmark_ocb_batch(std::make_shared<AesNI>(), 16, 256, 8);
+    benchmark_gcm(std::make_shared<AesNI>(), 16, 4096, 0);
 
     benchmark();
 
     benchmark_ctr(std::make_shared<AesNI>(), 16, 4096);
+    benchmark_aesni_multi_buffer(64, 1000, 100);
+    benchmark_aesni_multi_buffer(256, 1000, 100);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,295 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "test_cbc.h"
+#include "../../include/util/byte_array.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
+
+struct cbc_sample_t {
+    std::string key;
+    std::string ct;
+};
+
+struct cbc_long_sample_t {
+    size_t keysize;
+    size_t msglen;
+    std::string last;
+};
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+// feeds msg in pieces, each encrypted in place in its own packet buffer with room for the lagging output
+static std::vector<uint8_t> update_in_place(std::shared_ptr<BufferedBlockCipher> cipher, const std::vector<uint8_t>& msg, const std::vector<size_t>& pieces)
+{
+    std::vector<uint8_t> result;
+    size_t offset = 0;
+
+    for (auto piece : pieces) {
+        piece = std::min(piece, msg.size() - offset);
+
+        std::vector<uint8_t> packet(piece + 64);
+        std::copy(msg.begin() + offset, msg.begin() + offset + piece, packet.begin());
+        auto outlen = cipher->update(packet.data(), packet.data(), piece);
+
+        result.insert(result.end(), packet.begin(), packet.begin() + outlen);
+        offset += piece;
+    }
+
+    std::vector<uint8_t> packet(msg.size() - offset + 64);
+    std::copy(msg.begin() + offset, msg.end(), packet.begin());
+    auto outlen = cipher->doFinal(std::span<uint8_t>(packet), std::span<const uint8_t>(packet.data(), msg.size() - offset));
+    result.insert(result.end(), packet.begin(), packet.begin() + outlen);
+
+    return result;
+}
+
+static void verify_cbc_samples(std::shared_ptr<BlockCipher> cipher)
+{
+    // NIST SP 800-38A F.2.1, F.2.3 and F.2.5, followed by the PKCS#7 block
+    std::vector<cbc_sample_t> samples = {
+        { "2B7E151628AED2A6ABF7158809CF4F3C",
+          "7649ABAC8119B246CEE98E9B12E9197D5086CB9B507219EE95DB113A917678B273BED6B8E3C1743B7116E69E222295163FF1CAA1681FAC09120ECA307586E1A7"},
+        { "8E73B0F7DA0E6452C810F32B809079E562F8EAD2522C6B7B",
+          "4F021DB243BC633D7178183A9FA071E8B4D9ADA9AD7DEDF4E5E738763F69145A571B242012FB7AE07FA9BAAC3DF102E008B0E27988598881D920A9E64F5615CD"},
+        { "603DEB1015CA71BE2B73AEF0857D77811F352C073B6108D72D9810A30914DFF4",
+          "F58C4C04D6E5F1BA779EABFB5F7BFBD69CFC4E967EDB808D679F777BC6702C7D39F23369A9D9BACFA530E26304231461B2EB05E2C39BE9FCDA6C19078C6A9D1B"},
+    };
+
+    auto iv = toByteArray("000102030405060708090A0B0C0D0E0F");
+    auto pt = toByteArray("6BC1BEE22E409F96E93D7E117393172AAE2D8A571E03AC9C9EB76FAC45AF8E5130C81C46A35CE411E5FBC1191A0A52EFF69F2445DF4F9B17AD2B417BE66C3710");
+
+    std::shared_ptr<BufferedBlockCipher> cbc = std::make_shared<CBC>();
+
+    size_t countPassed = 0;
+    size_t countDecrypted = 0;
+    for (auto& sample : samples) {
+        auto key = toByteArray(sample.key);
+        auto ct = toByteArray(sample.ct);
+        uint8_t out[64 + 16] = {0};
+        uint8_t dec[64 + 16] = {0};
+
+        cbc->initCipher(cipher, key.data(), key.size());
+        cbc->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv.data(), iv.size());
+        auto outlen = cbc->doFinal(out, pt.data(), pt.size());
+
+        if (outlen == ct.size() + 16 && std::equal(ct.begin(), ct.end(), out)) {
+            countPassed += 1;
+        }
+
+        cbc->initMode(BufferedBlockCipher::CipherMode::DECRYPT, iv.data(), iv.size());
+        auto declen = cbc->doFinal(dec, out, outlen);
+
+        if (declen == pt.size() && std::equal(pt.begin(), pt.end(), dec)) {
+            countDecrypted += 1;
+        }
+    }
+
+    print_verify_result(cbc->name() + "_SP800_38A", countPassed, samples.size());
+    print_verify_result(cbc->name() + "_SP800_38A_DECRYPT", countDecrypted, samples.size());
+}
+
+static void verify_cbc_long(std::shared_ptr<BlockCipher> cipher)
+{
+    // K[i] = 7i, IV[i] = F0 + i, P[i] = 5i + 1, last ciphertext blocks computed with OpenSSL
+    std::vector<cbc_long_sample_t> samples = {
+        {16,    0, "E16F77D1BF3E0112A2237FFC17A669F6"},
+        {16,   15, "FC1F5EF3A88D282E714A8BAB4F4C30C1"},
+        {16,   16, "54146B694CAADD910A61649D13ECBE97"},
+        {16,   17, "70C3AE0B199E87F76BCD7315020B6A29"},
+        {24, 1000, "E59F2A104F211B94C197527CE4DA4ED4"},
+        {32, 4096, "DF474E926BDBF53604A7E514A45ABD8F"},
+        {16, 4099, "373B75CD62303D96F2CD7891AFA64B0E"},
+    };
+
+    uint8_t mk[32];
+    uint8_t iv[16];
+    for (auto i = 0; i < 32; ++i) {
+        mk[i] = 7 * i;
+    }
+    for (auto i = 0; i < 16; ++i) {
+        iv[i] = 0xF0 + i;
+    }
+
+    std::shared_ptr<BufferedBlockCipher> cbc = std::make_shared<CBC>();
+
+    size_t countPassed = 0;
+    size_t countDecrypted = 0;
+    size_t countRejected = 0;
+    for (auto& sample : samples) {
+        std::vector<uint8_t> pt(sample.msglen);
+        std::vector<uint8_t> ct(sample.msglen + 16);
+
+        for (auto i = 0; i < pt.size(); ++i) {
+            pt[i] = 5 * i + 1;
+        }
+
+        cbc->initCipher(cipher, mk, sample.keysize);
+        cbc->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 16);
+        auto outlen = cbc->doFinal(ct.data(), pt.data(), pt.size());
+        ct.resize(outlen);
+
+        auto last = toByteArray(sample.last);
+        if (std::equal(last.begin(), last.end(), ct.end() - 16)) {
+            countPassed += 1;
+        }
+
+        // decrypted in place, streamed in uneven pieces to cross the buffered and batched paths
+        auto dec = ct;
+        size_t declen = 0;
+        cbc->initMode(BufferedBlockCipher::CipherMode::DECRYPT, iv, 16);
+        for (size_t offset = 0, piece = 1; offset < dec.size(); offset += piece, piece = piece * 3 + 1) {
+            declen += cbc->update(dec.data() + declen, dec.data() + offset, std::min(piece, dec.size() - offset));
+        }
+        declen += cbc->doFinal(dec.data() + declen);
+
+        if (declen == pt.size() && std::equal(pt.begin(), pt.end(), dec.begin())) {
+            countDecrypted += 1;
+        }
+
+        // flipping the previous block turns the last padding byte into 0, which must fail to unpad
+        uint8_t badIv[16];
+        std::copy(iv, iv + 16, badIv);
+        auto previous = (outlen > 16) ? ct.data() + outlen - 32 : badIv;
+        previous[15] ^= static_cast<uint8_t>(outlen - pt.size());
+
+        try {
+            cbc->initMode(BufferedBlockCipher::CipherMode::DECRYPT, badIv, 16);
+            cbc->doFinal(dec.data(), ct.data(), ct.size());
+        } catch (const char* e) {
+            countRejected += 1;
+        }
+    }
+
+    print_verify_result(cbc->name() + "_LONG", countPassed, samples.size());
+    print_verify_result(cbc->name() + "_LONG_DECRYPT", countDecrypted, samples.size());
+    print_verify_result(cbc->name() + "_LONG_BAD_PADDING", countRejected, samples.size());
+}
+
+static void verify_cbc_many(std::shared_ptr<BlockCipher> cipher)
+{
+    // streams of different lengths must match what each gives on its own
+    const size_t count = 11;
+
+    uint8_t mk[16] = {0};
+    std::vector<std::vector<uint8_t>> msgs(count);
+    std::vector<std::vector<uint8_t>> ivs(count);
+    std::vector<std::vector<uint8_t>> outs(count);
+    std::vector<const uint8_t*> pmsgs(count);
+    std::vector<const uint8_t*> pivs(count);
+    std::vector<uint8_t*> pouts(count);
+    std::vector<size_t> msglens(count);
+    std::vector<size_t> outlens(count);
+
+    for (auto i = 0; i < count; ++i) {
+        msglens[i] = 37 * i * i;
+        msgs[i].resize(msglens[i]);
+        ivs[i].assign(16, static_cast<uint8_t>(i));
+        outs[i].resize(msglens[i] + 16);
+
+        for (auto j = 0; j < msglens[i]; ++j) {
+            msgs[i][j] = i + j;
+        }
+
+        pmsgs[i] = msgs[i].data();
+        pivs[i] = ivs[i].data();
+        pouts[i] = outs[i].data();
+    }
+
+    auto cbc = std::make_shared<CBC>();
+    cbc->initCipher(cipher, mk, 16);
+    cbc->encryptMany(pouts.data(), outlens.data(), pmsgs.data(), msglens.data(), pivs.data(), count);
+
+    std::shared_ptr<BufferedBlockCipher> single = cbc;
+
+    size_t countPassed = 0;
+    for (auto i = 0; i < count; ++i) {
+        std::vector<uint8_t> expected(msglens[i] + 16);
+
+        single->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, pivs[i], 16);
+        auto outlen = single->doFinal(expected.data(), pmsgs[i], msglens[i]);
+
+        if (outlen == outlens[i] && expected == outs[i]) {
+            countPassed += 1;
+        }
+    }
+
+    print_verify_result(cbc->name() + "_MULTI_BUFFER", countPassed, count);
+}
+
+static void verify_cbc_in_place(std::shared_ptr<BlockCipher> cipher)
+{
+    const std::vector<size_t> pieces = {37, 100, 1000, 5, 16, 3, 2048};
+
+    uint8_t mk[16] = {0};
+    uint8_t iv[16] = {0};
+    std::vector<uint8_t> pt(4099);
+    for (auto i = 0; i < pt.size(); ++i) {
+        pt[i] = 5 * i + 1;
+    }
+
+    std::shared_ptr<BufferedBlockCipher> cbc = std::make_shared<CBC>();
+    cbc->initCipher(cipher, mk, 16);
+
+    std::vector<uint8_t> expected(pt.size() + 16);
+    cbc->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 16);
+    expected.resize(cbc->doFinal(expected.data(), pt.data(), pt.size()));
+
+    size_t countPassed = 0;
+
+    // one shot, in place
+    auto buffer = pt;
+    buffer.resize(expected.size());
+    cbc->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 16);
+    auto outlen = cbc->doFinal(buffer.data(), buffer.data(), pt.size());
+    countPassed += (outlen == expected.size() && buffer == expected) ? 1 : 0;
+
+    // split over packets, where the buffered bytes of one packet come out at the head of the next
+    cbc->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 16);
+    countPassed += (update_in_place(cbc, pt, pieces) == expected) ? 1 : 0;
+
+    cbc->initMode(BufferedBlockCipher::CipherMode::DECRYPT, iv, 16);
+    countPassed += (update_in_place(cbc, expected, pieces) == pt) ? 1 : 0;
+
+    print_verify_result(cbc->name() + "_IN_PLACE", countPassed, 3);
+}
+
+void verify_cbc(std::shared_ptr<BlockCipher> cipher)
+{
+    verify_cbc_samples(cipher);
+    verify_cbc_long(cipher);
+    verify_cbc_many(cipher);
+    verify_cbc_in_place(cipher);
+}
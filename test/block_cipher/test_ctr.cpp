@@ -0,0 +1,89 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "test_ctr.h"
+#include "../../include/util/byte_array.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
+
+struct ctr_sample_t {
+    std::string key;
+    std::string ct;
+};
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+// SP800-38A F.5, where the counter carries out of its last byte after the first block
+static const std::string CTR_COUNTER = "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+static const std::string CTR_PLAINTEXT = "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+
+static std::vector<ctr_sample_t> samples = {
+    {"2b7e151628aed2a6abf7158809cf4f3c", "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee"},
+    {"8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b", "1abc932417521ca24f2b0459fe7e6e0b090339ec0aa6faefd5ccc2c6f4ce8e941e36b26bd1ebc670d1bd1d665620abf74f78a7f6d29809585a97daec58c6b050"},
+    {"603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4", "601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c52b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6"},
+};
+
+void verify_ctr(std::shared_ptr<BlockCipher> cipher)
+{
+    auto counter = toByteArray(CTR_COUNTER);
+    auto pt = toByteArray(CTR_PLAINTEXT);
+
+    std::shared_ptr<BufferedBlockCipher> ctr = std::make_shared<CTR>();
+    size_t countPassed = 0;
+    size_t countRange = 0;
+
+    for (auto& sample : samples) {
+        auto mk = toByteArray(sample.key);
+        auto ct = toByteArray(sample.ct);
+        ctr->initCipher(cipher, mk.data(), mk.size());
+
+        // one byte at first, so that the rest goes through the multi-block path from the buffer
+        std::vector<uint8_t> out(pt.size());
+        ctr->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, counter.data(), counter.size());
+        auto outlen = ctr->update(out.data(), pt.data(), 1);
+        outlen += ctr->doFinal(out.data() + outlen, pt.data() + 1, pt.size() - 1);
+        countPassed += (outlen == ct.size() && out == ct) ? 1 : 0;
+
+        // blocks 2 and 3 on their own, with a partial tail
+        auto range = std::dynamic_pointer_cast<CTR>(ctr);
+        std::vector<uint8_t> tail(28);
+        range->initMode(BufferedBlockCipher::CipherMode::DECRYPT, counter.data(), counter.size());
+        range->skipBlocks(2);
+        outlen = ctr->doFinal(tail.data(), ct.data() + 32, tail.size());
+        countRange += (outlen == tail.size() && std::equal(tail.begin(), tail.end(), pt.begin() + 32)) ? 1 : 0;
+    }
+
+    print_verify_result(ctr->name() + "_SP800_38A", countPassed, samples.size());
+    print_verify_result(ctr->name() + "_SP800_38A_RANGE", countRange, samples.size());
+}
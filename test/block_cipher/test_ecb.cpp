@@ -0,0 +1,131 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "test_ecb.h"
+#include "../../include/util/byte_array.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+// SP800-38A F.1.1 and F.1.2
+static void verify_ecb_sp800_38a(std::shared_ptr<BlockCipher> cipher)
+{
+    auto mk = toByteArray("2b7e151628aed2a6abf7158809cf4f3c");
+    auto pt = toByteArray("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    auto ct = toByteArray("3ad77bb40d7a3660a89ecaf32466ef97f5d3d58503b9699de785895a96fdbaaf43b1cd7f598ece23881b00e3ed0306887b0c785e27e8ad3f8223207104725dd4");
+
+    std::shared_ptr<BufferedBlockCipher> ecb = std::make_shared<Ecb>();
+    ecb->initCipher(cipher, mk.data(), mk.size());
+
+    size_t countPassed = 0;
+    std::vector<uint8_t> out(pt.size());
+
+    // one byte short of a block first, so that the rest goes through the multi-block path from the buffer
+    ecb->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, nullptr, 0);
+    auto outlen = ecb->update(out.data(), pt.data(), 15);
+    outlen += ecb->doFinal(out.data() + outlen, pt.data() + 15, pt.size() - 15);
+    countPassed += (outlen == ct.size() && out == ct) ? 1 : 0;
+
+    ecb->initMode(BufferedBlockCipher::CipherMode::DECRYPT, nullptr, 0);
+    outlen = ecb->doFinal(out.data(), ct.data(), ct.size());
+    countPassed += (outlen == pt.size() && out == pt) ? 1 : 0;
+
+    print_verify_result(ecb->name() + "_SP800_38A", countPassed, 2);
+}
+
+static void verify_ecb_bulk(std::shared_ptr<BlockCipher> cipher, const std::vector<std::shared_ptr<BlockCipher>>& workers)
+{
+    uint8_t mk[16] = {0};
+    for (auto i = 0; i < sizeof(mk); ++i) {
+        mk[i] = 17 * i + 5;
+    }
+
+    // a table of tokens large enough to be split over the workers, and a small one that is not
+    std::vector<size_t> lengths = {1 << 20, 4096 + 48};
+
+    auto single = std::make_shared<Ecb>();
+    auto bulk = std::make_shared<Ecb>();
+    bulk->setWorkers(workers);
+
+    single->initCipher(cipher, mk, 16);
+    std::vector<std::vector<uint8_t>> expected;
+    for (auto length : lengths) {
+        std::vector<uint8_t> tokens(length);
+        for (auto i = 0; i < length; ++i) {
+            tokens[i] = 3 * i + (i >> 8);
+        }
+
+        std::vector<uint8_t> out(length);
+        single->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, nullptr, 0);
+        single->update(out.data(), tokens.data(), length);
+        expected.push_back(out);
+    }
+
+    bulk->initCipher(cipher, mk, 16);
+    size_t countPassed = 0;
+    for (auto n = 0; n < lengths.size(); ++n) {
+        auto length = lengths[n];
+        std::vector<uint8_t> tokens(length);
+        for (auto i = 0; i < length; ++i) {
+            tokens[i] = 3 * i + (i >> 8);
+        }
+        auto original = tokens;
+
+        bulk->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, nullptr, 0);
+        auto outlen = bulk->updateBulk(tokens.data(), tokens.data(), length);
+        countPassed += (outlen == length && tokens == expected[n]) ? 1 : 0;
+
+        bulk->initMode(BufferedBlockCipher::CipherMode::DECRYPT, nullptr, 0);
+        outlen = bulk->updateBulk(tokens.data(), tokens.data(), length);
+        countPassed += (outlen == length && tokens == original) ? 1 : 0;
+    }
+
+    print_verify_result(bulk->name() + "_BULK", countPassed, 2 * lengths.size());
+
+    // workers given after the key would never be keyed
+    size_t countThrown = 0;
+    try {
+        bulk->setWorkers(workers);
+    } catch (const char* e) {
+        countThrown += 1;
+    }
+    print_verify_result(bulk->name() + "_WORKERS_AFTER_KEY", countThrown, 1);
+}
+
+void verify_ecb(std::shared_ptr<BlockCipher> cipher, const std::vector<std::shared_ptr<BlockCipher>>& workers)
+{
+    verify_ecb_sp800_38a(cipher);
+    verify_ecb_bulk(cipher, workers);
+}
@@ -0,0 +1,400 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "test_gcm.h"
+#include "../../include/util/byte_array.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
+
+struct gcm_sample_t {
+    std::string key;
+    std::string iv;
+    std::string aad;
+    std::string pt;
+    std::string ct;
+};
+
+struct gcm_long_sample_t {
+    size_t keysize;
+    size_t aadlen;
+    size_t msglen;
+    std::string tag;
+};
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+// feeds msg in pieces, each encrypted in place in its own packet buffer with room for the lagging output
+static std::vector<uint8_t> update_in_place(std::shared_ptr<BufferedBlockCipher> cipher, const std::vector<uint8_t>& msg, const std::vector<size_t>& pieces)
+{
+    std::vector<uint8_t> result;
+    size_t offset = 0;
+
+    for (auto piece : pieces) {
+        piece = std::min(piece, msg.size() - offset);
+
+        std::vector<uint8_t> packet(piece + 64);
+        std::copy(msg.begin() + offset, msg.begin() + offset + piece, packet.begin());
+        auto outlen = cipher->update(packet.data(), packet.data(), piece);
+
+        result.insert(result.end(), packet.begin(), packet.begin() + outlen);
+        offset += piece;
+    }
+
+    std::vector<uint8_t> packet(msg.size() - offset + 64);
+    std::copy(msg.begin() + offset, msg.end(), packet.begin());
+    auto outlen = cipher->doFinal(std::span<uint8_t>(packet), std::span<const uint8_t>(packet.data(), msg.size() - offset));
+    result.insert(result.end(), packet.begin(), packet.begin() + outlen);
+
+    return result;
+}
+
+static size_t gcm_encrypt(std::shared_ptr<BufferedBlockCipherAead> gcm, uint8_t* out, const uint8_t* iv, size_t ivLen, const uint8_t* aad, size_t aadlen, const uint8_t* msg, size_t msglen)
+{
+    gcm->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, ivLen, 16);
+    gcm->updateAAD(aad, aadlen);
+    return gcm->doFinal(out, msg, msglen);
+}
+
+static void verify_gcm_samples(std::shared_ptr<BlockCipher> cipher, bool useClmul)
+{
+    // McGrew & Viega, The Galois/Counter Mode of Operation, test cases 1 - 6, 9 and 15
+    const std::string K = "FEFFE9928665731C6D6A8F9467308308";
+    const std::string P = "D9313225F88406E5A55909C5AFF5269A86A7A9531534F7DA2E4C303D8A318A721C3C0C95956809532FCF0E2449A6B525B16AEDF5AA0DE657BA637B39";
+    const std::string A = "FEEDFACEDEADBEEFFEEDFACEDEADBEEFABADDAD2";
+    const std::string IV = "9313225DF88406E555909C5AFF5269AA6A7A9538534F7DA1E4C303D2A318A728C3C0C95156809539FCF0E2429A6B525416AEDBF5A0DE6A57A637B39B";
+
+    std::vector<gcm_sample_t> samples = {
+        { "00000000000000000000000000000000", "000000000000000000000000", "", "",
+          "58E2FCCEFA7E3061367F1D57A4E7455A"},
+        { "00000000000000000000000000000000", "000000000000000000000000", "", "00000000000000000000000000000000",
+          "0388DACE60B6A392F328C2B971B2FE78AB6E47D42CEC13BDF53A67B21257BDDF"},
+        { K, "CAFEBABEFACEDBADDECAF888", "", P + "1AAFD255",
+          "42831EC2217774244B7221B784D0D49CE3AA212F2C02A4E035C17E2329ACA12E21D514B25466931C7D8F6A5AAC84AA051BA30B396A0AAC973D58E091473F5985"
+          "4D5C2AF327CD64A62CF35ABD2BA6FAB4"},
+        { K, "CAFEBABEFACEDBADDECAF888", A, P,
+          "42831EC2217774244B7221B784D0D49CE3AA212F2C02A4E035C17E2329ACA12E21D514B25466931C7D8F6A5AAC84AA051BA30B396A0AAC973D58E091"
+          "5BC94FBC3221A5DB94FAE95AE7121A47"},
+        { K, "CAFEBABEFACEDBAD", A, P,
+          "61353B4C2806934A777FF51FA22A4755699B2A714FCDC6F83766E5F97B6C742373806900E49F24B22B097544D4896B424989B5E1EBAC0F07C23F4598"
+          "3612D2E79E3B0785561BE14AACA2FCCB"},
+        { K, IV, A, P,
+          "8CE24998625615B603A033ACA13FB894BE9112A5C3A211A8BA262A3CCA7E2CA701E4A9A4FBA43C90CCDCB281D48C7C6FD62875D2ACA417034C34AEE5"
+          "619CC5AEFFFE0BFA462AF43C1699D050"},
+        { K + "FEFFE9928665731C", IV, A, P,
+          "D27E88681CE3243C4830165A8FDCF9FF1DE9A1D8E6B447EF6EF7B79828666E4581E79012AF34DDD9E2F037589B292DB3E67C036745FA22E7E9B7373B"
+          "DCF566FF291C25BBB8568FC3D376A6D9"},
+        { K + K, "CAFEBABEFACEDBADDECAF888", A, P,
+          "522DC1F099567D07F47F37A32A84427D643A8CDCBFE5C0C97598A2BD2555D1AA8CB08E48590DBB3DA7B08B1056828838C5F61E6393BA7A0ABCC9F662"
+          "76FC6ECE0F4E1768CDDF8853BB2D551B"},
+    };
+
+    std::shared_ptr<BufferedBlockCipherAead> gcm = std::make_shared<GCM>(useClmul);
+
+    size_t countPassed = 0;
+    size_t countDecrypted = 0;
+    size_t countSealed = 0;
+    for (auto& sample : samples) {
+        auto key = toByteArray(sample.key);
+        auto iv = toByteArray(sample.iv);
+        auto aad = toByteArray(sample.aad);
+        auto pt = toByteArray(sample.pt);
+        auto ct = toByteArray(sample.ct);
+        std::vector<uint8_t> out(pt.size() + 16);
+        std::vector<uint8_t> dec(pt.size() + 1);
+
+        gcm->initCipher(cipher, key.data(), key.size());
+        auto outlen = gcm_encrypt(gcm, out.data(), iv.data(), iv.size(), aad.data(), aad.size(), pt.data(), pt.size());
+
+        if (outlen == ct.size() && std::equal(ct.begin(), ct.end(), out.begin())) {
+            countPassed += 1;
+        }
+
+        // the one-shot API gives the same record, and open throws on a forged one
+        auto sealedLen = gcm->seal(out.data(), iv.data(), iv.size(), aad.data(), aad.size(), pt.data(), pt.size(), 16);
+        auto openedLen = gcm->open(dec.data(), iv.data(), iv.size(), aad.data(), aad.size(), out.data(), sealedLen, 16);
+        auto sealed = sealedLen == ct.size() && std::equal(ct.begin(), ct.end(), out.begin());
+        auto opened = openedLen == pt.size() && std::equal(pt.begin(), pt.end(), dec.begin());
+
+        try {
+            out[0] ^= 0x01;
+            gcm->open(dec.data(), iv.data(), iv.size(), aad.data(), aad.size(), out.data(), sealedLen, 16);
+            opened = false;
+        } catch (const char* e) {
+        }
+
+        if (sealed && opened) {
+            countSealed += 1;
+        }
+
+        auto verified = gcm->decryptAndVerify(dec.data(), iv.data(), iv.size(), aad.data(), aad.size(), ct.data(), ct.size(), 16);
+
+        // flipping the last tag bit must be rejected
+        ct.back() ^= 0x01;
+        auto forged = gcm->decryptAndVerify(out.data(), iv.data(), iv.size(), aad.data(), aad.size(), ct.data(), ct.size(), 16);
+
+        if (verified && !forged && std::equal(pt.begin(), pt.end(), dec.begin())) {
+            countDecrypted += 1;
+        }
+    }
+
+    auto suffix = useClmul ? "_CLMUL" : "_PORTABLE";
+    print_verify_result(gcm->name() + "_SPEC" + suffix, countPassed, samples.size());
+    print_verify_result(gcm->name() + "_SPEC_DECRYPT" + suffix, countDecrypted, samples.size());
+    print_verify_result(gcm->name() + "_SPEC_SEAL" + suffix, countSealed, samples.size());
+}
+
+static void verify_gcm_long(std::shared_ptr<BlockCipher> cipher, bool useClmul)
+{
+    // K[i] = 7i, IV = 0102...0C, A[i] = 3i, P[i] = 5i + 1, tags computed with OpenSSL
+    std::vector<gcm_long_sample_t> samples = {
+        {16,    0, 4096, "EFD6DEAC1C251C08707368CB9CF0C954"},
+        {16,   77, 4099, "488221B79E38178BEE2EAFB060D1F32D"},
+        {24,  300, 1000, "31BA83BBBFE0D245C567D7C1450D78E2"},
+        {32, 4096, 4096, "114DEEA1BA57700D8CBF5BC8A723A844"},
+        {16,    1,  129, "AB9A7AE12612E1CAC1E10ECEF1210B00"},
+    };
+
+    uint8_t mk[32];
+    uint8_t iv[12];
+    for (auto i = 0; i < 32; ++i) {
+        mk[i] = 7 * i;
+    }
+    for (auto i = 0; i < 12; ++i) {
+        iv[i] = i + 1;
+    }
+
+    std::shared_ptr<BufferedBlockCipherAead> gcm = std::make_shared<GCM>(useClmul);
+
+    size_t countPassed = 0;
+    for (auto& sample : samples) {
+        std::vector<uint8_t> aad(sample.aadlen);
+        std::vector<uint8_t> pt(sample.msglen);
+        std::vector<uint8_t> ct(sample.msglen + 16);
+        std::vector<uint8_t> dec(sample.msglen);
+
+        for (auto i = 0; i < aad.size(); ++i) {
+            aad[i] = 3 * i;
+        }
+        for (auto i = 0; i < pt.size(); ++i) {
+            pt[i] = 5 * i + 1;
+        }
+
+        gcm->initCipher(cipher, mk, sample.keysize);
+
+        // streamed in uneven pieces to cross the buffered and batched paths
+        gcm->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 12, 16);
+        for (size_t offset = 0, piece = 1; offset < aad.size(); offset += piece, piece = piece * 2 + 1) {
+            gcm->updateAAD(aad.data() + offset, std::min(piece, aad.size() - offset));
+        }
+
+        size_t outlen = 0;
+        for (size_t offset = 0, piece = 1; offset < pt.size(); offset += piece, piece = piece * 3 + 1) {
+            outlen += gcm->update(ct.data() + outlen, pt.data() + offset, std::min(piece, pt.size() - offset));
+        }
+        outlen += gcm->doFinal(ct.data() + outlen);
+
+        auto tag = toByteArray(sample.tag);
+        auto verified = gcm->decryptAndVerify(dec.data(), iv, 12, aad.data(), aad.size(), ct.data(), ct.size(), 16);
+
+        if (outlen == ct.size() && std::equal(tag.begin(), tag.end(), ct.end() - 16) && verified && dec == pt) {
+            countPassed += 1;
+        }
+    }
+
+    auto suffix = useClmul ? "_CLMUL" : "_PORTABLE";
+    print_verify_result(gcm->name() + "_LONG" + suffix, countPassed, samples.size());
+}
+
+static void verify_gcm_in_place(std::shared_ptr<BlockCipher> cipher)
+{
+    const std::vector<size_t> pieces = {37, 100, 1000, 5, 16, 3, 2048};
+
+    uint8_t mk[16] = {0};
+    uint8_t iv[12] = {0};
+    std::vector<uint8_t> aad(20, 0xAA);
+    std::vector<uint8_t> pt(4099);
+    for (auto i = 0; i < pt.size(); ++i) {
+        pt[i] = 5 * i + 1;
+    }
+
+    std::shared_ptr<BufferedBlockCipherAead> gcm = std::make_shared<GCM>();
+    gcm->initCipher(cipher, mk, 16);
+
+    std::vector<uint8_t> expected(pt.size() + 16);
+    gcm_encrypt(gcm, expected.data(), iv, 12, aad.data(), aad.size(), pt.data(), pt.size());
+
+    size_t countPassed = 0;
+
+    // one shot, in place
+    auto buffer = pt;
+    buffer.resize(pt.size() + 16);
+    auto outlen = gcm_encrypt(gcm, buffer.data(), iv, 12, aad.data(), aad.size(), buffer.data(), pt.size());
+    countPassed += (outlen == expected.size() && buffer == expected) ? 1 : 0;
+
+    auto verified = gcm->decryptAndVerify(buffer.data(), iv, 12, aad.data(), aad.size(), buffer.data(), buffer.size(), 16);
+    countPassed += (verified && std::equal(pt.begin(), pt.end(), buffer.begin())) ? 1 : 0;
+
+    // split over packets, where the buffered bytes of one packet come out at the head of the next
+    gcm->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 12, 16);
+    gcm->updateAAD(aad.data(), aad.size());
+    countPassed += (update_in_place(gcm, pt, pieces) == expected) ? 1 : 0;
+
+    gcm->initMode(BufferedBlockCipher::CipherMode::DECRYPT, iv, 12, 16);
+    gcm->updateAAD(aad.data(), aad.size());
+    countPassed += (update_in_place(gcm, expected, pieces) == pt) ? 1 : 0;
+
+    print_verify_result(gcm->name() + "_IN_PLACE", countPassed, 4);
+}
+
+// fragments of the given sizes over data, the last one taking the rest
+static std::vector<iovec> split_fragments(uint8_t* data, size_t length, const std::vector<size_t>& sizes)
+{
+    std::vector<iovec> fragments;
+
+    for (auto size : sizes) {
+        size = std::min(size, length);
+        fragments.push_back({data, size});
+        data += size;
+        length -= size;
+    }
+    fragments.push_back({data, length});
+
+    return fragments;
+}
+
+static void verify_gcm_iovec(std::shared_ptr<BlockCipher> cipher)
+{
+    uint8_t mk[16] = {0};
+    uint8_t iv[12] = {0};
+    std::vector<uint8_t> aad(45);
+    std::vector<uint8_t> pt(1000);
+    for (auto i = 0; i < aad.size(); ++i) {
+        aad[i] = 3 * i;
+    }
+    for (auto i = 0; i < pt.size(); ++i) {
+        pt[i] = 5 * i + 1;
+    }
+
+    std::shared_ptr<BufferedBlockCipherAead> gcm = std::make_shared<GCM>();
+    gcm->initCipher(cipher, mk, 16);
+
+    std::vector<uint8_t> expected(pt.size() + 16);
+    gcm_encrypt(gcm, expected.data(), iv, 12, aad.data(), aad.size(), pt.data(), pt.size());
+
+    auto aadFragments = split_fragments(aad.data(), aad.size(), {3, 20, 1, 0, 5});
+    size_t countPassed = 0;
+
+    // gathered from and scattered to fragments that straddle blocks
+    std::vector<uint8_t> ct(pt.size() + 16);
+    auto in = split_fragments(pt.data(), pt.size(), {1, 15, 17, 100, 3, 64});
+    auto out = split_fragments(ct.data(), pt.size(), {7, 33, 16, 500});
+
+    gcm->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 12, 16);
+    gcm->updateAAD(aadFragments.data(), aadFragments.size());
+    auto outlen = gcm->update(in.data(), in.size(), out.data(), out.size());
+    outlen += gcm->doFinal(ct.data() + outlen);
+    countPassed += (outlen == expected.size() && ct == expected) ? 1 : 0;
+
+    // in place over the same fragments
+    auto buffer = expected;
+    auto fragments = split_fragments(buffer.data(), buffer.size(), {1, 15, 17, 100, 3, 64});
+
+    gcm->initMode(BufferedBlockCipher::CipherMode::DECRYPT, iv, 12, 16);
+    gcm->updateAAD(aadFragments.data(), aadFragments.size());
+    outlen = gcm->update(fragments.data(), fragments.size(), fragments.data(), fragments.size());
+    outlen += gcm->doFinal(buffer.data() + outlen);
+    countPassed += (outlen == pt.size() && std::equal(pt.begin(), pt.end(), buffer.begin())) ? 1 : 0;
+
+    print_verify_result(gcm->name() + "_IOVEC", countPassed, 2);
+}
+
+static void verify_gcm_illegal_use(std::shared_ptr<BlockCipher> cipher)
+{
+    uint8_t mk[16] = {0};
+    uint8_t iv[12] = {0};
+    uint8_t aad[16] = {0};
+    uint8_t msg[32] = {0};
+    uint8_t out[32] = {0};
+
+    std::shared_ptr<BufferedBlockCipherAead> gcm = std::make_shared<GCM>();
+    gcm->initCipher(cipher, mk, 16);
+
+    size_t countPassed = 0;
+
+    // AAD after a partial or a whole block of message
+    for (auto msglen : {5, 32}) {
+        gcm->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 12, 16);
+        gcm->updateAAD(aad, sizeof(aad));
+        gcm->update(out, msg, msglen);
+        try {
+            gcm->updateAAD(aad, sizeof(aad));
+        } catch (const char* e) {
+            countPassed += 1;
+        }
+    }
+
+    // one block past 2^32 - 2 is refused before any input is read
+    gcm->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 12, 16);
+    try {
+        gcm->update(out, msg, (size_t{0xffffffff}) * 16);
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+
+    // only the tag lengths of SP 800-38D are taken
+    for (size_t taglen = 0; taglen <= 17; ++taglen) {
+        auto allowed = taglen == 4 || taglen == 8 || (taglen >= 12 && taglen <= 16);
+        try {
+            gcm->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 12, taglen);
+            countPassed += allowed ? 1 : 0;
+        } catch (const char* e) {
+            countPassed += allowed ? 0 : 1;
+        }
+    }
+
+    print_verify_result(gcm->name() + "_ILLEGAL_USE", countPassed, 3 + 18);
+}
+
+void verify_gcm(std::shared_ptr<BlockCipher> cipher)
+{
+    verify_gcm_samples(cipher, true);
+    verify_gcm_samples(cipher, false);
+    verify_gcm_long(cipher, true);
+    verify_gcm_long(cipher, false);
+    verify_gcm_in_place(cipher);
+    verify_gcm_iovec(cipher);
+    verify_gcm_illegal_use(cipher);
+}
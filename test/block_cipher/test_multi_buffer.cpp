@@ -0,0 +1,258 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "test_multi_buffer.h"
+#include "../../include/util/byte_array.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <x86intrin.h>
+
+using namespace mockup::crypto::block_cipher;
+using namespace mockup::crypto::util;
+
+using Job = AesNIMultiBuffer::Job;
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+// one session at a time, one block at a time
+static void ctr_reference(const AesNI& cipher, uint8_t* out, const uint8_t* counter, const uint8_t* in, size_t length)
+{
+    uint8_t ctr[16];
+    uint8_t keystream[16];
+    std::copy(counter, counter + 16, ctr);
+
+    AesNI& aes = const_cast<AesNI&>(cipher);
+    for (size_t offset = 0; offset < length; offset += 16) {
+        aes.encryptBlock(keystream, ctr);
+        for (size_t i = 0; i < 16 && offset + i < length; ++i) {
+            out[offset + i] = in[offset + i] ^ keystream[i];
+        }
+
+        for (auto i = 15; i >= 0 && ++ctr[i] == 0; --i);
+    }
+}
+
+static void verify_sp800_38a()
+{
+    auto mk = toByteArray("2b7e151628aed2a6abf7158809cf4f3c");
+    auto counter = toByteArray("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+    auto pt = toByteArray("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    auto ct = toByteArray("874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee");
+
+    AesNI aes;
+    aes.init(mk.data(), mk.size());
+
+    size_t completed = 0;
+    AesNIMultiBuffer engine([&](const Job& job) { completed += 1; });
+
+    std::vector<uint8_t> out(pt.size());
+    Job job = {&aes, {0}, pt.data(), out.data(), pt.size(), nullptr};
+    std::copy(counter.begin(), counter.end(), job.counter);
+
+    engine.submit(job);
+    engine.flush();
+
+    auto passed = completed == 1 && out == ct;
+    print_verify_result("AES-NI_MULTI_BUFFER_SP800_38A", passed ? 1 : 0, 1);
+}
+
+static void verify_sessions()
+{
+    const size_t count = 37;
+    std::vector<AesNI> ciphers(count);
+    std::vector<std::vector<uint8_t>> msgs(count), outs(count), expected(count);
+    std::vector<Job> jobs(count);
+
+    // keys of every size and lengths from empty to a few blocks, with counters that carry into the high half
+    for (auto i = 0; i < count; ++i) {
+        std::vector<uint8_t> mk(16 + 8 * (i % 3));
+        for (auto j = 0; j < mk.size(); ++j) {
+            mk[j] = 13 * i + j;
+        }
+        ciphers[i].init(mk.data(), mk.size());
+
+        msgs[i].resize((i * 45) % 200);
+        for (auto j = 0; j < msgs[i].size(); ++j) {
+            msgs[i][j] = 7 * j + i;
+        }
+        outs[i].resize(msgs[i].size());
+        expected[i].resize(msgs[i].size());
+
+        jobs[i] = {&ciphers[i], {0}, msgs[i].data(), outs[i].data(), msgs[i].size(), &outs[i]};
+        std::fill(jobs[i].counter, jobs[i].counter + 16, (i % 4 == 0) ? 0xff : i);
+
+        ctr_reference(ciphers[i], expected[i].data(), jobs[i].counter, msgs[i].data(), msgs[i].size());
+    }
+
+    size_t countPassed = 0;
+    size_t completed = 0;
+    AesNIMultiBuffer engine([&](const Job& job) { 
+        auto i = static_cast<std::vector<uint8_t>*>(job.context) - outs.data();
+        completed += 1;
+        countPassed += (outs[i] == expected[i]) ? 1 : 0;
+    }, 1024, std::chrono::hours(1));
+
+    for (auto& job : jobs) {
+        engine.submit(job);
+    }
+    engine.flush();
+    print_verify_result("AES-NI_MULTI_BUFFER_SESSIONS", countPassed, count);
+
+    // in place, flushed by the latency threshold only
+    AesNIMultiBuffer lazy([&](const Job& job) { completed += 1; }, -1, std::chrono::microseconds(0));
+    countPassed = 0;
+    for (auto i = 0; i < count; ++i) {
+        jobs[i].in = jobs[i].out = msgs[i].data();
+        lazy.submit(jobs[i]);
+        lazy.poll();
+        countPassed += (lazy.pending() == 0 && msgs[i] == expected[i]) ? 1 : 0;
+    }
+    print_verify_result("AES-NI_MULTI_BUFFER_LATENCY", countPassed, count);
+}
+
+// callbacks that submit during a flush, one with enough bytes to reach the threshold
+static void verify_reentrant_submit()
+{
+    uint8_t mk[16] = {0};
+    AesNI aes;
+    aes.init(mk, sizeof(mk));
+
+    std::vector<std::vector<uint8_t>> msgs = {
+        std::vector<uint8_t>(1024, 0x11), std::vector<uint8_t>(), std::vector<uint8_t>(1024, 0x22),
+        std::vector<uint8_t>(1024, 0x33), std::vector<uint8_t>(4096, 0x44), std::vector<uint8_t>(4096, 0x55)
+    };
+    std::vector<std::vector<uint8_t>> outs(msgs.size()), expected(msgs.size());
+    std::vector<Job> jobs(msgs.size());
+    for (auto i = 0; i < msgs.size(); ++i) {
+        outs[i].resize(msgs[i].size());
+        expected[i].resize(msgs[i].size());
+        jobs[i] = {&aes, {0}, msgs[i].data(), outs[i].data(), msgs[i].size(), &outs[i]};
+        jobs[i].counter[0] = i;
+        ctr_reference(aes, expected[i].data(), jobs[i].counter, msgs[i].data(), msgs[i].size());
+    }
+
+    size_t countPassed = 0;
+    size_t completed = 0;
+    AesNIMultiBuffer* self = nullptr;
+    AesNIMultiBuffer engine([&](const Job& job) {
+        auto i = static_cast<std::vector<uint8_t>*>(job.context) - outs.data();
+        completed += 1;
+        countPassed += (outs[i] == expected[i]) ? 1 : 0;
+
+        // the empty job and the first 1 KiB one each bring a 4 KiB job
+        if (i == 0 || i == 1) {
+            self->submit(jobs[i == 0 ? 4 : 5]);
+        }
+    }, 4096, std::chrono::hours(1));
+    self = &engine;
+
+    for (auto i = 0; i < 4; ++i) {
+        engine.submit(jobs[i]);
+    }
+    engine.flush();
+    auto deferred = engine.pending() == 2 && completed == 4;
+
+    engine.flush();
+    auto passed = deferred && engine.pending() == 0 && completed == msgs.size() && countPassed == msgs.size();
+    print_verify_result("AES-NI_MULTI_BUFFER_REENTRANT", passed ? 1 : 0, 1);
+}
+
+// ciphers with no key or an unsupported key size are refused instead of being dropped by the flush
+static void verify_illegal_cipher()
+{
+    uint8_t mk[20] = {0};
+    uint8_t msg[16] = {0};
+    AesNI unkeyed;
+    AesNI odd;
+    odd.init(mk, sizeof(mk));
+
+    size_t countPassed = 0;
+    AesNIMultiBuffer engine([](const Job& job) {});
+    for (auto cipher : {&unkeyed, &odd}) {
+        Job job = {cipher, {0}, msg, msg, sizeof(msg), nullptr};
+        try {
+            engine.submit(job);
+        } catch (const char* e) {
+            countPassed += 1;
+        }
+    }
+
+    countPassed += (engine.pending() == 0) ? 1 : 0;
+    print_verify_result("AES-NI_MULTI_BUFFER_ILLEGAL_CIPHER", countPassed, 3);
+}
+
+void verify_aesni_multi_buffer()
+{
+    verify_sp800_38a();
+    verify_sessions();
+    verify_reentrant_submit();
+    verify_illegal_cipher();
+}
+
+void benchmark_aesni_multi_buffer(size_t msglen, size_t sessions, size_t iterations)
+{
+    std::vector<AesNI> ciphers(sessions);
+    std::vector<uint8_t> data(msglen * sessions);
+    std::vector<Job> jobs(sessions);
+    for (auto i = 0; i < sessions; ++i) {
+        uint8_t mk[16] = {0};
+        mk[0] = i;
+        ciphers[i].init(mk, 16);
+        jobs[i] = {&ciphers[i], {0}, data.data() + i * msglen, data.data() + i * msglen, msglen, nullptr};
+    }
+
+    AesNIMultiBuffer engine([](const Job& job) {}, -1);
+
+    size_t minSingle = -1;
+    size_t minBatch = -1;
+    for (auto iter = 0; iter < iterations; ++iter) {
+        auto started = __rdtsc();
+        for (auto& job : jobs) {
+            ctr_reference(*job.cipher, job.out, job.counter, job.in, job.length);
+        }
+        minSingle = std::min(minSingle, static_cast<size_t>(__rdtsc() - started));
+
+        started = __rdtsc();
+        for (auto& job : jobs) {
+            engine.submit(job);
+        }
+        engine.flush();
+        minBatch = std::min(minBatch, static_cast<size_t>(__rdtsc() - started));
+    }
+
+    std::cout << "---------------------------------" << std::endl;
+    std::cout << "AES-NI CTR over " << sessions << " sessions" << std::endl;
+    std::cout << "     msg length: " << msglen << std::endl;
+    std::cout << "  per block cpb: " << static_cast<double>(minSingle) / (msglen * sessions) << std::endl;
+    std::cout << "  multi-buf cpb: " << static_cast<double>(minBatch) / (msglen * sessions) << std::endl;
+    std::cout << std::endl;
+}
@@ -23,10 +23,14 @@
  */
 
 #include "test_ocb.h"
+#include "../../include/util/byte_array.h"
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
 using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
 
 #include <cpuid.h>
 #include <stdint.h>
@@ -140,6 +144,48 @@ void benchmark_ocb(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t m
     delete[] aad;
 }
 
+void benchmark_gcm(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t msglen, size_t aadlen, size_t iterations)
+{   
+    uint8_t mk[64] = {0};    
+    uint8_t iv[64] = {0};
+    uint8_t* aad = new uint8_t[aadlen];
+    uint8_t* pt = new uint8_t[msglen];
+    uint8_t* ct = new uint8_t[msglen + 16];
+
+    std::shared_ptr<BufferedBlockCipherAead> gcm = std::make_shared<GCM>();
+    gcm->initCipher(cipher, mk, keysize);
+
+    size_t min = -1;
+    timer_st ts;
+
+    for (auto iter = 0; iter < iterations; ++iter)
+    {
+        startTimer(ts);
+
+        gcm->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 12, 16);
+        gcm->updateAAD(aad, aadlen);
+        gcm->doFinal(ct, pt, msglen);
+
+        endTimer(ts);
+        
+        if (ts.tDur < min) {
+            min = ts.tDur;
+        }
+    }
+
+    std::cout << "---------------------------------" << std::endl;
+    std::cout << gcm->name() << std::endl;
+    std::cout << "     msg length: " << msglen << std::endl;
+    std::cout << "     aad length: " << aadlen << std::endl;
+    std::cout << "eclapsed cycles: " << min << std::endl;
+    std::cout << "    elapsed cpb: " << static_cast<double>(min) / msglen << std::endl;
+    std::cout << std::endl;
+
+    delete[] pt;
+    delete[] ct;
+    delete[] aad;
+}
+
 void benchmark_ctr(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t msglen, size_t iterations)
 {   
     uint8_t mk[64] = {0};    
@@ -179,4 +225,370 @@ void benchmark_ctr(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t m
 
     delete[] pt;
     delete[] ct;
+}
+
+struct ocb_sample_t {
+    size_t aadlen;
+    size_t msglen;
+    std::string ct;
+};
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+static size_t ocb_encrypt(std::shared_ptr<BufferedBlockCipherAead> ocb, uint8_t* out, const uint8_t* nonce, const uint8_t* aad, size_t aadlen, const uint8_t* msg, size_t msglen, size_t taglen)
+{
+    ocb->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, nonce, 12, taglen);
+    ocb->updateAAD(aad, aadlen);
+    return ocb->doFinal(out, msg, msglen);
+}
+
+static void verify_ocb_samples(std::shared_ptr<BlockCipher> cipher)
+{
+    // RFC 7253 Appendix A, K = 000102...0F, N = BBAA99887766554433221100 + i
+    std::vector<ocb_sample_t> samples = {
+        { 0,  0, "785407BFFFC8AD9EDCC5520AC9111EE6"},
+        { 8,  8, "6820B3657B6F615A5725BDA0D3B4EB3A257C9AF1F8F03009"},
+        { 8,  0, "81017F8203F081277152FADE694A0A00"},
+        { 0,  8, "45DD69F8F5AAE72414054CD1F35D82760B2CD00D2F99BFA9"},
+        {16, 16, "571D535B60B277188BE5147170A9A22C3AD7A4FF3835B8C5701C1CCEC8FC3358"},
+        {16,  0, "8CF761B6902EF764462AD86498CA6B97"},
+        { 0, 16, "5CE88EC2E0692706A915C00AEB8B2396F40E1C743F52436BDF06D8FA1ECA343D"},
+        {24, 24, "1CA2207308C87C010756104D8840CE1952F09673A448A122C92C62241051F57356D7F3C90BB0E07F"},
+        {24,  0, "6DC225A071FC1B9F7C69F93B0F1E10DE"},
+        { 0, 24, "221BD0DE7FA6FE993ECCD769460A0AF2D6CDED0C395B1C3CE725F32494B9F914D85C0B1EB38357FF"},
+        {32, 32, "BD6F6C496201C69296C11EFD138A467ABD3C707924B964DEAFFC40319AF5A48540FBBA186C5553C68AD9F592A79A4240"},
+        {32,  0, "FE80690BEE8A485D11F32965BC9D2A32"},
+        { 0, 32, "2942BFC773BDA23CABC6ACFD9BFD5835BD300F0973792EF46040C53F1432BCDFB5E1DDE3BC18A5F840B52E653444D5DF"},
+        {40, 40, "D5CA91748410C1751FF8A2F618255B68A0A12E093FF454606E59F9C1D0DDC54B65E8628E568BAD7AED07BA06A4A69483A7035490C5769E60"},
+        {40,  0, "C5CD9D1850C141E358649994EE701B68"},
+        { 0, 40, "4412923493C57D5DE0D700F753CCE0D1D2D95060122E9F15A5DDBFC5787E50B5CC55EE507BCB084E479AD363AC366B95A98CA5F3000B1479"},
+    };
+
+    uint8_t mk[16] = {0};
+    uint8_t nonce[12] = {0xBB, 0xAA, 0x99, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x00};
+    uint8_t data[40] = {0};
+    uint8_t out[40 + 16] = {0};
+    uint8_t dec[40] = {0};
+
+    for (auto i = 0; i < 40; ++i) {
+        data[i] = i;
+    }
+    std::copy(data, data + 16, mk);
+
+    std::shared_ptr<BufferedBlockCipherAead> ocb = std::make_shared<OCB3>();
+    ocb->initCipher(cipher, mk, 16);
+
+    size_t countPassed = 0;
+    size_t countDecrypted = 0;
+    size_t countSealed = 0;
+    for (auto i = 0; i < samples.size(); ++i) {
+        auto ct = toByteArray(samples[i].ct);
+        auto msglen = samples[i].msglen;
+
+        nonce[11] = i;
+        auto outlen = ocb_encrypt(ocb, out, nonce, data, samples[i].aadlen, data, msglen, 16);
+
+        if (outlen == ct.size() && std::equal(ct.begin(), ct.end(), out)) {
+            countPassed += 1;
+        }
+
+        // the one-shot API gives the same record
+        auto sealedLen = ocb->seal(out, nonce, 12, data, samples[i].aadlen, data, msglen, 16);
+        auto openedLen = ocb->open(dec, nonce, 12, data, samples[i].aadlen, out, sealedLen, 16);
+
+        if (sealedLen == ct.size() && std::equal(ct.begin(), ct.end(), out) && openedLen == msglen && std::equal(data, data + msglen, dec)) {
+            countSealed += 1;
+        }
+
+        auto verified = ocb->decryptAndVerify(dec, nonce, 12, data, samples[i].aadlen, ct.data(), ct.size(), 16);
+
+        // flipping the last tag bit must be rejected
+        ct.back() ^= 0x01;
+        auto forged = ocb->decryptAndVerify(out, nonce, 12, data, samples[i].aadlen, ct.data(), ct.size(), 16);
+
+        if (verified && !forged && std::equal(data, data + msglen, dec)) {
+            countDecrypted += 1;
+        }
+    }
+
+    print_verify_result(ocb->name() + "_RFC7253", countPassed, samples.size());
+    print_verify_result(ocb->name() + "_RFC7253_DECRYPT", countDecrypted, samples.size());
+    print_verify_result(ocb->name() + "_RFC7253_SEAL", countSealed, samples.size());
+}
+
+static void verify_ocb_iterative(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t taglen, std::string expected)
+{
+    // RFC 7253 Appendix A, iterated over 128 message lengths
+    uint8_t mk[32] = {0};
+    uint8_t nonce[12] = {0};
+    uint8_t zeros[128] = {0};
+    uint8_t out[128 + 16] = {0};
+    std::vector<uint8_t> ct;
+
+    mk[keysize - 1] = taglen << 3;
+
+    std::shared_ptr<BufferedBlockCipherAead> ocb = std::make_shared<OCB3>();
+    ocb->initCipher(cipher, mk, keysize);
+
+    auto setNonce = [&nonce](size_t n) {
+        nonce[10] = n >> 8;
+        nonce[11] = n;
+    };
+
+    for (auto i = 0; i < 128; ++i) {
+        setNonce(3 * i + 1);
+        auto outlen = ocb_encrypt(ocb, out, nonce, zeros, i, zeros, i, taglen);
+        ct.insert(ct.end(), out, out + outlen);
+
+        setNonce(3 * i + 2);
+        outlen = ocb_encrypt(ocb, out, nonce, zeros, 0, zeros, i, taglen);
+        ct.insert(ct.end(), out, out + outlen);
+
+        setNonce(3 * i + 3);
+        outlen = ocb_encrypt(ocb, out, nonce, zeros, i, zeros, 0, taglen);
+        ct.insert(ct.end(), out, out + outlen);
+    }
+
+    setNonce(385);
+    auto outlen = ocb_encrypt(ocb, out, nonce, ct.data(), ct.size(), zeros, 0, taglen);
+
+    auto tag = toByteArray(expected);
+    auto passed = (outlen == tag.size() && std::equal(tag.begin(), tag.end(), out)) ? 1 : 0;
+
+    std::ostringstream title;
+    title << ocb->name() << "-" << (keysize << 3) << "_RFC7253_TAGLEN" << (taglen << 3);
+    print_verify_result(title.str(), passed, 1);
+}
+
+// fragments of the given sizes over data, the last one taking the rest
+static std::vector<iovec> split_fragments(uint8_t* data, size_t length, const std::vector<size_t>& sizes)
+{
+    std::vector<iovec> fragments;
+
+    for (auto size : sizes) {
+        size = std::min(size, length);
+        fragments.push_back({data, size});
+        data += size;
+        length -= size;
+    }
+    fragments.push_back({data, length});
+
+    return fragments;
+}
+
+static void verify_ocb_iovec(std::shared_ptr<BlockCipher> cipher)
+{
+    uint8_t mk[16] = {0};
+    uint8_t iv[12] = {0};
+    std::vector<uint8_t> aad(45);
+    std::vector<uint8_t> pt(1000);
+    for (auto i = 0; i < aad.size(); ++i) {
+        aad[i] = 3 * i;
+    }
+    for (auto i = 0; i < pt.size(); ++i) {
+        pt[i] = 5 * i + 1;
+    }
+
+    std::shared_ptr<BufferedBlockCipherAead> ocb = std::make_shared<OCB3>();
+    ocb->initCipher(cipher, mk, 16);
+
+    std::vector<uint8_t> expected(pt.size() + 16);
+    ocb_encrypt(ocb, expected.data(), iv, aad.data(), aad.size(), pt.data(), pt.size(), 16);
+
+    auto aadFragments = split_fragments(aad.data(), aad.size(), {3, 20, 1, 0, 5});
+    size_t countPassed = 0;
+
+    // gathered from and scattered to fragments that straddle blocks
+    std::vector<uint8_t> ct(pt.size() + 16);
+    auto in = split_fragments(pt.data(), pt.size(), {1, 15, 17, 100, 3, 64});
+    auto out = split_fragments(ct.data(), pt.size(), {7, 33, 16, 500});
+
+    ocb->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 12, 16);
+    ocb->updateAAD(aadFragments.data(), aadFragments.size());
+    auto outlen = ocb->update(in.data(), in.size(), out.data(), out.size());
+    outlen += ocb->doFinal(ct.data() + outlen);
+    countPassed += (outlen == expected.size() && ct == expected) ? 1 : 0;
+
+    // in place over the same fragments
+    auto buffer = expected;
+    auto fragments = split_fragments(buffer.data(), buffer.size(), {1, 15, 17, 100, 3, 64});
+
+    ocb->initMode(BufferedBlockCipher::CipherMode::DECRYPT, iv, 12, 16);
+    ocb->updateAAD(aadFragments.data(), aadFragments.size());
+    outlen = ocb->update(fragments.data(), fragments.size(), fragments.data(), fragments.size());
+    outlen += ocb->doFinal(buffer.data() + outlen);
+    countPassed += (outlen == pt.size() && std::equal(pt.begin(), pt.end(), buffer.begin())) ? 1 : 0;
+
+    print_verify_result(ocb->name() + "_IOVEC", countPassed, 2);
+}
+
+static void verify_ocb_batch(std::shared_ptr<BlockCipher> cipher)
+{
+    const size_t count = 19;
+    uint8_t mk[16] = {0};
+    std::vector<uint8_t> data(512);
+    for (auto i = 0; i < data.size(); ++i) {
+        data[i] = 7 * i + 3;
+    }
+
+    auto ocb = std::make_shared<OCB3>();
+    ocb->initCipher(cipher, mk, 16);
+
+    std::vector<std::vector<uint8_t>> nonces(count), sealed(count);
+    std::vector<const uint8_t*> nonceptrs(count), aads(count), msgs(count);
+    std::vector<uint8_t*> outs(count);
+    std::vector<size_t> aadlens(count), msglens(count), outlens(count);
+
+    // lengths cover empty and partial AAD and messages, with lanes finishing at different blocks
+    for (auto i = 0; i < count; ++i) {
+        nonces[i].assign(12, i);
+        aadlens[i] = (i * 7) % 50;
+        msglens[i] = (i * 29) % 300;
+        sealed[i].resize(msglens[i] + 16);
+
+        nonceptrs[i] = nonces[i].data();
+        aads[i] = data.data() + i;
+        msgs[i] = data.data() + 2 * i;
+        outs[i] = sealed[i].data();
+    }
+
+    ocb->sealMany(outs.data(), outlens.data(), nonceptrs.data(), 12, aads.data(), aadlens.data(), msgs.data(), msglens.data(), count, 16);
+
+    size_t countPassed = 0;
+    std::vector<uint8_t> expected(data.size() + 16);
+    for (auto i = 0; i < count; ++i) {
+        auto outlen = ocb->seal(expected.data(), nonceptrs[i], 12, aads[i], aadlens[i], msgs[i], msglens[i], 16);
+
+        if (outlen == outlens[i] && std::equal(sealed[i].begin(), sealed[i].end(), expected.begin())) {
+            countPassed += 1;
+        }
+    }
+
+    print_verify_result(ocb->name() + "_BATCH_SEAL", countPassed, count);
+
+    // in place, with a shorter tag
+    std::vector<std::vector<uint8_t>> buffers(count);
+    for (auto i = 0; i < count; ++i) {
+        buffers[i].assign(msgs[i], msgs[i] + msglens[i]);
+        buffers[i].resize(msglens[i] + 12);
+        msgs[i] = outs[i] = buffers[i].data();
+    }
+
+    ocb->sealMany(outs.data(), outlens.data(), nonceptrs.data(), 12, aads.data(), aadlens.data(), msgs.data(), msglens.data(), count, 12);
+
+    countPassed = 0;
+    for (auto i = 0; i < count; ++i) {
+        auto outlen = ocb->seal(expected.data(), nonceptrs[i], 12, aads[i], aadlens[i], data.data() + 2 * i, msglens[i], 12);
+
+        if (outlen == outlens[i] && std::equal(buffers[i].begin(), buffers[i].end(), expected.begin())) {
+            countPassed += 1;
+        }
+    }
+
+    print_verify_result(ocb->name() + "_BATCH_SEAL_IN_PLACE", countPassed, count);
+}
+
+// an empty tag would authenticate nothing, so every entry point refuses it
+static void verify_ocb_empty_tag(std::shared_ptr<BlockCipher> cipher)
+{
+    uint8_t mk[16] = {0};
+    uint8_t nonce[12] = {0};
+    uint8_t msg[32] = {0};
+    uint8_t out[48] = {0};
+    size_t outlen = 0;
+
+    auto ocb = std::make_shared<OCB3>();
+    ocb->initCipher(cipher, mk, 16);
+
+    const uint8_t* nonces[1] = {nonce};
+    const uint8_t* msgs[1] = {msg};
+    uint8_t* outs[1] = {out};
+    size_t msglens[1] = {sizeof(msg)};
+    size_t aadlens[1] = {0};
+
+    size_t countPassed = 0;
+    try {
+        ocb->initMode(BufferedBlockCipher::CipherMode::DECRYPT, nonce, sizeof(nonce), 0);
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+    try {
+        ocb->sealMany(outs, &outlen, nonces, sizeof(nonce), msgs, aadlens, msgs, msglens, 1, 0);
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+
+    print_verify_result(ocb->name() + "_EMPTY_TAG", countPassed, 2);
+}
+
+void benchmark_ocb_batch(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t msglen, size_t count, size_t iterations)
+{
+    uint8_t mk[64] = {0};
+    std::vector<uint8_t> nonces(count * 12);
+    std::vector<uint8_t> pt(count * msglen);
+    std::vector<uint8_t> ct(count * (msglen + 16));
+
+    std::vector<const uint8_t*> nonceptrs(count), aads(count), msgs(count);
+    std::vector<uint8_t*> outs(count);
+    std::vector<size_t> aadlens(count, 0), msglens(count, msglen), outlens(count);
+    for (auto i = 0; i < count; ++i) {
+        nonces[i * 12 + 11] = i;
+        nonceptrs[i] = nonces.data() + i * 12;
+        aads[i] = pt.data();
+        msgs[i] = pt.data() + i * msglen;
+        outs[i] = ct.data() + i * (msglen + 16);
+    }
+
+    auto ocb = std::make_shared<OCB3>();
+    ocb->initCipher(cipher, mk, keysize);
+
+    size_t minSingle = -1;
+    size_t minBatch = -1;
+    timer_st ts;
+
+    for (auto iter = 0; iter < iterations; ++iter)
+    {
+        startTimer(ts);
+        for (auto i = 0; i < count; ++i) {
+            ocb->seal(outs[i], nonceptrs[i], 12, aads[i], 0, msgs[i], msglen, 16);
+        }
+        endTimer(ts);
+        minSingle = std::min(minSingle, static_cast<size_t>(ts.tDur));
+
+        startTimer(ts);
+        ocb->sealMany(outs.data(), outlens.data(), nonceptrs.data(), 12, aads.data(), aadlens.data(), msgs.data(), msglens.data(), count, 16);
+        endTimer(ts);
+        minBatch = std::min(minBatch, static_cast<size_t>(ts.tDur));
+    }
+
+    std::cout << "---------------------------------" << std::endl;
+    std::cout << ocb->name() << " batch of " << count << std::endl;
+    std::cout << "     msg length: " << msglen << std::endl;
+    std::cout << "     seal   cpb: " << static_cast<double>(minSingle) / (msglen * count) << std::endl;
+    std::cout << " sealMany   cpb: " << static_cast<double>(minBatch) / (msglen * count) << std::endl;
+    std::cout << std::endl;
+}
+
+void verify_ocb(std::shared_ptr<BlockCipher> cipher)
+{
+    verify_ocb_samples(cipher);
+
+    verify_ocb_iterative(cipher, 16, 16, "67E944D23256C5E0B6C61FA22FDF1EA2");
+    verify_ocb_iterative(cipher, 24, 16, "F673F2C3E7174AAE7BAE986CA9F29E17");
+    verify_ocb_iterative(cipher, 32, 16, "D90EB8E9C977C88B79DD793D7FFA161C");
+    verify_ocb_iterative(cipher, 16, 12, "77A3D8E73589158D25D01209");
+    verify_ocb_iterative(cipher, 24, 12, "05D56EAD2752C86BE6932C5E");
+    verify_ocb_iterative(cipher, 32, 12, "5458359AC23B0CBA9E6330DD");
+    verify_ocb_iterative(cipher, 16,  8, "192C9B7BD90BA06A");
+    verify_ocb_iterative(cipher, 24,  8, "0066BC6E0EF34E24");
+    verify_ocb_iterative(cipher, 32,  8, "7D4EA5D445501CBE");
+
+    verify_ocb_iovec(cipher);
+    verify_ocb_batch(cipher);
+    verify_ocb_empty_tag(cipher);
 }
\ No newline at end of file
@@ -24,6 +24,7 @@
 
 #include "../../include/mode/ocb3.h"
 #include "../../include/mode/ctr.h"
+#include "../../include/mode/gcm.h"
 #include "../../include/block_cipher.h"
 
 #include <memory>
@@ -32,4 +33,10 @@ using namespace mockup::crypto;
 
 void benchmark_ctr(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t msglen, size_t iterations = 1000);
 
+void verify_ocb(std::shared_ptr<BlockCipher> cipher);
+
+void benchmark_gcm(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t msglen, size_t aadlen, size_t iterations = 1000);
+
 void benchmark_ocb(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t msglen, size_t aadlen, size_t taglen, size_t iterations = 1000);
+
+void benchmark_ocb_batch(std::shared_ptr<BlockCipher> cipher, size_t keysize, size_t msglen, size_t count, size_t iterations = 1000);
@@ -0,0 +1,204 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "test_stream.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace mockup::crypto::mode;
+
+static constexpr size_t CHUNK_SIZE = 1000;
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+static std::vector<uint8_t> generate_message(size_t length)
+{
+    std::vector<uint8_t> msg(length);
+    for (auto i = 0; i < length; ++i) {
+        msg[i] = 5 * i + (i >> 9);
+    }
+    return msg;
+}
+
+// written in uneven pieces, so that writes straddle chunks and batches
+static std::string seal_stream(Ocb3Stream& stream, const uint8_t* prefix, const std::vector<uint8_t>& msg)
+{
+    std::ostringstream os(std::ios::binary);
+    Ocb3StreamWriter writer(stream, prefix, os, 3);
+
+    size_t offset = 0;
+    for (size_t piece = 1; offset < msg.size(); piece = piece * 3 + 1) {
+        auto length = std::min(piece, msg.size() - offset);
+        writer.write(msg.data() + offset, length);
+        offset += length;
+    }
+    writer.finish();
+
+    return os.str();
+}
+
+static bool open_stream(Ocb3Stream& stream, const uint8_t* prefix, const std::string& sealed, std::vector<uint8_t>& msg)
+{
+    std::istringstream is(sealed, std::ios::binary);
+    Ocb3StreamReader reader(stream, prefix, is, 2);
+
+    msg.clear();
+    try {
+        uint8_t buffer[777];
+        while (auto length = reader.read(buffer, sizeof(buffer))) {
+            msg.insert(msg.end(), buffer, buffer + length);
+        }
+    } catch (const char* e) {
+        return false;
+    }
+
+    return true;
+}
+
+static void verify_ocb_stream_round_trip(Ocb3Stream& stream, const uint8_t* prefix)
+{
+    std::vector<size_t> lengths = {0, 1, CHUNK_SIZE, 2 * CHUNK_SIZE + 500, 6 * CHUNK_SIZE, 12345};
+    size_t countPassed = 0;
+
+    for (auto length : lengths) {
+        auto msg = generate_message(length);
+        auto sealed = seal_stream(stream, prefix, msg);
+
+        auto chunks = std::max((length + CHUNK_SIZE - 1) / CHUNK_SIZE, static_cast<size_t>(1));
+        std::vector<uint8_t> opened;
+
+        if (sealed.size() == length + chunks * Ocb3Stream::TAG_LENGTH && open_stream(stream, prefix, sealed, opened) && opened == msg) {
+            countPassed += 1;
+        }
+    }
+
+    print_verify_result(stream.name() + "_ROUND_TRIP", countPassed, lengths.size());
+}
+
+static void verify_ocb_stream_random_access(Ocb3Stream& stream, std::shared_ptr<BlockCipher> cipher, const uint8_t* mk, const uint8_t* prefix)
+{
+    auto msg = generate_message(5 * CHUNK_SIZE + 10);
+    auto sealed = seal_stream(stream, prefix, msg);
+    size_t countPassed = 0;
+
+    // chunk 2 is plain OCB3 under nonce = prefix||00000002||00
+    uint8_t nonce[Ocb3Stream::NONCE_LENGTH] = {0};
+    std::copy(prefix, prefix + Ocb3Stream::PREFIX_LENGTH, nonce);
+    nonce[10] = 0x02;
+
+    std::shared_ptr<BufferedBlockCipherAead> ocb = std::make_shared<OCB3>();
+    ocb->initCipher(cipher, mk, 16);
+    std::vector<uint8_t> expected(CHUNK_SIZE + Ocb3Stream::TAG_LENGTH);
+    ocb->seal(expected.data(), nonce, sizeof(nonce), nullptr, 0, msg.data() + 2 * CHUNK_SIZE, CHUNK_SIZE, Ocb3Stream::TAG_LENGTH);
+
+    auto offset = 2 * stream.sealedChunkSize();
+    auto sealedChunk = reinterpret_cast<const uint8_t*>(sealed.data()) + offset;
+    countPassed += std::equal(expected.begin(), expected.end(), sealedChunk) ? 1 : 0;
+
+    std::istringstream is(sealed, std::ios::binary);
+    Ocb3StreamReader reader(stream, prefix, is);
+
+    // a single chunk, including the last one, without moving the read position
+    uint8_t first[10];
+    reader.read(first, sizeof(first));
+
+    std::vector<uint8_t> chunk(CHUNK_SIZE);
+    auto outlen = reader.readChunk(2, chunk.data());
+    countPassed += (outlen == CHUNK_SIZE && std::equal(chunk.begin(), chunk.end(), msg.begin() + 2 * CHUNK_SIZE)) ? 1 : 0;
+
+    outlen = reader.readChunk(5, chunk.data());
+    countPassed += (outlen == 10 && std::equal(chunk.begin(), chunk.begin() + 10, msg.begin() + 5 * CHUNK_SIZE)) ? 1 : 0;
+
+    uint8_t next[10];
+    reader.read(next, sizeof(next));
+    countPassed += (std::equal(first, first + 10, msg.begin()) && std::equal(next, next + 10, msg.begin() + 10)) ? 1 : 0;
+
+    // seeks into a chunk, and to the very end
+    std::vector<uint8_t> rest(msg.size());
+    reader.seek(3333);
+    outlen = reader.read(rest.data(), rest.size());
+    countPassed += (outlen == msg.size() - 3333 && std::equal(msg.begin() + 3333, msg.end(), rest.begin())) ? 1 : 0;
+
+    reader.seek(msg.size());
+    countPassed += (reader.read(rest.data(), rest.size()) == 0) ? 1 : 0;
+
+    print_verify_result(stream.name() + "_RANDOM_ACCESS", countPassed, 6);
+}
+
+static void verify_ocb_stream_forgery(Ocb3Stream& stream, const uint8_t* prefix)
+{
+    auto msg = generate_message(4 * CHUNK_SIZE);
+    auto sealed = seal_stream(stream, prefix, msg);
+    auto sealedChunk = stream.sealedChunkSize();
+    std::vector<uint8_t> opened;
+    size_t countPassed = 0;
+
+    // tampered
+    auto forged = sealed;
+    forged[sealedChunk + 7] ^= 0x01;
+    countPassed += open_stream(stream, prefix, forged, opened) ? 0 : 1;
+
+    // reordered
+    forged = sealed.substr(sealedChunk, sealedChunk) + sealed.substr(0, sealedChunk) + sealed.substr(2 * sealedChunk);
+    countPassed += open_stream(stream, prefix, forged, opened) ? 0 : 1;
+
+    // truncated at a chunk boundary, where every remaining chunk is authentic but none is the last
+    forged = sealed.substr(0, 3 * sealedChunk);
+    countPassed += open_stream(stream, prefix, forged, opened) ? 0 : 1;
+
+    // extended with a chunk from another stream
+    uint8_t other[Ocb3Stream::PREFIX_LENGTH] = {0};
+    forged = sealed + seal_stream(stream, other, msg).substr(0, sealedChunk);
+    countPassed += open_stream(stream, prefix, forged, opened) ? 0 : 1;
+
+    // empty
+    countPassed += open_stream(stream, prefix, "", opened) ? 0 : 1;
+
+    print_verify_result(stream.name() + "_FORGERY", countPassed, 5);
+}
+
+void verify_ocb_stream(std::shared_ptr<BlockCipher> cipher, const std::vector<std::shared_ptr<BlockCipher>>& workers)
+{
+    uint8_t mk[16] = {0};
+    uint8_t prefix[Ocb3Stream::PREFIX_LENGTH] = {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6};
+    for (auto i = 0; i < sizeof(mk); ++i) {
+        mk[i] = 7 * i;
+    }
+
+    Ocb3Stream stream(CHUNK_SIZE);
+    stream.setWorkers(workers);
+    stream.initCipher(cipher, mk, sizeof(mk));
+
+    verify_ocb_stream_round_trip(stream, prefix);
+    verify_ocb_stream_random_access(stream, cipher, mk, prefix);
+    verify_ocb_stream_forgery(stream, prefix);
+}
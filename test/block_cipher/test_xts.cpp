@@ -0,0 +1,166 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "test_xts.h"
+#include "../../include/util/byte_array.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
+
+struct xts_sample_t {
+    size_t keysize;
+    uint64_t sector;
+    size_t length;
+    std::string tail;
+};
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+static std::vector<uint8_t> generate_key(size_t keysize)
+{
+    std::vector<uint8_t> mk(keysize);
+    for (auto i = 0; i < keysize; ++i) {
+        mk[i] = 11 * i + 3;
+    }
+    return mk;
+}
+
+static std::vector<uint8_t> generate_message(size_t length)
+{
+    std::vector<uint8_t> msg(length);
+    for (auto i = 0; i < length; ++i) {
+        msg[i] = 5 * i + 1;
+    }
+    return msg;
+}
+
+static void verify_xts_samples(std::shared_ptr<BlockCipher> cipher, std::shared_ptr<BlockCipher> tweakCipher)
+{
+    // K[i] = 11i + 3, P[i] = 5i + 1, trailing ciphertext bytes computed with OpenSSL
+    std::vector<xts_sample_t> samples = {
+        {32, 0x00, 16, "944642160CFF739140D84125AB8E074F"},
+        {32, 0x00, 17, "A4BCC9CBB064A5F22A9E676E85C60F4994"},
+        {32, 0x01, 31, "E67E938B73749F049E8A59213E7252A31A2DA8BC375C2756660A34735F4B83"},
+        {64, 0x123456789A, 48, "F9FA1293369B4A8FF67A0B2EA33F17DF790E4980F59A10D8577BB6D0412C7E28FBE75679F1BB124BEE8ABF85C77EA710"},
+        {64, 0xFFFFFFFF, 33, "8BC739A5E0C3FB0278E6A836E27EAF5391A5C288641F104787F2FD93B5F8601C2C"},
+        {32, 0x00, 4096, "8549DAC2B67579E07AE0546912151E24A1B84DAAAE9FF919080BCA56A3829B23"},
+        {64, 0xFEDCBA9876543210, 4095, "4D9E6FB344A20F3CB76536FA52558C952DB080F9E5A4D0EC4B2BF4BA2BD26BA9"},
+    };
+
+    auto xts = std::make_shared<XTS>();
+
+    size_t countPassed = 0;
+    size_t countDecrypted = 0;
+    for (auto& sample : samples) {
+        auto mk = generate_key(sample.keysize);
+        auto pt = generate_message(sample.length);
+        auto tail = toByteArray(sample.tail);
+        std::vector<uint8_t> ct(sample.length);
+
+        xts->initCipher(cipher, tweakCipher, mk.data(), mk.size());
+        xts->encryptSector(ct.data(), pt.data(), pt.size(), sample.sector);
+
+        if (std::equal(tail.begin(), tail.end(), ct.end() - tail.size())) {
+            countPassed += 1;
+        }
+
+        // decrypted in place
+        xts->decryptSector(ct.data(), ct.data(), ct.size(), sample.sector);
+        if (ct == pt) {
+            countDecrypted += 1;
+        }
+    }
+
+    // IEEE 1619 vector 2
+    auto mk = toByteArray("1111111111111111111111111111111122222222222222222222222222222222");
+    auto pt = toByteArray("4444444444444444444444444444444444444444444444444444444444444444");
+    auto expected = toByteArray("C454185E6A16936E39334038ACEF838BFB186FFF7480ADC4289382ECD6D394F0");
+    std::vector<uint8_t> ct(pt.size());
+
+    xts->initCipher(cipher, tweakCipher, mk.data(), mk.size());
+    xts->encryptSector(ct.data(), pt.data(), pt.size(), 0x3333333333);
+    if (ct == expected) {
+        countPassed += 1;
+    }
+
+    print_verify_result(xts->name() + "_SAMPLES", countPassed, samples.size() + 1);
+    print_verify_result(xts->name() + "_SAMPLES_DECRYPT", countDecrypted, samples.size());
+}
+
+static void verify_xts_sectors(std::shared_ptr<BlockCipher> cipher, std::shared_ptr<BlockCipher> tweakCipher)
+{
+    // last block of each 4 KB sector 0x100 ... 0x109 under a 256-bit key, computed with OpenSSL
+    std::vector<std::string> tails = {
+        "40C8201FEAB03C81FE41757B16E1AE3D", "D9CB315EEFDAC6C8BE06DDF95D4D6A25",
+        "9E66D04934CFB5DA4CBE29FE76594C11", "D2FC921B1555049C19CA9A05D474B1F8",
+        "BEB788A1AB948E9769A143F21733461D", "60938E715AF2ED45BF69F9D405A19195",
+        "CCD0E274B94D31A59F2A8B46159AA692", "2BBAE640ED010B9927B3E50CEF620983",
+        "FA2A4A8910FFE7C0D7A5C6F8642068EC", "F07569F598174E476A5E23ACA1ED6BCC",
+    };
+
+    const size_t sectorSize = 4096;
+    auto count = tails.size();
+
+    auto mk = generate_key(64);
+    auto sector = generate_message(sectorSize);
+    std::vector<uint8_t> pt;
+    for (auto i = 0; i < count; ++i) {
+        pt.insert(pt.end(), sector.begin(), sector.end());
+    }
+    std::vector<uint8_t> ct(pt.size());
+
+    auto xts = std::make_shared<XTS>();
+    xts->initCipher(cipher, tweakCipher, mk.data(), mk.size());
+    xts->encryptSectors(ct.data(), pt.data(), sectorSize, count, 0x100);
+
+    size_t countPassed = 0;
+    for (auto i = 0; i < count; ++i) {
+        auto tail = toByteArray(tails[i]);
+        if (std::equal(tail.begin(), tail.end(), ct.begin() + (i + 1) * sectorSize - tail.size())) {
+            countPassed += 1;
+        }
+    }
+
+    xts->decryptSectors(ct.data(), ct.data(), sectorSize, count, 0x100);
+    auto decrypted = (ct == pt) ? 1 : 0;
+
+    print_verify_result(xts->name() + "_SECTORS", countPassed, count);
+    print_verify_result(xts->name() + "_SECTORS_DECRYPT", decrypted, 1);
+}
+
+void verify_xts(std::shared_ptr<BlockCipher> cipher, std::shared_ptr<BlockCipher> tweakCipher)
+{
+    verify_xts_samples(cipher, tweakCipher);
+    verify_xts_sectors(cipher, tweakCipher);
+}
@@ -28,6 +28,7 @@
 #include <memory>
 
 #include "../../include/hash/lsh.h"
+#include "../../include/hash/lsh_multi_buffer.h"
 #include "../../include/util/hex.h"
 #include "../test_vector_reader.h"
 
@@ -35,17 +36,17 @@ using namespace mockup::crypto;
 using namespace mockup::crypto::hash;
 using namespace mockup::crypto::util;
 
-static std::shared_ptr<Hash> getLshInstance(int lshsize, int outsize)
+static std::shared_ptr<Hash> getLshInstance(int lshsize, int outsize, LshSimd simd = LshSimd::AVX2)
 {
     std::shared_ptr<Hash> lsh = nullptr;
 
     switch(lshsize) {
     case 256:
-        lsh = std::make_shared<Lsh256>(outsize);
+        lsh = std::make_shared<Lsh256>(outsize, simd);
         break;
 
     case 512:
-        lsh = std::make_shared<Lsh512>(outsize);
+        lsh = std::make_shared<Lsh512>(outsize, simd);
         break;
 
     default:
@@ -66,16 +67,42 @@ static TestVectorReader getTestVector(std::string title)
     return tvr;
 }
 
+static const std::string simdName(LshSimd simd)
+{
+    switch (simd) {
+    case LshSimd::AVX2:
+        return "";
+
+    case LshSimd::SSSE3:
+        return " ssse3";
+
+    default:
+        return " portable";
+    }
+}
+
+static inline uint64_t rdtsc(){
+    unsigned int lo,hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
 {
+    // a missing vector file reads as empty, which is not a pass
+    if (countTotal == 0) {
+        std::cout << title << " SKIPPED (no vectors)" << std::endl;
+        return;
+    }
+
     std::cout << title;
     std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
     std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
 }
 
-static void test_lsh(int lshsize, int outsize, std::string msgType)
+static void test_lsh(int lshsize, int outsize, std::string msgType, LshSimd simd)
 {
-    auto lsh = getLshInstance(lshsize, outsize);
+    auto lsh = getLshInstance(lshsize, outsize, simd);
     auto title = lsh->name() + "_" + msgType;
     auto tvr = getTestVector(title);
     auto len = tvr.get("Len");
@@ -94,23 +121,232 @@ static void test_lsh(int lshsize, int outsize, std::string msgType)
         }
     }
 
-    print_verify_result(title, countPassed, len.size());
+    print_verify_result(title + simdName(simd), countPassed, len.size());
 }
 
-static void verify_testvector(std::string msgType) {
-    test_lsh(256, mockup::crypto::BIT_224, msgType);
-    test_lsh(256, mockup::crypto::BIT_256, msgType);
+static void verify_midstate(int lshsize, int outsize)
+{
+    std::vector<uint8_t> msg(1000);
+    for (auto i = 0; i < msg.size(); ++i) {
+        msg[i] = static_cast<uint8_t>(i * 13);
+    }
+
+    auto hash = getLshInstance(lshsize, outsize);
+    auto expected = hash->doFinal(msg);
+
+    size_t countPassed = 0;
+    size_t countTotal = 0;
+    for (auto split : {0, 1, 63, 64, 65, 127, 128, 129, 500, 1000}) {
+        hash->update(msg.data(), split);
 
-    test_lsh(512, mockup::crypto::BIT_224, msgType);
-    test_lsh(512, mockup::crypto::BIT_256, msgType);
-    test_lsh(512, mockup::crypto::BIT_384, msgType);
-    test_lsh(512, mockup::crypto::BIT_512, msgType);
+        auto copy = hash->clone();
+        auto restored = getLshInstance(lshsize, outsize);
+        restored->init();
+        restored->restore(*hash);
+        auto resumed = getLshInstance(lshsize, outsize);
+        resumed->init();
+        resumed->deserialize(hash->serialize());
+
+        for (auto& h : {hash, copy, restored, resumed}) {
+            h->update(msg.data() + split, msg.size() - split);
+            countPassed += (h->doFinal() == expected) ? 1 : 0;
+            countTotal += 1;
+        }
+    }
+
+    // a midstate never goes into another algorithm
+    auto other = getLshInstance(lshsize == 256 ? 512 : 256, outsize);
+    try {
+        other->deserialize(hash->serialize());
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+    try {
+        other->restore(*hash);
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+    countTotal += 2;
+
+    print_verify_result(hash->name() + " midstate", countPassed, countTotal);
+}
+
+static void verify_testvector(std::string msgType, LshSimd simd) {
+    test_lsh(256, mockup::crypto::BIT_224, msgType, simd);
+    test_lsh(256, mockup::crypto::BIT_256, msgType, simd);
+
+    test_lsh(512, mockup::crypto::BIT_224, msgType, simd);
+    test_lsh(512, mockup::crypto::BIT_256, msgType, simd);
+    test_lsh(512, mockup::crypto::BIT_384, msgType, simd);
+    test_lsh(512, mockup::crypto::BIT_512, msgType, simd);
+}
+
+static void benchmark_lsh(int lshsize, LshSimd simd, size_t msglen, size_t iterations)
+{
+    auto hash = getLshInstance(lshsize, lshsize / 8, simd);
+    std::vector<uint8_t> msg(msglen, 0xa5);
+    uint64_t minimum = -1;
+
+    for (auto iter = 0; iter < iterations; ++iter) {
+        auto started = rdtsc();
+        hash->update(msg.data(), msg.size());
+        hash->doFinal();
+        minimum = std::min(minimum, rdtsc() - started);
+    }
+
+    std::cout << hash->name() << simdName(simd) << " cpb: " << static_cast<double>(minimum) / msglen << std::endl;
+}
+
+// every message of a test vector file in one call, so that lanes retire and refill at different steps
+template <typename MultiBuffer>
+static void test_lsh_many(int lshsize, int outsize, std::string msgType, bool useAvx2)
+{
+    MultiBuffer mb(outsize, useAvx2);
+    auto title = getLshInstance(lshsize, outsize)->name() + "_" + msgType;
+    auto tvr = getTestVector(title);
+    auto len = tvr.get("Len");
+
+    std::vector<std::vector<uint8_t>> msgs, mds;
+    for (int i = 0; i < len.size(); ++i) {
+        msgs.push_back(tvr.getByteArray(i, "Msg"));
+        mds.push_back(tvr.getByteArray(i, "MD"));
+    }
+
+    std::vector<const uint8_t*> inputs;
+    std::vector<size_t> lengths;
+    std::vector<std::vector<uint8_t>> digests(msgs.size(), std::vector<uint8_t>(outsize));
+    std::vector<uint8_t*> outputs;
+    for (auto i = 0; i < msgs.size(); ++i) {
+        inputs.push_back(msgs[i].data());
+        lengths.push_back(msgs[i].size());
+        outputs.push_back(digests[i].data());
+    }
+
+    mb.hashMany(inputs.data(), lengths.data(), outputs.data(), msgs.size());
+
+    size_t countPassed = 0;
+    for (auto i = 0; i < msgs.size(); ++i) {
+        countPassed += std::equal(mds[i].begin(), mds[i].end(), digests[i].begin()) ? 1 : 0;
+    }
+
+    std::ostringstream lanes;
+    lanes << " hashMany " << mb.lanes() << " lanes";
+    print_verify_result(title + lanes.str(), countPassed, msgs.size());
+}
+
+static void verify_testvector_many(std::string msgType, bool useAvx2) {
+    test_lsh_many<Lsh256MultiBuffer>(256, mockup::crypto::BIT_224, msgType, useAvx2);
+    test_lsh_many<Lsh256MultiBuffer>(256, mockup::crypto::BIT_256, msgType, useAvx2);
+
+    test_lsh_many<Lsh512MultiBuffer>(512, mockup::crypto::BIT_224, msgType, useAvx2);
+    test_lsh_many<Lsh512MultiBuffer>(512, mockup::crypto::BIT_256, msgType, useAvx2);
+    test_lsh_many<Lsh512MultiBuffer>(512, mockup::crypto::BIT_384, msgType, useAvx2);
+    test_lsh_many<Lsh512MultiBuffer>(512, mockup::crypto::BIT_512, msgType, useAvx2);
+}
+
+// fewer messages than lanes leave lanes idle, and more refill them; LSH pads without a length,
+// so a message ending on a block boundary still takes one more block
+template <typename MultiBuffer>
+static void verify_lanes(int lshsize, bool useAvx2)
+{
+    const auto bs = MultiBuffer::BLOCKSIZE;
+    const std::vector<size_t> sizes = {bs - 1, bs, bs + 1, 0, 3 * bs, 1};
+
+    MultiBuffer mb(lshsize / 8, useAvx2);
+    auto lsh = getLshInstance(lshsize, lshsize / 8);
+    size_t countPassed = 0;
+    size_t countTotal = 0;
+
+    for (size_t count = 0; count <= 2 * mb.lanes() + 1; ++count) {
+        std::vector<std::vector<uint8_t>> msgs;
+        std::vector<const uint8_t*> inputs;
+        std::vector<size_t> lengths;
+        for (auto i = 0; i < count; ++i) {
+            msgs.push_back(std::vector<uint8_t>(sizes[i % sizes.size()], static_cast<uint8_t>(count * 16 + i)));
+        }
+        for (auto& msg : msgs) {
+            inputs.push_back(msg.data());
+            lengths.push_back(msg.size());
+        }
+
+        // one more output than messages, which must stay as it is
+        std::vector<std::vector<uint8_t>> digests(count + 1, std::vector<uint8_t>(lshsize / 8, 0xcc));
+        std::vector<uint8_t*> outputs;
+        for (auto& digest : digests) {
+            outputs.push_back(digest.data());
+        }
+
+        mb.hashMany(inputs.data(), lengths.data(), outputs.data(), count);
+
+        auto passed = std::all_of(digests[count].begin(), digests[count].end(), [](uint8_t b) { return b == 0xcc; });
+        for (auto i = 0; i < count; ++i) {
+            lsh->update(msgs[i]);
+            passed = passed && (lsh->doFinal() == digests[i]);
+        }
+
+        countPassed += passed ? 1 : 0;
+        countTotal += 1;
+    }
+
+    std::ostringstream title;
+    title << lsh->name() << " hashMany " << mb.lanes() << " lanes idle and refilled";
+    print_verify_result(title.str(), countPassed, countTotal);
+}
+
+// the cost of hashMany per byte, next to the single message figures of benchmark_lsh
+template <typename MultiBuffer>
+static void benchmark_lsh_many(int lshsize, size_t msglen, size_t iterations)
+{
+    const size_t total = 1 << 18;
+    auto count = total / msglen;
+
+    MultiBuffer mb(lshsize / 8);
+    std::vector<uint8_t> msgs(total, 0xa5);
+    std::vector<uint8_t> digests(count * lshsize / 8);
+    std::vector<const uint8_t*> inputs(count);
+    std::vector<uint8_t*> outputs(count);
+    std::vector<size_t> lengths(count, msglen);
+    for (auto i = 0; i < count; ++i) {
+        inputs[i] = msgs.data() + i * msglen;
+        outputs[i] = digests.data() + i * lshsize / 8;
+    }
+
+    uint64_t minimum = -1;
+    for (auto iter = 0; iter < iterations; ++iter) {
+        auto started = rdtsc();
+        mb.hashMany(inputs.data(), lengths.data(), outputs.data(), count);
+        minimum = std::min(minimum, rdtsc() - started);
+    }
+
+    std::cout << getLshInstance(lshsize, lshsize / 8)->name() << " hashMany " << mb.lanes() << " lanes, " << msglen << " byte messages cpb: ";
+    std::cout << static_cast<double>(minimum) / (msglen * count) << std::endl;
 }
 
 int main(int argc, const char** argv) 
 {
-    verify_testvector("ShortMsg");
-    verify_testvector("LongMsg");
+    for (auto simd : {LshSimd::AVX2, LshSimd::SSSE3, LshSimd::NONE}) {
+        verify_testvector("ShortMsg", simd);
+        verify_testvector("LongMsg", simd);
+    }
+
+    verify_midstate(256, mockup::crypto::BIT_256);
+    verify_midstate(512, mockup::crypto::BIT_256);
+
+    for (auto useAvx2 : {true, false}) {
+        verify_testvector_many("ShortMsg", useAvx2);
+        verify_testvector_many("LongMsg", useAvx2);
+        verify_lanes<Lsh256MultiBuffer>(256, useAvx2);
+        verify_lanes<Lsh512MultiBuffer>(512, useAvx2);
+    }
+
+    for (auto simd : {LshSimd::AVX2, LshSimd::SSSE3, LshSimd::NONE}) {
+        benchmark_lsh(256, simd, 16384, 100);
+        benchmark_lsh(512, simd, 16384, 100);
+    }
+    for (auto msglen : {64, 1024}) {
+        benchmark_lsh_many<Lsh256MultiBuffer>(256, msglen, 20);
+        benchmark_lsh_many<Lsh512MultiBuffer>(512, msglen, 20);
+    }
 
     return 0;
 }
\ No newline at end of file
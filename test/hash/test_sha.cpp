@@ -29,6 +29,8 @@
 #include <memory>
 
 #include "../../include/hash/sha2.h"
+#include "../../include/hash/sha256_multi_buffer.h"
+#include "../../include/hash/sha512_multi_buffer.h"
 #include "../../include/util/hex.h"
 #include "../test_vector_reader.h"
 
@@ -36,13 +38,13 @@ using namespace mockup::crypto;
 using namespace mockup::crypto::hash;
 using namespace mockup::crypto::util;
 
-static std::shared_ptr<Hash> getSha2Instance(int lshsize, int outsize)
+static std::shared_ptr<Hash> getSha2Instance(int lshsize, int outsize, bool accelerated = true)
 {
     std::shared_ptr<Hash> hash = nullptr;
 
     switch(lshsize) {
     case 256:
-        hash = std::make_shared<Sha256>();
+        hash = std::make_shared<Sha256>(accelerated);
         break;
 
     case 512:
@@ -78,6 +80,12 @@ static void print(const std::vector<uint8_t>& data)
     std::cout << std::endl;
 }
 
+static inline uint64_t rdtsc(){
+    unsigned int lo,hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
 {
     std::cout << title;
@@ -85,9 +93,9 @@ static void print_verify_result(const std::string& title, size_t countPassed, si
     std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
 }
 
-static void test_sha2(int sha2size, int outsize, std::string msgType)
+static void test_sha2(int sha2size, int outsize, std::string msgType, bool accelerated = true)
 {
-    auto hash = getSha2Instance(sha2size, outsize);
+    auto hash = getSha2Instance(sha2size, outsize, accelerated);
     auto title = hash->name() + "_" + msgType;
     auto tvr = getTestVector(title);
     auto len = tvr.get("Len");
@@ -98,7 +106,7 @@ static void test_sha2(int sha2size, int outsize, std::string msgType)
         auto msg = tvr.getByteArray(i, "Msg");
         auto md = tvr.getByteArray(i, "MD");
         
-        hash = getSha2Instance(sha2size, outsize);
+        hash = getSha2Instance(sha2size, outsize, accelerated);
         hash->init();
         if (len > 0) {
             hash->update(msg);
@@ -114,18 +122,212 @@ static void test_sha2(int sha2size, int outsize, std::string msgType)
         }
     }
 
-    print_verify_result(title, countPassed, len.size());
+    print_verify_result(title + (accelerated ? "" : " portable"), countPassed, len.size());
 }
 
 static void verify_testvector(std::string msgType) {    
     test_sha2(256, mockup::crypto::BIT_256, msgType);
+    test_sha2(256, mockup::crypto::BIT_256, msgType, false);
     test_sha2(512, mockup::crypto::BIT_512, msgType);
 }
 
+static void verify_midstate(int sha2size, int outsize)
+{
+    std::vector<uint8_t> msg(1000);
+    for (auto i = 0; i < msg.size(); ++i) {
+        msg[i] = static_cast<uint8_t>(i * 13);
+    }
+
+    auto hash = getSha2Instance(sha2size, outsize);
+    auto expected = hash->doFinal(msg);
+
+    size_t countPassed = 0;
+    size_t countTotal = 0;
+    for (auto split : {0, 1, 63, 64, 65, 127, 128, 129, 500, 1000}) {
+        hash->update(msg.data(), split);
+
+        auto copy = hash->clone();
+        auto restored = getSha2Instance(sha2size, outsize);
+        restored->init();
+        restored->restore(*hash);
+        auto resumed = getSha2Instance(sha2size, outsize);
+        resumed->init();
+        resumed->deserialize(hash->serialize());
+
+        for (auto& h : {hash, copy, restored, resumed}) {
+            h->update(msg.data() + split, msg.size() - split);
+            countPassed += (h->doFinal() == expected) ? 1 : 0;
+            countTotal += 1;
+        }
+    }
+
+    // a midstate never goes into another algorithm
+    auto other = getSha2Instance(sha2size == 256 ? 512 : 256, outsize);
+    try {
+        other->deserialize(hash->serialize());
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+    try {
+        other->restore(*hash);
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+    countTotal += 2;
+
+    print_verify_result(hash->name() + " midstate", countPassed, countTotal);
+}
+
+static void verify_digest_output(int sha2size)
+{
+    auto hash = getSha2Instance(sha2size, sha2size);
+    std::vector<uint8_t> msg(300, 0x61);
+    size_t countPassed = 0;
+
+    auto expected = hash->doFinal(msg);
+
+    std::vector<uint8_t> digest(hash->outputsize() + 1, 0xff);
+    hash->update(msg);
+    auto outlen = hash->doFinal(digest.data());
+    countPassed += (outlen == expected.size() && std::equal(expected.begin(), expected.end(), digest.begin()) && digest.back() == 0xff) ? 1 : 0;
+
+    hash->update(msg);
+    outlen = hash->doFinal(std::span<uint8_t>(digest.data(), expected.size()));
+    countPassed += (outlen == expected.size() && std::equal(expected.begin(), expected.end(), digest.begin())) ? 1 : 0;
+
+    try {
+        hash->doFinal(std::span<uint8_t>(digest.data(), expected.size() - 1));
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+
+    print_verify_result(hash->name() + " doFinal output", countPassed, 3);
+}
+
+template <typename MultiBuffer, typename... Options>
+static void verify_sha2_many(int sha2size, Options... options)
+{
+    // lengths around the padding boundaries of both, uneven so that lanes retire at different rounds
+    std::vector<size_t> lengths = {0, 1, 55, 56, 63, 64, 65, 111, 112, 119, 120, 127, 128, 129, 1000, 3, 4096, 64, 0, 200, 57, 300, 17};
+    std::vector<std::vector<uint8_t>> msgs;
+    std::vector<std::vector<uint8_t>> digests;
+    std::vector<const uint8_t*> inputs;
+    std::vector<uint8_t*> outputs;
+
+    for (auto i = 0; i < lengths.size(); ++i) {
+        std::vector<uint8_t> msg(lengths[i]);
+        for (auto j = 0; j < msg.size(); ++j) {
+            msg[j] = static_cast<uint8_t>(i * 31 + j * 7);
+        }
+        msgs.push_back(msg);
+        digests.push_back(std::vector<uint8_t>(MultiBuffer::OUTPUTSIZE));
+    }
+
+    for (auto i = 0; i < lengths.size(); ++i) {
+        inputs.push_back(msgs[i].data());
+        outputs.push_back(digests[i].data());
+    }
+
+    MultiBuffer mb(options...);
+    mb.hashMany(inputs.data(), lengths.data(), outputs.data(), lengths.size());
+
+    auto sha = getSha2Instance(sha2size, sha2size);
+    size_t countPassed = 0;
+    for (auto i = 0; i < lengths.size(); ++i) {
+        sha->update(msgs[i]);
+        auto expected = sha->doFinal();
+
+        if (std::equal(expected.begin(), expected.end(), digests[i].begin())) {
+            countPassed += 1;
+        } else {
+            print(expected);
+            print(digests[i]);
+            std::cout << std::endl;
+        }
+    }
+
+    std::ostringstream title;
+    title << sha->name() << " hashMany " << mb.lanes() << " lanes";
+    print_verify_result(title.str(), countPassed, lengths.size());
+}
+
+template <typename MultiBuffer>
+static void benchmark_sha2_many(int sha2size, size_t msglen, size_t count, size_t iterations)
+{
+    std::vector<uint8_t> msgs(msglen * count, 0xa5);
+    std::vector<uint8_t> digests(MultiBuffer::OUTPUTSIZE * count);
+    std::vector<const uint8_t*> inputs(count);
+    std::vector<uint8_t*> outputs(count);
+    std::vector<size_t> lengths(count, msglen);
+
+    for (auto i = 0; i < count; ++i) {
+        inputs[i] = msgs.data() + i * msglen;
+        outputs[i] = digests.data() + i * MultiBuffer::OUTPUTSIZE;
+    }
+
+    auto sha = getSha2Instance(sha2size, sha2size);
+    MultiBuffer mb;
+    uint64_t minSingle = -1;
+    uint64_t minMany = -1;
+
+    for (auto iter = 0; iter < iterations; ++iter) {
+        auto started = rdtsc();
+        for (auto i = 0; i < count; ++i) {
+            sha->update(inputs[i], msglen);
+            sha->doFinal();
+        }
+        minSingle = std::min(minSingle, rdtsc() - started);
+
+        started = rdtsc();
+        mb.hashMany(inputs.data(), lengths.data(), outputs.data(), count);
+        minMany = std::min(minMany, rdtsc() - started);
+    }
+
+    std::cout << sha->name() << " " << count << " messages of " << msglen << " bytes" << std::endl;
+    std::cout << "      single cpb: " << static_cast<double>(minSingle) / (msglen * count) << std::endl;
+    std::cout << "    hashMany cpb: " << static_cast<double>(minMany) / (msglen * count) << std::endl;
+}
+
+static void benchmark_sha2(int sha2size, bool accelerated, size_t msglen, size_t iterations)
+{
+    auto hash = getSha2Instance(sha2size, sha2size, accelerated);
+    std::vector<uint8_t> msg(msglen, 0xa5);
+    uint64_t minimum = -1;
+
+    for (auto iter = 0; iter < iterations; ++iter) {
+        auto started = rdtsc();
+        hash->update(msg.data(), msg.size());
+        hash->doFinal();
+        minimum = std::min(minimum, rdtsc() - started);
+    }
+
+    std::cout << hash->name() << (accelerated ? "" : " portable") << " cpb: " << static_cast<double>(minimum) / msglen << std::endl;
+}
+
 int main(int argc, const char** argv) 
 {
     verify_testvector("ShortMsg");
     verify_testvector("LongMsg");
 
+    verify_digest_output(256);
+    verify_digest_output(512);
+
+    verify_midstate(256, 256);
+    verify_midstate(512, 512);
+
+    verify_sha2_many<Sha256MultiBuffer>(256, true, true);
+    verify_sha2_many<Sha256MultiBuffer>(256, true, false);
+    verify_sha2_many<Sha256MultiBuffer>(256, false, false);
+    verify_sha2_many<Sha512MultiBuffer>(512, true);
+    verify_sha2_many<Sha512MultiBuffer>(512, false);
+
+    benchmark_sha2(256, true, 16384, 100);
+    benchmark_sha2(256, false, 16384, 100);
+    benchmark_sha2(512, true, 16384, 100);
+    benchmark_sha2_many<Sha256MultiBuffer>(256, 64, 1024, 20);
+    benchmark_sha2_many<Sha256MultiBuffer>(256, 1024, 256, 20);
+    benchmark_sha2_many<Sha512MultiBuffer>(512, 128, 1024, 20);
+    benchmark_sha2_many<Sha512MultiBuffer>(512, 1024, 256, 20);
+
     return 0;
 }
\ No newline at end of file
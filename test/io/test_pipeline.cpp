@@ -0,0 +1,270 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "../../include/io/pipeline.h"
+#include "../../include/block_cipher/aesni.h"
+#include "../../include/hash/sha2.h"
+#include "../../include/mode/ctr.h"
+#include "../../include/mode/ocb3_stream.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace mockup::crypto;
+using namespace mockup::crypto::block_cipher;
+using namespace mockup::crypto::hash;
+using namespace mockup::crypto::io;
+using namespace mockup::crypto::mode;
+
+static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+static void print_verify_result(const std::string& title, size_t countPassed, size_t countTotal)
+{
+    std::cout << title;
+    std::cout << ((countPassed == countTotal) ? " passed" : " FAILED");
+    std::cout << " (" << countPassed << " / " << countTotal << ")" << std::endl;
+}
+
+static std::string backend_name(const Pipeline& pipeline)
+{
+    return (pipeline.backend() == Pipeline::Backend::URING) ? "PIPELINE/URING" : "PIPELINE/THREADS";
+}
+
+static std::vector<uint8_t> generate_message(size_t length)
+{
+    std::vector<uint8_t> msg(length);
+    for (auto i = 0; i < length; ++i) {
+        msg[i] = 11 * i + (i >> 10);
+    }
+    return msg;
+}
+
+// a temporary file holding data, which is removed once closed
+static int temp_file(const std::vector<uint8_t>& data)
+{
+    char path[] = "/tmp/mockup_pipeline_XXXXXX";
+    auto fd = mkstemp(path);
+    unlink(path);
+
+    if (data.size() > 0) {
+        write(fd, data.data(), data.size());
+    }
+    return fd;
+}
+
+static std::vector<uint8_t> read_file(int fd)
+{
+    std::vector<uint8_t> data(lseek(fd, 0, SEEK_END));
+    pread(fd, data.data(), data.size(), 0);
+    return data;
+}
+
+static void verify_pipeline_ctr(Pipeline& pipeline)
+{
+    uint8_t mk[16] = {0};
+    uint8_t iv[16] = {0};
+    std::vector<size_t> lengths = {0, 100, CHUNK_SIZE, 3 * CHUNK_SIZE + 777, 9 * CHUNK_SIZE};
+    size_t countPassed = 0;
+
+    std::shared_ptr<BufferedBlockCipher> ctr = std::make_shared<CTR>();
+    ctr->initCipher(std::make_shared<AesNI>(), mk, 16);
+
+    for (auto length : lengths) {
+        auto msg = generate_message(length);
+
+        std::vector<uint8_t> expected(length);
+        ctr->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 16);
+        ctr->doFinal(expected.data(), msg.data(), length);
+
+        auto infd = temp_file(msg);
+        auto outfd = temp_file({});
+
+        ctr->initMode(BufferedBlockCipher::CipherMode::ENCRYPT, iv, 16);
+        auto written = pipeline.run(infd, outfd, [&](uint8_t* buffer, size_t length, uint64_t index, bool last) {
+            auto outlen = ctr->update(buffer, buffer, length);
+            return last ? outlen + ctr->doFinal(buffer + outlen) : outlen;
+        });
+
+        countPassed += (written == length && read_file(outfd) == expected) ? 1 : 0;
+        close(infd);
+        close(outfd);
+    }
+
+    print_verify_result(backend_name(pipeline) + "_CTR", countPassed, lengths.size());
+}
+
+static void verify_pipeline_sha256(Pipeline& pipeline)
+{
+    std::vector<size_t> lengths = {0, 1, 5 * CHUNK_SIZE + 3};
+    size_t countPassed = 0;
+
+    for (auto length : lengths) {
+        auto msg = generate_message(length);
+
+        std::shared_ptr<Hash> sha = std::make_shared<Sha256>();
+        sha->init();
+        auto expected = sha->doFinal(msg);
+        sha->init();
+
+        auto infd = temp_file(msg);
+        size_t calls = 0;
+        auto written = pipeline.run(infd, -1, [&](uint8_t* buffer, size_t length, uint64_t index, bool last) {
+            sha->update(buffer, length);
+            calls += 1;
+            return static_cast<size_t>(0);
+        });
+
+        auto chunks = std::max((length + CHUNK_SIZE - 1) / CHUNK_SIZE, static_cast<size_t>(1));
+        countPassed += (written == 0 && calls == chunks && sha->doFinal() == expected) ? 1 : 0;
+        close(infd);
+    }
+
+    print_verify_result(backend_name(pipeline) + "_SHA256", countPassed, lengths.size());
+}
+
+static void verify_pipeline_ocb3_stream(Pipeline& pipeline)
+{
+    uint8_t mk[16] = {0};
+    uint8_t prefix[Ocb3Stream::PREFIX_LENGTH] = {0};
+    auto msg = generate_message(4 * CHUNK_SIZE + 1000);
+    size_t countPassed = 0;
+
+    Ocb3Stream stream(CHUNK_SIZE);
+    stream.initCipher(std::make_shared<AesNI>(), mk, 16);
+
+    std::ostringstream os(std::ios::binary);
+    Ocb3StreamWriter writer(stream, prefix, os);
+    writer.write(msg.data(), msg.size());
+    writer.finish();
+    auto expected = os.str();
+
+    // sealed in place, with the tag in the slack behind every chunk
+    auto infd = temp_file(msg);
+    auto outfd = temp_file({});
+    auto written = pipeline.run(infd, outfd, [&](uint8_t* buffer, size_t length, uint64_t index, bool last) {
+        return stream.sealChunk(buffer, prefix, index, last, buffer, length);
+    });
+
+    auto sealed = read_file(outfd);
+    countPassed += (written == expected.size() && std::equal(sealed.begin(), sealed.end(), reinterpret_cast<const uint8_t*>(expected.data()))) ? 1 : 0;
+    close(infd);
+    close(outfd);
+
+    // opened chunk by chunk, where a forged chunk stops the pipeline with the stage's error
+    Pipeline opener(stream.sealedChunkSize(), 0, 4, pipeline.backend());
+    for (auto forge : {false, true}) {
+        if (forge) {
+            sealed[2 * stream.sealedChunkSize() + 5] ^= 0x01;
+        }
+
+        infd = temp_file(sealed);
+        outfd = temp_file({});
+        try {
+            written = opener.run(infd, outfd, [&](uint8_t* buffer, size_t length, uint64_t index, bool last) {
+                return stream.openChunk(buffer, prefix, index, last, buffer, length);
+            });
+            countPassed += (forge == false && written == msg.size() && read_file(outfd) == msg) ? 1 : 0;
+        } catch (const char* e) {
+            countPassed += (forge && std::string(e) == "Invalid tag") ? 1 : 0;
+        }
+        close(infd);
+        close(outfd);
+    }
+
+    print_verify_result(backend_name(pipeline) + "_OCB3_STREAM", countPassed, 3);
+}
+
+// a stage that throws something other than a string leaves the pipeline drained and usable
+static void verify_pipeline_stage_error(Pipeline& pipeline)
+{
+    auto msg = generate_message(5 * CHUNK_SIZE);
+    size_t countPassed = 0;
+
+    auto infd = temp_file(msg);
+    auto outfd = temp_file({});
+    try {
+        pipeline.run(infd, outfd, [](uint8_t* buffer, size_t length, uint64_t index, bool last) -> size_t {
+            if (index == 2) {
+                throw std::runtime_error("stage failed");
+            }
+            return length;
+        });
+    } catch (const std::exception& e) {
+        countPassed += 1;
+    }
+
+    auto written = pipeline.run(infd, outfd, [](uint8_t* buffer, size_t length, uint64_t index, bool last) {
+        return length;
+    });
+    countPassed += (written == msg.size() && read_file(outfd) == msg) ? 1 : 0;
+    close(infd);
+    close(outfd);
+
+    print_verify_result(backend_name(pipeline) + "_STAGE_ERROR", countPassed, 2);
+}
+
+// buffers too large to allocate, or whose total wraps around, are refused in the constructor
+static void verify_pipeline_allocation()
+{
+    size_t countPassed = 0;
+
+    try {
+        Pipeline pipeline(size_t{1} << 50, 0, 4);
+    } catch (const std::bad_alloc& e) {
+        countPassed += 1;
+    }
+
+    try {
+        Pipeline pipeline(SIZE_MAX / 4, 0, 4);
+    } catch (const char* e) {
+        countPassed += 1;
+    }
+
+    print_verify_result("PIPELINE_ALLOCATION", countPassed, 2);
+}
+
+int main(int argc, const char** argv)
+{
+    for (auto backend : {Pipeline::Backend::URING, Pipeline::Backend::THREADS}) {
+        Pipeline pipeline(CHUNK_SIZE, Ocb3Stream::TAG_LENGTH, 4, backend);
+
+        verify_pipeline_ctr(pipeline);
+        verify_pipeline_sha256(pipeline);
+        verify_pipeline_ocb3_stream(pipeline);
+        verify_pipeline_stage_error(pipeline);
+    }
+
+    verify_pipeline_allocation();
+
+    return 0;
+}
@@ -38,8 +38,8 @@ bool TestVectorReader::open(std::string path)
 
     std::string line;
 
-    while (!ifs.eof()) {
-        std::getline(ifs, line);
+    // a missing file never reaches eof, so the loop ends on the first failed read instead
+    while (std::getline(ifs, line)) {
         auto tokens = tokenize(line, '=');
         
         if (tokens.size() != 2) {
@@ -56,7 +56,7 @@ bool TestVectorReader::open(std::string path)
         container[key].push_back(value);
     }
 
-    return false;
+    return ifs.is_open();
 }
 
 void TestVectorReader::printInfo() const
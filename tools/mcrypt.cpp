@@ -0,0 +1,342 @@
+/**
+ * The MIT License
+ *
+ * Copyright (c) 2020 Ilwoong Jeong (https://github.com/ilwoong)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "../include/block_cipher/aes.h"
+#include "../include/block_cipher/aesni.h"
+#include "../include/block_cipher/lea.h"
+#include "../include/mode/ctr.h"
+#include "../include/mode/ocb3_stream.h"
+#include "../include/util/byte_array.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace mockup::crypto;
+using namespace mockup::crypto::block_cipher;
+using namespace mockup::crypto::mode;
+using namespace mockup::crypto::util;
+
+using CipherMode = BufferedBlockCipher::CipherMode;
+
+struct options_t {
+    CipherMode direction;
+    std::string mode;
+    std::string cipher;
+    bytearray_t key;
+    bytearray_t iv;
+    std::string input;
+    std::string output;
+    size_t threads;
+    size_t chunkSize;
+};
+
+// a read-only or read-write shared mapping of a whole file, where empty files are not mapped
+struct mapped_file_t {
+    int fd;
+    uint8_t* data;
+    size_t length;
+};
+
+static void usage()
+{
+    std::cerr << "usage: mcrypt enc|dec ctr|ocb3 aes|aesni|lea <key hex> <iv hex> <input> <output> [threads] [chunk KiB]" << std::endl;
+    std::cerr << "  ctr  : iv is the initial counter block of 16 bytes" << std::endl;
+    std::cerr << "  ocb3 : iv is the stream nonce prefix of " << Ocb3Stream::PREFIX_LENGTH << " bytes, and the output is chunked" << std::endl;
+}
+
+static std::shared_ptr<BlockCipher> make_cipher(const std::string& name)
+{
+    if (name == "aes") {
+        return std::make_shared<Aes>();
+
+    } else if (name == "aesni") {
+        return std::make_shared<AesNI>();
+
+    } else if (name == "lea") {
+        return std::make_shared<Lea>();
+    }
+
+    throw "Unknown cipher";
+}
+
+// releases whatever of the file is held, so it may be called on every exit
+static void unmap(mapped_file_t& file)
+{
+    if (file.data != nullptr) {
+        munmap(file.data, file.length);
+        file.data = nullptr;
+    }
+
+    if (file.fd >= 0) {
+        close(file.fd);
+        file.fd = -1;
+    }
+}
+
+static mapped_file_t map_input(const std::string& path)
+{
+    mapped_file_t file = {open(path.c_str(), O_RDONLY), nullptr, 0};
+    if (file.fd < 0) {
+        throw "Cannot open input";
+    }
+
+    struct stat st;
+    if (fstat(file.fd, &st) != 0) {
+        unmap(file);
+        throw "Cannot stat input";
+    }
+    file.length = st.st_size;
+
+    if (file.length > 0) {
+        auto data = mmap(nullptr, file.length, PROT_READ, MAP_SHARED, file.fd, 0);
+        if (data == MAP_FAILED) {
+            unmap(file);
+            throw "Cannot map input";
+        }
+
+        file.data = static_cast<uint8_t*>(data);
+        madvise(file.data, file.length, MADV_SEQUENTIAL);
+    }
+
+    return file;
+}
+
+static mapped_file_t map_output(const std::string& path, size_t length)
+{
+    mapped_file_t file = {open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644), nullptr, length};
+    if (file.fd < 0) {
+        throw "Cannot open output";
+    }
+
+    if (ftruncate(file.fd, length) != 0) {
+        unmap(file);
+        throw "Cannot resize output";
+    }
+
+    if (file.length > 0) {
+        auto data = mmap(nullptr, file.length, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+        if (data == MAP_FAILED) {
+            unmap(file);
+            throw "Cannot map output";
+        }
+
+        file.data = static_cast<uint8_t*>(data);
+        madvise(file.data, file.length, MADV_SEQUENTIAL);
+    }
+
+    return file;
+}
+
+// every thread runs its own CTR instance over a block aligned range, starting from the counter of that range
+static size_t run_ctr(const options_t& opts, uint8_t* out, const uint8_t* in, size_t length)
+{
+    auto blocksize = make_cipher(opts.cipher)->blocksize();
+    auto blocks = (length + blocksize - 1) / blocksize;
+    auto share = std::max((blocks + opts.threads - 1) / opts.threads, static_cast<size_t>(1));
+
+    auto run = [&](size_t first) {
+        auto offset = first * blocksize;
+        auto rangeLength = std::min(share * blocksize, length - offset);
+
+        CTR ctr;
+        ctr.initCipher(make_cipher(opts.cipher), opts.key.data(), opts.key.size());
+        ctr.initMode(opts.direction, opts.iv.data(), opts.iv.size());
+        ctr.skipBlocks(first);
+
+        auto outlen = ctr.update(out + offset, in + offset, rangeLength);
+        ctr.doFinal(out + offset + outlen);
+    };
+
+    std::vector<std::thread> running;
+    for (size_t first = share; first < blocks; first += share) {
+        running.emplace_back(run, first);
+    }
+
+    if (length > 0) {
+        run(0);
+    }
+
+    for (auto& thread : running) {
+        thread.join();
+    }
+
+    return length;
+}
+
+static size_t ocb3_output_size(const options_t& opts, size_t length)
+{
+    auto chunkSize = opts.chunkSize;
+    auto sealedChunkSize = chunkSize + Ocb3Stream::TAG_LENGTH;
+
+    if (opts.direction == CipherMode::ENCRYPT) {
+        auto chunks = std::max((length + chunkSize - 1) / chunkSize, static_cast<size_t>(1));
+        return length + chunks * Ocb3Stream::TAG_LENGTH;
+    }
+
+    auto chunks = (length + sealedChunkSize - 1) / sealedChunkSize;
+    if (chunks == 0 || length - (chunks - 1) * sealedChunkSize < Ocb3Stream::TAG_LENGTH) {
+        throw "Invalid tag";
+    }
+    return length - chunks * Ocb3Stream::TAG_LENGTH;
+}
+
+// chunks are sealed or opened straight between the mappings, spread over one cipher instance per thread
+static size_t run_ocb3(const options_t& opts, uint8_t* out, const uint8_t* in, size_t length)
+{
+    std::vector<std::shared_ptr<BlockCipher>> workers;
+    for (size_t t = 1; t < opts.threads; ++t) {
+        workers.push_back(make_cipher(opts.cipher));
+    }
+
+    Ocb3Stream stream(opts.chunkSize);
+    stream.setWorkers(workers);
+    stream.initCipher(make_cipher(opts.cipher), opts.key.data(), opts.key.size());
+
+    if (opts.direction == CipherMode::ENCRYPT) {
+        return stream.sealChunks(out, opts.iv.data(), 0, in, length, true);
+    }
+
+    return stream.openChunks(out, opts.iv.data(), 0, in, length, true);
+}
+
+// a positive decimal count, where std::stoul alone would also take signs, trailing text and overflow by exception
+static size_t parse_count(const char* arg)
+{
+    size_t parsed = 0;
+    unsigned long value = 0;
+    try {
+        value = std::stoul(arg, &parsed);
+    } catch (const std::exception& e) {
+        throw "Illegal number";
+    }
+
+    if (arg[0] < '0' || arg[0] > '9' || arg[parsed] != '\0') {
+        throw "Illegal number";
+    }
+
+    return value;
+}
+
+static options_t parse_options(int argc, const char** argv)
+{
+    if (argc < 8) {
+        usage();
+        exit(2);
+    }
+
+    options_t opts;
+    std::string direction = argv[1];
+    if (direction != "enc" && direction != "dec") {
+        throw "Unknown direction";
+    }
+
+    opts.direction = (direction == "enc") ? CipherMode::ENCRYPT : CipherMode::DECRYPT;
+    opts.mode = argv[2];
+    opts.cipher = argv[3];
+    opts.key = toByteArray(argv[4]);
+    opts.iv = toByteArray(argv[5]);
+    opts.input = argv[6];
+    opts.output = argv[7];
+    opts.threads = (argc > 8) ? parse_count(argv[8]) : std::max(std::thread::hardware_concurrency(), 1u);
+    opts.chunkSize = ((argc > 9) ? parse_count(argv[9]) : 64) * 1024;
+
+    if (opts.mode == "ctr" && opts.iv.size() != 16) {
+        throw "Illegal length";
+
+    } else if (opts.mode == "ocb3" && opts.iv.size() != Ocb3Stream::PREFIX_LENGTH) {
+        throw "Illegal length";
+
+    } else if (opts.mode != "ctr" && opts.mode != "ocb3") {
+        throw "Unknown mode";
+    }
+
+    if (opts.threads == 0 || opts.chunkSize == 0) {
+        throw "Illegal length";
+    }
+
+    return opts;
+}
+
+int main(int argc, const char** argv)
+{
+    mapped_file_t input = {-1, nullptr, 0};
+    mapped_file_t output = {-1, nullptr, 0};
+
+    try {
+        auto opts = parse_options(argc, argv);
+        make_cipher(opts.cipher)->init(opts.key.data(), opts.key.size());
+
+        input = map_input(opts.input);
+        auto outlen = (opts.mode == "ctr") ? input.length : ocb3_output_size(opts, input.length);
+        output = map_output(opts.output, outlen);
+
+        auto started = std::chrono::steady_clock::now();
+        try {
+            if (opts.mode == "ctr") {
+                run_ctr(opts, output.data, input.data, input.length);
+            } else {
+                run_ocb3(opts, output.data, input.data, input.length);
+            }
+
+        } catch (...) {
+            // nothing of a forged file is left behind
+            unmap(output);
+            unlink(opts.output.c_str());
+            throw;
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        auto length = input.length;
+        unmap(input);
+        unmap(output);
+
+        std::cout << opts.mode << "/" << opts.cipher << " " << length << " bytes in " << elapsed << " s, ";
+        std::cout << ((elapsed > 0) ? length / elapsed / (1 << 20) : 0) << " MiB/s with " << opts.threads << " threads" << std::endl;
+
+    } catch (const char* e) {
+        unmap(input);
+        unmap(output);
+        std::cerr << "mcrypt: " << e << std::endl;
+        return 1;
+
+    } catch (const std::exception& e) {
+        unmap(input);
+        unmap(output);
+        std::cerr << "mcrypt: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}